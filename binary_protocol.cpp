@@ -0,0 +1,103 @@
+/**
+ * @file binary_protocol.cpp
+ * @brief 二进制请求格式实现文件
+ */
+
+#include "binary_protocol.h"
+#include "constants.h"
+#include <cstring>
+
+namespace
+{
+    /**
+     * @brief 把小端序的32位整数转换为主机字节序
+     * @param value 小端序的值
+     * @return 主机字节序的值
+     */
+    inline uint32_t fromLittleEndian(uint32_t value)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_bswap32(value);
+#else
+        return value;
+#endif
+    }
+}
+
+/**
+ * @brief 判断Content-Type是否为二进制请求格式
+ * @param contentType 请求的Content-Type
+ * @return 是二进制请求格式返回true
+ */
+bool isBinaryContentType(const std::string &contentType)
+{
+    return contentType.find(CONTENT_TYPE_OCTET_STREAM) != std::string::npos;
+}
+
+/**
+ * @brief 解码二进制请求体
+ * @param body 请求体
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ */
+bool parseBinaryRequest(const std::string &body, BinaryRequest *request, std::string *errorMsg)
+{
+    // 1. 读取固定长度的请求头
+    if (body.size() < sizeof(BinaryRequestHeader))
+    {
+        *errorMsg = "Binary request is shorter than its header";
+        return false;
+    }
+    BinaryRequestHeader header;
+    std::memcpy(&header, body.data(), sizeof(header));
+    header.magic = fromLittleEndian(header.magic);
+    header.metaLength = fromLittleEndian(header.metaLength);
+    header.dim = fromLittleEndian(header.dim);
+    header.count = fromLittleEndian(header.count);
+
+    if (header.magic != BINARY_REQUEST_MAGIC)
+    {
+        *errorMsg = "Invalid binary request magic";
+        return false;
+    }
+    if (header.dim == 0 || header.count == 0)
+    {
+        *errorMsg = "Binary request must carry at least one non-empty vector";
+        return false;
+    }
+
+    // 2. 校验请求体长度与请求头描述一致（使用64位运算避免溢出）
+    uint64_t vectorBytes = static_cast<uint64_t>(header.dim) * header.count * sizeof(float);
+    uint64_t expectedSize = sizeof(header) + static_cast<uint64_t>(header.metaLength) + vectorBytes;
+    if (expectedSize != body.size())
+    {
+        *errorMsg = "Binary request size does not match its header";
+        return false;
+    }
+
+    // 3. 解析元数据JSON
+    const char *meta = body.data() + sizeof(header);
+    request->meta.Parse(meta, header.metaLength);
+    if (request->meta.HasParseError())
+    {
+        *errorMsg = "Invalid JSON metadata in binary request";
+        return false;
+    }
+
+    // 4. 直接拷贝向量字节
+    request->dim = header.dim;
+    request->count = header.count;
+    request->vectors.resize(static_cast<size_t>(header.dim) * header.count);
+    std::memcpy(request->vectors.data(), meta + header.metaLength, vectorBytes);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (float &v : request->vectors)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        bits = __builtin_bswap32(bits);
+        std::memcpy(&v, &bits, sizeof(bits));
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file binary_protocol.h
+ * @brief 二进制请求格式头文件
+ * @details 定义 /search、/upsert、/bulk_upsert 使用的二进制请求体格式
+ *          （Content-Type: application/octet-stream），向量以原始 float32 传输，
+ *          服务端直接拷贝字节，不做任何文本解析
+ *
+ * 请求体布局（所有整数和浮点数均为小端序）：
+ * +----------------------+----------------------------+------------------------------+
+ * | BinaryRequestHeader  | 元数据JSON（metaLength字节） | count*dim 个 float32 向量数据 |
+ * +----------------------+----------------------------+------------------------------+
+ *
+ * 元数据JSON包含除 vectors 以外的全部请求字段：
+ * - /search：{"k":5,"indexType":"FLAT","filter":{...}}，count 为查询向量数量
+ * - /upsert：{"id":1,"indexType":"FLAT",...}，count 必须为1
+ * - /bulk_upsert：[{"id":1,...},{"id":2,...}]，count 等于数组长度，第i个向量属于第i条记录
+ */
+
+#pragma once
+
+#include "rapidjson/document.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct BinaryRequestHeader
+ * @brief 二进制请求头，固定16字节
+ */
+struct BinaryRequestHeader
+{
+    uint32_t magic;      ///< 魔数，必须为 BINARY_REQUEST_MAGIC（字节序列 "AVDB"）
+    uint32_t metaLength; ///< 紧随请求头的元数据JSON字节数
+    uint32_t dim;        ///< 向量维度
+    uint32_t count;      ///< 向量数量
+};
+
+/**
+ * @struct BinaryRequest
+ * @brief 解码后的二进制请求
+ */
+struct BinaryRequest
+{
+    rapidjson::Document meta;   ///< 元数据JSON
+    std::vector<float> vectors; ///< 所有向量数据（按维度依次拼接）
+    uint32_t dim = 0;           ///< 向量维度
+    uint32_t count = 0;         ///< 向量数量
+};
+
+/**
+ * @brief 判断Content-Type是否为二进制请求格式
+ * @param contentType 请求的Content-Type
+ * @return 是二进制请求格式返回true
+ */
+bool isBinaryContentType(const std::string &contentType);
+
+/**
+ * @brief 解码二进制请求体
+ * @param body 请求体
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * 向量数据通过一次内存拷贝从请求体中取出（请求体中的偏移不保证4字节对齐）
+ */
+bool parseBinaryRequest(const std::string &body, BinaryRequest *request, std::string *errorMsg);
@@ -0,0 +1,202 @@
+/**
+ * @file collection.cpp
+ * @brief 集合实现文件
+ */
+
+#include "collection.h"
+#include "logger.h"
+#include <cstring>
+
+namespace
+{
+    /**
+     * @brief 检查集合名是否合法
+     * @param name 集合名
+     * @return 合法时返回true
+     *
+     * 集合名会出现在标量存储的键和快照目录中，因此只允许字母、数字、下划线和连字符
+     */
+    bool isValidCollectionName(const std::string &name)
+    {
+        if (name.empty() || name.size() > COLLECTION_NAME_MAX_LENGTH)
+        {
+            return false;
+        }
+        for (char c : name)
+        {
+            bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                         (c >= '0' && c <= '9') || c == '_' || c == '-';
+            if (!valid)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 读取一个可选的正整数字段
+     * @param json 集合配置JSON对象
+     * @param key 字段名
+     * @param value 输入为默认值，字段存在且合法时输出字段值
+     * @return 字段不存在或合法时返回true
+     */
+    bool decodePositiveInt(const rapidjson::Value &json, const char *key, int *value)
+    {
+        if (!json.HasMember(key))
+        {
+            return true;
+        }
+        if (!json[key].IsInt() || json[key].GetInt() <= 0)
+        {
+            return false;
+        }
+        *value = json[key].GetInt();
+        return true;
+    }
+}
+
+/**
+ * @brief 解码集合配置
+ * @param json 集合配置JSON对象
+ * @param config 输出参数，解码后的配置
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ */
+bool decodeCollectionConfig(const rapidjson::Value &json, CollectionConfig *config,
+                            std::string *errorMsg)
+{
+    if (!json.IsObject())
+    {
+        *errorMsg = "Invalid JSON request";
+        return false;
+    }
+
+    // 集合名和维度是必填项
+    if (!json.HasMember(COLLECTION_NAME) || !json[COLLECTION_NAME].IsString())
+    {
+        *errorMsg = "Missing name parameter in the request";
+        return false;
+    }
+    config->name.assign(json[COLLECTION_NAME].GetString(), json[COLLECTION_NAME].GetStringLength());
+    if (!isValidCollectionName(config->name) || config->name == DEFAULT_COLLECTION_NAME)
+    {
+        *errorMsg = "Invalid name parameter in the request";
+        return false;
+    }
+    if (!json.HasMember(COLLECTION_DIM) || !json[COLLECTION_DIM].IsInt() || json[COLLECTION_DIM].GetInt() <= 0)
+    {
+        *errorMsg = "Invalid dim parameter in the request";
+        return false;
+    }
+    config->dim = json[COLLECTION_DIM].GetInt();
+
+    // 距离度量：L2（默认）、IP 或 COSINE
+    config->metric = IndexFactory::MetricType::L2;
+    if (json.HasMember(COLLECTION_METRIC))
+    {
+        const rapidjson::Value &metric = json[COLLECTION_METRIC];
+        if (metric.IsString() && std::strcmp(metric.GetString(), METRIC_TYPE_L2) == 0)
+        {
+            config->metric = IndexFactory::MetricType::L2;
+        }
+        else if (metric.IsString() && std::strcmp(metric.GetString(), METRIC_TYPE_INNER_PRODUCT) == 0)
+        {
+            config->metric = IndexFactory::MetricType::INNER_PRODUCT;
+        }
+        else if (metric.IsString() && std::strcmp(metric.GetString(), METRIC_TYPE_COSINE) == 0)
+        {
+            config->metric = IndexFactory::MetricType::COSINE;
+        }
+        else
+        {
+            *errorMsg = "Invalid metric parameter in the request";
+            return false;
+        }
+    }
+
+    // HNSW参数，未指定时使用默认值
+    config->M = HNSW_DEFAULT_M;
+    config->efConstruction = HNSW_DEFAULT_EF_CONSTRUCTION;
+    if (!decodePositiveInt(json, COLLECTION_M, &config->M) ||
+        !decodePositiveInt(json, COLLECTION_EF_CONSTRUCTION, &config->efConstruction))
+    {
+        *errorMsg = "Invalid M or efConstruction parameter in the request";
+        return false;
+    }
+    // HNSW索引按int保存容量
+    int maxElements = COLLECTION_DEFAULT_MAX_ELEMENTS;
+    if (!decodePositiveInt(json, COLLECTION_MAX_ELEMENTS, &maxElements))
+    {
+        *errorMsg = "Invalid maxElements parameter in the request";
+        return false;
+    }
+    config->maxElements = static_cast<size_t>(maxElements);
+
+    // IVF的倒排列表数量，训练时至少需要同样数量的样本
+    config->nlist = IVF_DEFAULT_NLIST;
+    if (!decodePositiveInt(json, COLLECTION_NLIST, &config->nlist))
+    {
+        *errorMsg = "Invalid nlist parameter in the request";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 把集合配置写入JSON对象
+ * @param config 集合配置
+ * @param json 输出参数，写入配置字段的JSON对象
+ * @param allocator JSON分配器
+ */
+void encodeCollectionConfig(const CollectionConfig &config, rapidjson::Value *json,
+                            rapidjson::Document::AllocatorType &allocator)
+{
+    json->SetObject();
+    json->AddMember(COLLECTION_NAME, rapidjson::Value(config.name.c_str(), allocator), allocator);
+    json->AddMember(COLLECTION_DIM, config.dim, allocator);
+    const char *metric = METRIC_TYPE_L2;
+    if (config.metric == IndexFactory::MetricType::INNER_PRODUCT)
+    {
+        metric = METRIC_TYPE_INNER_PRODUCT;
+    }
+    else if (config.metric == IndexFactory::MetricType::COSINE)
+    {
+        metric = METRIC_TYPE_COSINE;
+    }
+    json->AddMember(COLLECTION_METRIC, rapidjson::StringRef(metric), allocator);
+    json->AddMember(COLLECTION_M, config.M, allocator);
+    json->AddMember(COLLECTION_EF_CONSTRUCTION, config.efConstruction, allocator);
+    json->AddMember(COLLECTION_MAX_ELEMENTS, static_cast<uint64_t>(config.maxElements), allocator);
+    json->AddMember(COLLECTION_NLIST, config.nlist, allocator);
+}
+
+/**
+ * @brief 按配置创建集合及其FLAT、HNSW、IVF、过滤索引
+ * @param config 集合配置
+ */
+Collection::Collection(const CollectionConfig &config)
+    : config(config), ownedIndexFactory(new IndexFactory()),
+      indexFactory(ownedIndexFactory.get()), keyPrefix(config.name + COLLECTION_KEY_SEPARATOR)
+{
+    indexFactory->init(IndexFactory::IndexType::FLAT, config.dim, 0, config.metric);
+    indexFactory->init(IndexFactory::IndexType::HNSW, config.dim, static_cast<int>(config.maxElements),
+                       config.metric, config.M, config.efConstruction);
+    indexFactory->init(IndexFactory::IndexType::IVF, config.dim, 0, config.metric,
+                       config.M, config.efConstruction, config.nlist);
+    indexFactory->init(IndexFactory::IndexType::FILTER);
+    globalLogger->info("Collection {} created: dim = {}, M = {}, efConstruction = {}, maxElements = {}, nlist = {}",
+                       config.name, config.dim, config.M, config.efConstruction, config.maxElements,
+                       config.nlist);
+}
+
+/**
+ * @brief 创建使用已有索引工厂的集合
+ * @param name 集合名
+ * @param indexFactory 索引工厂
+ */
+Collection::Collection(const std::string &name, IndexFactory *indexFactory)
+    : indexFactory(indexFactory)
+{
+    config.name = name;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file collection.h
+ * @brief 集合头文件
+ * @details 一个集合拥有自己的向量维度、距离度量、HNSW和IVF参数，以及独立的FLAT、HNSW、IVF、过滤索引。
+ *          集合的记录在标量存储中以 "集合名:ID" 为键，快照保存在 snapshots/集合名 目录下，
+ *          因此同一个进程可以同时服务多个不同维度的嵌入模型。
+ *
+ *          不带 collection 字段的请求使用默认集合：默认集合直接使用全局索引工厂，
+ *          记录的键仍然是ID本身，与引入集合之前的数据保持兼容。
+ */
+
+#pragma once
+
+#include "constants.h"
+#include "index_factory.h"
+#include "rapidjson/document.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @struct CollectionConfig
+ * @brief 集合的创建参数
+ */
+struct CollectionConfig
+{
+    std::string name;                                               ///< 集合名
+    int dim = 0;                                                    ///< 向量维度，默认集合为0（不校验维度）
+    IndexFactory::MetricType metric = IndexFactory::MetricType::L2; ///< 距离度量类型
+    int M = HNSW_DEFAULT_M;                                         ///< HNSW索引节点的最大近邻数
+    int efConstruction = HNSW_DEFAULT_EF_CONSTRUCTION;              ///< HNSW构建索引时的候选邻居数
+    size_t maxElements = COLLECTION_DEFAULT_MAX_ELEMENTS;           ///< HNSW索引的初始容量，写满后自动扩容
+    int nlist = IVF_DEFAULT_NLIST;                                  ///< IVF索引的倒排列表（聚类中心）数量
+};
+
+/**
+ * @brief 解码集合配置
+ * @param json 集合配置JSON对象，形如 {"name": "docs", "dim": 768, "metric": "IP", "M": 32}
+ * @param config 输出参数，解码后的配置
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * 集合名只能包含字母、数字、下划线和连字符，长度不超过 COLLECTION_NAME_MAX_LENGTH，
+ * 且不能与默认集合同名
+ */
+bool decodeCollectionConfig(const rapidjson::Value &json, CollectionConfig *config,
+                            std::string *errorMsg);
+
+/**
+ * @brief 把集合配置写入JSON对象
+ * @param config 集合配置
+ * @param json 输出参数，写入配置字段的JSON对象
+ * @param allocator JSON分配器
+ */
+void encodeCollectionConfig(const CollectionConfig &config, rapidjson::Value *json,
+                            rapidjson::Document::AllocatorType &allocator);
+
+/**
+ * @class Collection
+ * @brief 一个命名集合：配置、索引和写入锁
+ *
+ * 集合创建后不会被删除，因此通过 VectorDatabase::getCollection 取得的指针在进程内一直有效
+ */
+class Collection
+{
+public:
+    /**
+     * @brief 按配置创建集合及其FLAT、HNSW、IVF、过滤索引
+     * @param config 集合配置
+     */
+    explicit Collection(const CollectionConfig &config);
+
+    /**
+     * @brief 创建使用已有索引工厂的集合（用于默认集合）
+     * @param name 集合名
+     * @param indexFactory 索引工厂，由调用方管理生命周期
+     */
+    Collection(const std::string &name, IndexFactory *indexFactory);
+
+    Collection(const Collection &) = delete;
+    Collection &operator=(const Collection &) = delete;
+
+    /**
+     * @brief 获取集合名
+     * @return 集合名
+     */
+    const std::string &getName() const { return config.name; }
+
+    /**
+     * @brief 获取集合配置
+     * @return 集合配置
+     */
+    const CollectionConfig &getConfig() const { return config; }
+
+    /**
+     * @brief 是否为默认集合
+     * @return 默认集合返回true
+     */
+    bool isDefault() const { return !ownedIndexFactory; }
+
+    /**
+     * @brief 获取集合的索引工厂
+     * @return 索引工厂
+     */
+    IndexFactory *getIndexFactory() const { return indexFactory; }
+
+    /**
+     * @brief 获取集合记录在标量存储中的键前缀
+     * @return 键前缀，默认集合为空字符串
+     */
+    const std::string &getKeyPrefix() const { return keyPrefix; }
+
+    /**
+     * @brief 检查向量长度是否与集合维度一致
+     * @param size 向量（或多个查询向量中每一个）的长度
+     * @return 一致或集合不限制维度时返回true
+     */
+    bool acceptsDim(size_t size) const { return config.dim <= 0 || size == static_cast<size_t>(config.dim); }
+
+    /**
+     * @brief 获取集合的写入锁
+     * @return 写入锁
+     *
+     * 同一集合的写入（读取旧记录、替换向量、更新过滤索引和标量存储）需要持有该锁，
+     * 不同集合的写入互不阻塞。搜索不需要该锁
+     */
+    std::mutex &getWriteMutex() { return writeMutex; }
+
+private:
+    CollectionConfig config;                         ///< 集合配置
+    std::unique_ptr<IndexFactory> ownedIndexFactory; ///< 集合自己创建的索引工厂，默认集合为空
+    IndexFactory *indexFactory;                      ///< 集合使用的索引工厂
+    std::string keyPrefix;                           ///< 标量存储的键前缀
+    std::mutex writeMutex;                           ///< 写入锁
+};
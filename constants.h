@@ -12,12 +12,35 @@
 // HTTP响应相关字段
 #define RESPONSE_VECTORS "vectors"      // 返回的向量数据字段名
 #define RESPONSE_DISTANCES "distances"  // 返回的距离数据字段名
+#define RESPONSE_RESULTS "results"      // 批量查询时每个查询的结果列表字段名
+#define RESPONSE_MISSING "missing"      // 批量查询记录时不存在的ID列表字段名
+#define RESPONSE_FIELDS "fields"        // 搜索结果中与ID一一对应的记录字段列表字段名
+#define RESPONSE_EMBEDDINGS "embeddings" // 搜索结果中与ID一一对应的命中向量列表字段名
 
 // HTTP请求相关字段
 #define REQUEST_VECTORS "vectors"       // 请求中的向量数据字段名
 #define REQUEST_K "k"                   // 请求中的K值字段名（用于KNN搜索）
 #define REQUEST_ID "id"                 // 请求中的ID字段名
+#define REQUEST_IDS "ids"               // 批量查询请求中的ID列表字段名
 #define REQUEST_INDEX_TYPE "indexType"  // 请求中的索引类型字段名
+#define REQUEST_FILTER_FIELD_NAME "fieldName"  // 过滤条件中的字段名
+#define REQUEST_FILTER_OP "op"                 // 过滤条件中的操作符字段名
+#define REQUEST_FILTER_VALUE "value"           // 过滤条件中的过滤值字段名
+#define REQUEST_MAX_STALENESS_MS "maxStalenessMs" // 搜索请求可接受的缓存结果陈旧时间（毫秒）字段名
+#define REQUEST_INCLUDE_FIELDS "includeFields"    // 搜索请求中需要随结果返回的记录字段列表字段名
+#define REQUEST_INCLUDE_VECTOR "includeVector"    // 搜索请求中是否随结果返回命中向量的字段名
+#define REQUEST_TIMEOUT_MS "timeoutMs"            // 搜索请求的时间预算（毫秒）字段名
+#define REQUEST_COLLECTION "collection"           // 请求所属集合的字段名，缺省时使用默认集合
+#define REQUEST_EF "ef"                           // HNSW搜索请求的候选数量字段名，缺省时自动选择
+#define REQUEST_EXPLAIN "explain"                 // 搜索请求是否返回执行计划的字段名
+#define REQUEST_NPROBE "nprobe"                   // IVF搜索请求探测的倒排列表数量字段名，缺省时自动选择
+#define REQUEST_SAMPLE_SIZE "sampleSize"          // 训练请求从标量存储中抽样的最大向量数字段名
+#define REQUEST_CENTROIDS "centroids"            // 训练请求中已训练的聚类中心字段名，WAL日志据此恢复训练结果
+
+// 请求解析相关（见 request.h）
+#define REQUEST_PARSE_BUFFER_SIZE (64 * 1024)  // 每个线程解析请求时复用的值分配器首块大小（字节）
+#define REQUEST_PARSE_STACK_SIZE (16 * 1024)   // 每个线程解析请求时复用的解析栈首块大小（字节）
+#define REQUEST_PARSE_RETAIN_TEXT_BYTES (1024 * 1024) // 解析结束后线程局部请求体拷贝保留的最大容量（字节），超过时释放
 
 // 响应状态码相关
 #define RESPONSE_RETCODE "retcode"           // 返回状态码字段名
@@ -27,12 +50,127 @@
 // 响应其他字段
 #define RESPONSE_ERROR_MSG "errorMsg"              // 错误信息字段名
 #define RESPONSE_CONTENT_TYPE_JSON "application/json"  // HTTP响应Content-Type
+#define RESPONSE_UPSERTED "upserted"               // 批量更新成功写入的记录数字段名
+#define RESPONSE_FAILED "failed"                   // 批量更新被跳过的记录数字段名
+#define RESPONSE_DELETED "deleted"                 // 删除的记录数字段名
+#define RESPONSE_PARTIAL "partial"                 // 搜索在时间预算内未完成、返回部分结果时的标记字段名
+#define RESPONSE_PLAN "plan"                       // 搜索的执行计划字段名（请求带有 explain 时返回）
+#define RESPONSE_SAMPLES "samples"                 // 训练使用的样本数字段名
+#define RESPONSE_BUFFERED "buffered"               // 训练完成后从缓冲区移入IVF索引的向量数字段名
+
+// HTTP服务器并发与降载相关（见 server_task_queue.h）
+#define HTTP_WORKER_THREADS 0            // 工作线程数量，0表示使用 httplib 的默认值
+#define HTTP_MAX_QUEUED_CONNECTIONS 256  // 等待工作线程的最大连接数，超出后直接返回503
+#define HTTP_SHED_THREADS 1              // 负责返回503的降载线程数量
+#define HTTP_MAX_SHED_CONNECTIONS 1024   // 等待降载线程的最大连接数，超出后接受线程阻塞，新连接留在内核的监听队列中
+#define HTTP_RETRY_AFTER_SECONDS "1"     // 503/429 响应中 Retry-After 头的值
+#define RESPONSE_STATUS_OVERLOADED 503   // 任务队列已满时的HTTP状态码
+#define RESPONSE_STATUS_TOO_MANY 429     // 接口并发达到上限时的HTTP状态码
+
+// 日志相关（见 logger.h）
+#define LOG_ASYNC_QUEUE_SIZE 8192     // 异步日志队列能容纳的消息数
+#define REQUEST_LOG_SAMPLE_RATE 100   // 每多少个请求记录一次请求体
+#define REQUEST_LOG_MAX_BYTES 512     // 记录请求体时最多输出的字节数
+
+// 请求计时相关（见 request_timing.h）
+#define HEADER_DEBUG_TIMING "X-Debug-Timing"  // 请求带有该头时在响应的 Server-Timing 头中返回各阶段耗时
+#define SLOW_REQUEST_THRESHOLD_MS 1000        // 慢请求日志阈值（毫秒），0表示不输出慢请求日志
+
+// 运行指标相关（见 metrics.h）
+#define METRICS_SHARDS 16                                     // 计数器和直方图按线程分片的数量
+#define CONTENT_TYPE_PROMETHEUS "text/plain; version=0.0.4"   // /metrics 响应的Content-Type
+
+// 批量查询记录相关
+#define QUERY_MAX_IDS 1024  // 一次 /query 请求最多查询的ID数量
+
+// 批量写入相关
+#define CONTENT_TYPE_NDJSON "application/x-ndjson"  // 批量更新请求体为NDJSON时的Content-Type
+#define BULK_UPSERT_BATCH_SIZE 1024                 // 批量更新时每个批次包含的最大记录数
+
+// 搜索响应相关（见 search_response.h）
+#define SEARCH_STREAMING_MIN_SLOTS 65536     // 搜索结果位置数达到该值时改用分块传输响应
+#define SEARCH_STREAMING_CHUNK_VALUES 16384  // 分块传输时每个分块最多包含的数值个数
+
+// HNSW搜索相关
+#define HNSW_DEFAULT_EF_SEARCH 50          // HNSW搜索时保留的默认候选数量
+#define HNSW_MAX_EF_SEARCH 4096            // 请求指定或按过滤选择率放大后的候选数量上限
+#define HNSW_DEFAULT_M 16                  // HNSW索引节点的默认最大近邻数
+#define HNSW_DEFAULT_EF_CONSTRUCTION 200   // HNSW构建索引时的默认候选邻居数
+#define HNSW_TWO_HOP_NEIGHBOR_FACTOR 2     // 两跳过滤图搜索时每个节点收集的满足条件的近邻数相对底层最大近邻数的倍数
+
+// 过滤搜索计划相关（见 search_planner.h）
+#define SEARCH_PLAN_POST_FILTER_OVERSAMPLE 2.0  // 后过滤时候选中期望满足过滤条件的数量相对k的倍数
+#define SEARCH_PLAN_POST_FILTER_PENALTY 1.5     // 后过滤结果不足时需要回退重搜，比较代价时乘以该系数
+#define SEARCH_PLAN_TWO_HOP_MAX_SELECTIVITY 0.05 // 匹配数占存活向量的比例不超过该值时才考虑两跳过滤图搜索
+#define SEARCH_PLAN_MEMBERSHIP_COST 0.05         // 查询一次过滤位图相对一次距离计算的代价
+
+// HNSW容量增长相关（见 hnswlib_index.h）
+#define HNSW_GROWTH_FACTOR 1.5     // 索引写满时按当前容量的倍数扩容
+#define HNSW_GROWTH_INCREMENT 0    // 大于0时改为每次固定增加的容量
+
+// HNSW删除与重建相关（见 hnswlib_index.h）
+#define HNSW_REBUILD_TOMBSTONE_RATIO 0.2   // 墓碑占索引位置的比例超过该值时在后台重建索引
+#define HNSW_REBUILD_MIN_VECTORS 10000     // 索引位置数低于该值时不触发重建
+#define HNSW_REBUILD_FINAL_DRAIN 1024      // 重建完成后，剩余的写入日志少于该数量时才在独占锁内应用并切换索引
+
+// HNSW批量构建相关（见 hnswlib_index.h）
+#define HNSW_BUILD_CHUNK_SIZE 64                  // 批量构建时工作线程每次领取的向量数量
+#define HNSW_BUILD_PROGRESS_MIN_VECTORS 100000    // 一次批量构建的向量数达到该值时输出进度日志
+#define HNSW_BUILD_PROGRESS_INTERVAL_MS 5000      // 批量构建和重放WAL时输出进度日志的间隔（毫秒）
+#define WAL_REPLAY_BATCH_SIZE 16384               // 重放WAL时连续的单条写入合并为一批的最大记录数
+
+// 集合相关（见 collection.h）
+#define DEFAULT_COLLECTION_NAME "default"          // 默认集合名，请求不带collection字段时使用
+#define COLLECTION_NAME_MAX_LENGTH 64              // 集合名的最大长度
+#define COLLECTION_DEFAULT_MAX_ELEMENTS 100000     // 创建集合时未指定容量的HNSW索引初始容量
+#define COLLECTION_KEY_SEPARATOR ":"               // 集合记录在标量存储中的键为 集合名 + 分隔符 + ID
+#define COLLECTIONS_STORAGE_KEY "#collections"     // 标量存储中保存所有集合配置的键
+#define COLLECTION_NAME "name"                     // 集合配置中的集合名字段名
+#define COLLECTION_DIM "dim"                       // 集合配置中的向量维度字段名
+#define COLLECTION_METRIC "metric"                 // 集合配置中的距离度量字段名
+#define COLLECTION_M "M"                           // 集合配置中的HNSW最大近邻数字段名
+#define COLLECTION_EF_CONSTRUCTION "efConstruction" // 集合配置中的HNSW构建候选邻居数字段名
+#define COLLECTION_MAX_ELEMENTS "maxElements"      // 集合配置中的HNSW初始容量字段名
+#define COLLECTION_NLIST "nlist"                   // 集合配置中的IVF倒排列表数量字段名
+#define RESPONSE_COLLECTIONS "collections"         // 列出集合时的集合列表字段名
+
+// 搜索时间预算相关
+#define FLAT_SCAN_BLOCK_SIZE 16384         // 带时间预算的FLAT搜索每扫描多少个向量检查一次是否超时
+#define HNSW_DEADLINE_CHECK_INTERVAL 16    // 带时间预算的HNSW搜索每扩展多少个节点检查一次是否超时
+
+// IVF索引相关（见 ivf_index.h）
+#define IVF_DEFAULT_NLIST 1024               // IVF索引默认的倒排列表（聚类中心）数量
+#define IVF_DEFAULT_NPROBE 16                // IVF搜索默认探测的倒排列表数量
+#define IVF_MAX_NPROBE 65536                 // 请求指定的探测数量上限，实际探测数量不超过倒排列表数量
+#define IVF_TRAIN_POINTS_PER_CENTROID 64     // 未指定样本数时每个聚类中心抽样的向量数（faiss 建议不少于39）
+
+// FLAT过滤搜索相关（见 faiss_index.h）
+#define FLAT_FILTER_SPARSE_DIVISOR 16      // 匹配数不超过向量数的 1/16 时按位图中的ID定位行，只扫描这些行
+#define FLAT_FILTER_DENSE_BITS_PER_ROW 64  // 位图最大ID不超过向量数的该倍数时转换为按ID索引的位集，否则逐个查询位图
+
+// 搜索合批相关（见 search_batcher.h）
+#define SEARCH_BATCH_ENABLED 0          // 是否合并并发的FLAT搜索，默认关闭
+#define SEARCH_BATCH_WINDOW_MICROS 200  // 合批窗口（微秒）
+#define SEARCH_BATCH_MAX_QUERIES 64     // 一个批次最多包含的查询数
+
+// 搜索结果缓存相关（见 search_cache.h）
+#define SEARCH_CACHE_MAX_BYTES (64 * 1024 * 1024)  // 搜索结果缓存的最大字节数，0表示不启用缓存
+
+// 二进制请求格式相关（见 binary_protocol.h）
+#define CONTENT_TYPE_OCTET_STREAM "application/octet-stream"  // 二进制请求体的Content-Type
+#define BINARY_REQUEST_MAGIC 0x42445641u                      // 二进制请求魔数，小端序字节为 "AVDB"
 
 // 索引类型
 #define INDEX_TYPE_FLAT "FLAT"
 #define INDEX_TYPE_HNSW "HNSW"
+#define INDEX_TYPE_IVF "IVF"
 #define INDEX_TYPE_FILTER "filter"
 
+// 距离度量类型
+#define METRIC_TYPE_L2 "L2"
+#define METRIC_TYPE_INNER_PRODUCT "IP"
+#define METRIC_TYPE_COSINE "COSINE"
+
 // TODO: 过滤器类型
 #define FILTER_TYPE_INT "INT"
 #define FILTER_TYPE_STRING "STRING"
@@ -4,7 +4,13 @@
 #include "faiss/IndexIDMap.h"
 #include "faiss/IndexFlat.h"
 #include "faiss/index_io.h"
+#include "faiss/utils/distances.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <vector>
 #include <fstream>
 
@@ -25,17 +31,63 @@ RoaringBitmapIDSelector::~RoaringBitmapIDSelector() {}
  */
 bool RoaringBitmapIDSelector::is_member(int64_t id) const
 {
-    bool result = roaring_bitmap_contains(bitmap, static_cast<uint32_t>(id));
-    globalLogger->debug("RoaringBitmapIDSelector::is_member: ID: {}, is_member: {}", id, result);
-    return result;
+    // 过滤扫描时对每个候选向量都会调用，这里不能有日志等额外开销；
+    // 位图只能保存32位ID，超出范围的ID不能截断后再查询
+    return id >= 0 && id <= std::numeric_limits<uint32_t>::max() &&
+           roaring_bitmap_contains(bitmap, static_cast<uint32_t>(id));
 }
 
 /**
  * @brief 构造函数
  * @param index 指向 FAISS 索引对象的指针
+ * @param cosine 是否为余弦相似度索引
  */
-FaissIndex::FaissIndex(faiss::Index *index)
-    : index(index) {}
+FaissIndex::FaissIndex(faiss::Index *index, bool cosine)
+    : index(index), cosine(cosine) {}
+
+/**
+ * @brief 析构函数
+ */
+FaissIndex::~FaissIndex()
+{
+    delete index;
+}
+
+/**
+ * @brief 按余弦相似度搜索时，返回归一化后的向量
+ * @param data 向量数据
+ * @param buffer 存放归一化结果的缓冲区
+ * @return 归一化后的向量
+ *
+ * 归一化使用 faiss 的向量化实现，零向量保持不变
+ */
+const std::vector<float> &FaissIndex::prepareVectors(const std::vector<float> &data,
+                                                     std::vector<float> *buffer) const
+{
+    if (!cosine)
+    {
+        return data;
+    }
+    *buffer = data;
+    faiss::fvec_renorm_L2(index->d, buffer->size() / index->d, buffer->data());
+    return *buffer;
+}
+
+/**
+ * @brief 把内积搜索得到的余弦相似度转换为余弦距离
+ * @param indices 搜索结果ID
+ * @param distances 输入输出参数，搜索结果距离
+ */
+void FaissIndex::toCosineDistances(const std::vector<long> &indices, std::vector<float> *distances)
+{
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (indices[i] != -1)
+        {
+            (*distances)[i] = 1.0f - (*distances)[i];
+        }
+    }
+}
 
 /**
  * @brief 向FAISS索引中插入单个向量及其关联标签
@@ -50,8 +102,125 @@ void FaissIndex::insertVectors(const std::vector<float> &data, uint64_t label)
     // 将标签转换为long类型，以符合FAISS索引的要求
     long id = static_cast<long>(label);
 
-    // 1表示写入单个向量，data.data()是数据的指针,&id提供向量的ID
-    index->add_with_ids(1, data.data(), &id);
+    insertVectors(data, std::vector<long>{id});
+}
+
+/**
+ * @brief 向FAISS索引中批量插入向量及其关联标签
+ *
+ * @param data 待写入的向量数据，多个向量按维度依次拼接
+ * @param labels 每个向量对应的ID
+ *
+ * @note 所有向量通过一次 add_with_ids 调用写入
+ */
+void FaissIndex::insertVectors(const std::vector<float> &data, const std::vector<long> &labels)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+    // 归一化在锁外完成
+    std::vector<float> normalized;
+    const std::vector<float> &vectors = prepareVectors(data, &normalized);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    size_t firstRow = static_cast<size_t>(index->ntotal);
+    index->add_with_ids(labels.size(), vectors.data(), labels.data());
+    // 追加的向量位于末尾，顺带维护行号映射
+    if (positionsValid)
+    {
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            positions[labels[i]] = firstRow + i;
+        }
+    }
+}
+
+/**
+ * @brief 批量写入向量，已存在的ID原地替换，不存在的ID追加
+ *
+ * @param data 待写入的向量数据，多个向量按维度依次拼接
+ * @param labels 每个向量对应的ID
+ *
+ * IndexFlat 中的向量按行连续存放，替换已有ID时直接覆盖对应的行，不需要 remove_ids 的整体压缩；
+ * 索引不是 IndexIDMap 包装的 IndexFlat 时，在同一次独占锁内先删除再写入
+ */
+void FaissIndex::upsertVectors(const std::vector<float> &data, const std::vector<long> &labels)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+    std::vector<float> normalized;
+    const std::vector<float> &vectors = prepareVectors(data, &normalized);
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    faiss::IndexIDMap *idMap = nullptr;
+    faiss::IndexFlat *flatIndex = getFlatIndex(&idMap);
+    if (!flatIndex)
+    {
+        faiss::IDSelectorBatch idSelectorBatch(labels.size(), labels.data());
+        index->remove_ids(idSelectorBatch);
+        index->add_with_ids(labels.size(), vectors.data(), labels.data());
+        return;
+    }
+
+    ensurePositions(idMap);
+    size_t dim = static_cast<size_t>(index->d);
+    float *rows = flatIndex->get_xb();
+    std::vector<float> appendData;
+    std::vector<long> appendLabels;
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        auto it = positions.find(labels[i]);
+        if (it != positions.end())
+        {
+            std::copy(vectors.begin() + i * dim, vectors.begin() + (i + 1) * dim, rows + it->second * dim);
+        }
+        else
+        {
+            appendData.insert(appendData.end(), vectors.begin() + i * dim, vectors.begin() + (i + 1) * dim);
+            appendLabels.push_back(labels[i]);
+        }
+    }
+    if (!appendLabels.empty())
+    {
+        size_t firstRow = static_cast<size_t>(index->ntotal);
+        index->add_with_ids(appendLabels.size(), appendData.data(), appendLabels.data());
+        for (size_t i = 0; i < appendLabels.size(); i++)
+        {
+            positions[appendLabels[i]] = firstRow + i;
+        }
+    }
+}
+
+/**
+ * @brief 获取 IndexIDMap 包装的 IndexFlat
+ * @param idMap 输出参数，外层的 IndexIDMap
+ * @return 索引不是 IndexIDMap 包装的 IndexFlat 时返回nullptr
+ */
+faiss::IndexFlat *FaissIndex::getFlatIndex(faiss::IndexIDMap **idMap) const
+{
+    *idMap = dynamic_cast<faiss::IndexIDMap *>(index);
+    return *idMap ? dynamic_cast<faiss::IndexFlat *>((*idMap)->index) : nullptr;
+}
+
+/**
+ * @brief 按需重建ID到 IndexFlat 行号的映射
+ * @param idMap 外层的 IndexIDMap
+ */
+void FaissIndex::ensurePositions(const faiss::IndexIDMap *idMap)
+{
+    if (positionsValid)
+    {
+        return;
+    }
+    positions.clear();
+    positions.reserve(idMap->id_map.size());
+    for (size_t i = 0; i < idMap->id_map.size(); i++)
+    {
+        positions[static_cast<long>(idMap->id_map[i])] = i;
+    }
+    positionsValid = true;
 }
 
 /**
@@ -59,11 +228,15 @@ void FaissIndex::insertVectors(const std::vector<float> &data, uint64_t label)
  *
  * @param query 查询向量数据，格式为一维浮点数数组，可包含多个查询向量
  * @param k 每个查询需要返回的最近邻居数量
+ * @param bitmap 可选的ID过滤位图
+ * @param deadline 搜索的截止时间
+ * @param partial 可选的输出参数，截止时间前未扫描完全部向量时置为true
  * @return std::pair<std::vector<long>, std::vector<float>> 返回一个对，第一个元素是匹配向量的ID，第二个元素是对应的距离值
  *
  * @note 返回的向量ID和距离值按照查询结果顺序排列
  */
-std::pair<std::vector<long>, std::vector<float>> FaissIndex::searchVectors(const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap)
+std::pair<std::vector<long>, std::vector<float>> FaissIndex::searchVectors(const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap,
+                                                                           std::chrono::steady_clock::time_point deadline, bool *partial)
 {
     // 从索引的维度属性中获取待查询向量的维度
     int dim = index->d;
@@ -77,7 +250,50 @@ std::pair<std::vector<long>, std::vector<float>> FaissIndex::searchVectors(const
     // 创建一个存储所有查询结果距离的动态数组，大小也为查询向量的数量乘以k
     std::vector<float> distances(num_queries * k);
 
-    // 如果传入了 bitmap，则使用 RoaringBitmapIDSelector 初始化 faiss::SearchParams
+    // 余弦相似度：查询向量只归一化一次，之后按内积搜索
+    std::vector<float> normalizedQuery;
+    const std::vector<float> &searchQuery = prepareVectors(query, &normalizedQuery);
+
+    // 过滤搜索按位图中的ID定位行时需要行号映射；映射失效时（删除或加载之后）先在独占锁内重建
+    if (bitmap != nullptr)
+    {
+        std::shared_lock<std::shared_mutex> checkLock(mutex);
+        bool valid = positionsValid;
+        checkLock.unlock();
+        if (!valid)
+        {
+            std::unique_lock<std::shared_mutex> rebuildLock(mutex);
+            faiss::IndexIDMap *idMap = nullptr;
+            if (getFlatIndex(&idMap))
+            {
+                ensurePositions(idMap);
+            }
+        }
+    }
+
+    // 搜索期间持有共享锁，写入需要等待正在进行的搜索完成
+    std::shared_lock<std::shared_mutex> lock(mutex);
+
+    // 带过滤条件或截止时间时直接扫描：过滤搜索只计算匹配行的距离，截止时间按块检查；
+    // 其余情况交给 faiss 的批量搜索（多个查询时使用矩阵乘法）
+    if (bitmap != nullptr || deadline != std::chrono::steady_clock::time_point::max())
+    {
+        bool expired = false;
+        if (scanFlat(searchQuery, k, bitmap, deadline, &indices, &distances, &expired))
+        {
+            if (partial && expired)
+            {
+                *partial = true;
+            }
+            if (cosine)
+            {
+                toCosineDistances(indices, &distances);
+            }
+            return {indices, distances};
+        }
+    }
+
+    // 索引不是 IndexIDMap 包装的 IndexFlat 时，过滤条件通过 RoaringBitmapIDSelector 交给 faiss
 
     faiss::SearchParameters searchParams;
     RoaringBitmapIDSelector idSelector(bitmap);
@@ -87,24 +303,175 @@ std::pair<std::vector<long>, std::vector<float>> FaissIndex::searchVectors(const
     }
 
     // 执行查询操作，传入查询向量的数量、数据、k值、距离和向量ID结果的指针、搜索参数(过滤条件)
-    index->search(num_queries, query.data(), k,
+    index->search(num_queries, searchQuery.data(), k,
                   distances.data(), indices.data(), &searchParams);
 
-    // 打印查询结果
-    globalLogger->debug("Retrieved values:");
-    for (size_t i = 0; i < indices.size(); ++i)
+    LOG_TRACE("Faiss search finished: numQueries = {}, k = {}", num_queries, k);
+
+    if (cosine)
     {
-        if (indices[i] != -1)
+        toCosineDistances(indices, &distances);
+    }
+
+    return {indices, distances};
+}
+
+/**
+ * @brief 直接扫描扁平索引中的向量，支持截止时间和过滤位图
+ * @param query 查询向量数据
+ * @param k 每个查询返回的最近邻数量
+ * @param bitmap 可选的ID过滤位图
+ * @param deadline 截止时间
+ * @param indices 输出参数，结果ID
+ * @param distances 输出参数，结果距离
+ * @param partial 输出参数，是否因超时而未扫描完
+ * @return 能否直接扫描
+ *
+ * 直接读取 IndexFlat 中连续存放的向量，用 faiss 的SIMD距离函数计算距离，每个查询各自维护一个大小为k的堆，
+ * 多个查询分发到全局线程池并行扫描，调用方需持有共享锁。要扫描的行在所有查询开始前确定一次：
+ * - 匹配数少（见 FLAT_FILTER_SPARSE_DIVISOR）且行号映射有效时，把位图中的ID映射为行号并排序，只扫描这些行
+ * - 否则扫描所有行，位图转换为按ID索引的位集后逐行判断（位集过大时逐个查询位图）
+ * 每扫描 FLAT_SCAN_BLOCK_SIZE 行检查一次截止时间，第一块总会扫描，保证超时时也有结果可返回。
+ * 距离与 faiss 的搜索结果一致：L2为距离的平方，内积越大越相似；不足k个的位置ID为-1。
+ */
+bool FaissIndex::scanFlat(const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap,
+                          std::chrono::steady_clock::time_point deadline,
+                          std::vector<long> *indices, std::vector<float> *distances, bool *partial)
+{
+    faiss::IndexIDMap *idMap = nullptr;
+    faiss::IndexFlat *flatIndex = getFlatIndex(&idMap);
+    if (!flatIndex)
+    {
+        return false;
+    }
+
+    size_t dim = static_cast<size_t>(index->d);
+    size_t numQueries = query.size() / dim;
+    size_t total = static_cast<size_t>(flatIndex->ntotal);
+    const float *data = flatIndex->get_xb();
+    const faiss::idx_t *ids = idMap->id_map.data();
+    bool isL2 = index->metric_type == faiss::METRIC_L2;
+
+    // 匹配数少时只扫描匹配的行
+    std::vector<size_t> rows;
+    bool sparse = false;
+    // 匹配数多时按ID索引的位集，为空时逐个查询位图
+    std::vector<uint64_t> idBits;
+    if (bitmap)
+    {
+        uint64_t matches = roaring_bitmap_get_cardinality(bitmap);
+        if (positionsValid && matches * FLAT_FILTER_SPARSE_DIVISOR <= total)
         {
-            globalLogger->debug("ID: {}, Distance: {}", indices[i], distances[i]);
+            std::vector<uint32_t> matchedIds(matches);
+            roaring_bitmap_to_uint32_array(bitmap, matchedIds.data());
+            rows.reserve(matchedIds.size());
+            for (uint32_t id : matchedIds)
+            {
+                auto found = positions.find(static_cast<long>(id));
+                if (found != positions.end())
+                {
+                    rows.push_back(found->second);
+                }
+            }
+            // 按行号顺序访问，读取向量时是顺序的内存访问
+            std::sort(rows.begin(), rows.end());
+            sparse = true;
         }
-        else
+        else if (matches > 0 &&
+                 roaring_bitmap_maximum(bitmap) / FLAT_FILTER_DENSE_BITS_PER_ROW <= total)
         {
-            globalLogger->debug("No specific value found");
+            idBits.assign(roaring_bitmap_maximum(bitmap) / 64 + 1, 0);
+            roaring_iterate(bitmap, [](uint32_t id, void *bits) -> bool
+                            {
+                                static_cast<uint64_t *>(bits)[id / 64] |= uint64_t(1) << (id % 64);
+                                return true;
+                            },
+                            idBits.data());
         }
     }
+    // 判断一行是否满足过滤条件；ID超出32位时不在位图中
+    auto isMember = [&](size_t row) -> bool
+    {
+        faiss::idx_t id = ids[row];
+        if (id < 0 || id > std::numeric_limits<uint32_t>::max())
+        {
+            return false;
+        }
+        if (!idBits.empty())
+        {
+            size_t word = static_cast<size_t>(id) / 64;
+            return word < idBits.size() && (idBits[word] >> (id % 64) & 1);
+        }
+        return roaring_bitmap_contains(bitmap, static_cast<uint32_t>(id));
+    };
+    size_t scanCount = sparse ? rows.size() : total;
 
-    return {indices, distances};
+    // closer(a, b) 表示a比b更相似；以它为比较函数的堆，堆顶是当前k个结果中最不相似的一个
+    auto closer = [isL2](const std::pair<float, long> &a, const std::pair<float, long> &b)
+    {
+        return isL2 ? a.first < b.first : a.first > b.first;
+    };
+
+    std::atomic<bool> expired{false};
+    getGlobalThreadPool()->parallelFor(0, numQueries, [&](size_t q)
+    {
+        const float *queryVector = query.data() + q * dim;
+        std::vector<std::pair<float, long>> heap;
+        heap.reserve(k);
+
+        for (size_t blockBegin = 0; blockBegin < scanCount; blockBegin += FLAT_SCAN_BLOCK_SIZE)
+        {
+            if (blockBegin > 0 && std::chrono::steady_clock::now() >= deadline)
+            {
+                expired = true;
+                break;
+            }
+            size_t blockEnd = std::min(scanCount, blockBegin + FLAT_SCAN_BLOCK_SIZE);
+            for (size_t i = blockBegin; i < blockEnd; i++)
+            {
+                size_t row = sparse ? rows[i] : i;
+                if (bitmap && !sparse && !isMember(row))
+                {
+                    continue;
+                }
+                const float *vector = data + row * dim;
+                float distance = isL2 ? faiss::fvec_L2sqr(queryVector, vector, dim)
+                                      : faiss::fvec_inner_product(queryVector, vector, dim);
+                std::pair<float, long> candidate(distance, static_cast<long>(ids[row]));
+                if (heap.size() < static_cast<size_t>(k))
+                {
+                    heap.push_back(candidate);
+                    std::push_heap(heap.begin(), heap.end(), closer);
+                }
+                else if (closer(candidate, heap.front()))
+                {
+                    std::pop_heap(heap.begin(), heap.end(), closer);
+                    heap.back() = candidate;
+                    std::push_heap(heap.begin(), heap.end(), closer);
+                }
+            }
+        }
+
+        // 按由好到差的顺序写入结果，不足k个的位置与 faiss 一致填充
+        std::sort_heap(heap.begin(), heap.end(), closer);
+        for (size_t i = 0; i < static_cast<size_t>(k); i++)
+        {
+            if (i < heap.size())
+            {
+                (*indices)[q * k + i] = heap[i].second;
+                (*distances)[q * k + i] = heap[i].first;
+            }
+            else
+            {
+                (*indices)[q * k + i] = -1;
+                (*distances)[q * k + i] = isL2 ? std::numeric_limits<float>::max()
+                                               : -std::numeric_limits<float>::max();
+            }
+        }
+    });
+
+    *partial = expired;
+    return true;
 }
 
 /**
@@ -120,9 +487,12 @@ std::pair<std::vector<long>, std::vector<float>> FaissIndex::searchVectors(const
 void FaissIndex::removeVectors(const std::vector<long> &ids)
 {
     // 将底层索引转换为IndexIDMap类型
-    faiss::IndexIDMap *idMap = static_cast<faiss::IndexIDMap *>(index);
+    faiss::IndexIDMap *idMap = dynamic_cast<faiss::IndexIDMap *>(index);
     if (idMap)
     {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // remove_ids 会压缩剩余向量的行号
+        positionsValid = false;
         // 创建一个IDSelectorBatch对象，用于指定要删除的ID
         faiss::IDSelectorBatch idSelectorBatch(ids.size(), ids.data());
         // 使用IDSelectorBatch删除指定的向量
@@ -143,8 +513,9 @@ void FaissIndex::removeVectors(const std::vector<long> &ids)
  *
  * 使用faiss::write_index将当前FAISS索引保存到指定的filePath文件。
  */
-void FaissIndex::saveIndex(const std::string &filePath)
+void FaissIndex::saveIndex(const std::string &filePath) const
 {
+    std::shared_lock<std::shared_mutex> lock(mutex);
     faiss::write_index(index, filePath.c_str());
 }
 
@@ -162,6 +533,8 @@ void FaissIndex::loadIndex(const std::string &filePath)
     if (file.good())
     {
         file.close(); // 关闭文件流
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        positionsValid = false;
         // 如果当前索引指针非空，释放旧索引的内存
         if (index != nullptr)
         {
@@ -176,4 +549,41 @@ void FaissIndex::loadIndex(const std::string &filePath)
         globalLogger->warn("FLAT index file not found: {}. Skipping load FLAT index.",
                            filePath);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 获取索引的向量维度
+ * @return 向量维度
+ */
+int FaissIndex::getDim() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return index->d;
+}
+
+size_t FaissIndex::getVectorCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return static_cast<size_t>(index->ntotal);
+}
+
+/**
+ * @brief 读取索引中的全部向量及其ID
+ * @param data 输出参数，向量数据
+ * @param labels 输出参数，与向量一一对应的ID
+ * @return 能否读取
+ */
+bool FaissIndex::getVectors(std::vector<float> *data, std::vector<long> *labels) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    faiss::IndexIDMap *idMap = nullptr;
+    faiss::IndexFlat *flatIndex = getFlatIndex(&idMap);
+    if (!flatIndex)
+    {
+        return false;
+    }
+    const float *rows = flatIndex->get_xb();
+    data->assign(rows, rows + static_cast<size_t>(flatIndex->ntotal) * index->d);
+    labels->assign(idMap->id_map.begin(), idMap->id_map.end());
+    return true;
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 #include "faiss/Index.h"
+#include "faiss/IndexFlat.h"
+#include "faiss/IndexIDMap.h"
 #include "faiss/impl/IDSelector.h"
 #include "faiss/utils/utils.h"
 #include "roaring/roaring.h"
@@ -38,6 +43,13 @@ struct RoaringBitmapIDSelector : faiss::IDSelector
  * @brief FAISS 索引管理类
  *
  * 该类用于管理 FAISS 索引对象，支持向量的插入、查询和删除操作。
+ *
+ * 所有操作都是线程安全的：搜索、保存和统计持有共享锁，多个搜索可以并行执行；
+ * 写入、删除和加载持有独占锁。替换已有向量时直接覆盖 IndexFlat 中对应的行（见 upsertVectors），
+ * 独占锁只持有 O(维度) 的时间，搜索也不会看到先删除后写入之间向量缺失的中间状态。
+ *
+ * 余弦相似度索引使用内积度量的 IndexFlat：写入的向量和查询向量各归一化一次，
+ * 搜索结果的距离转换为余弦距离（1 - 余弦相似度），与HNSW索引一致地按由近到远排列。
  */
 class FaissIndex
 {
@@ -45,8 +57,17 @@ public:
     /**
      * @brief 构造函数，接收一个指向FAISS索引对象的指针
      * @param index 指向 FAISS 索引对象的指针
+     * @param cosine 是否为余弦相似度索引，为true时index须使用内积度量
      */
-    FaissIndex(faiss::Index *index);
+    FaissIndex(faiss::Index *index, bool cosine = false);
+
+    /**
+     * @brief 析构函数，释放持有的 FAISS 索引对象
+     */
+    ~FaissIndex();
+
+    FaissIndex(const FaissIndex &) = delete;
+    FaissIndex &operator=(const FaissIndex &) = delete;
 
     /**
      * @brief 向索引中插入单个向量及其标签
@@ -55,15 +76,38 @@ public:
      */
     void insertVectors(const std::vector<float> &data, uint64_t label);
 
+    /**
+     * @brief 向索引中批量插入向量及其标签
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param labels 每个向量对应的标签（ID）
+     */
+    void insertVectors(const std::vector<float> &data, const std::vector<long> &labels);
+
+    /**
+     * @brief 批量写入向量，已存在的ID原地替换，不存在的ID追加
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param labels 每个向量对应的标签（ID），同一批内不应重复
+     *
+     * 整个批次在一次独占锁内完成，搜索要么看到旧向量、要么看到新向量
+     */
+    void upsertVectors(const std::vector<float> &data, const std::vector<long> &labels);
+
     /**
      * @brief 查询与输入向量最近邻的k个向量
      * @param query 查询向量数据（可包含多个查询向量）
      * @param k 每个查询返回的最近邻数量
      * @param bitmap 可选参数，指定ID过滤的 Roaring Bitmap
+     * @param deadline 搜索的截止时间，默认不限制
+     * @param partial 可选的输出参数，截止时间前未扫描完全部向量时置为true
      * @return 返回一个 pair，第一个为匹配向量的ID数组，第二个为对应的距离数组
+     *
+     * 设置了截止时间时改为分块扫描，每扫描完一块检查一次是否超时，超时后返回已扫描部分的最近邻。
+     * 带过滤位图时只计算匹配向量的距离：匹配数少时按位图中的ID定位行，耗时随匹配数而不是集合大小增长
      */
     std::pair<std::vector<long>, std::vector<float>> searchVectors(
-        const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap = nullptr);
+        const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap = nullptr,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+        bool *partial = nullptr);
 
     /**
      * @brief 从索引中删除指定ID的向量
@@ -75,7 +119,7 @@ public:
      * @brief 保存索引到文件
      * @param filePath 保存路径
      */
-    void saveIndex(const std::string &filePath);
+    void saveIndex(const std::string &filePath) const;
 
     /**
      * @brief 从文件加载索引
@@ -83,9 +127,94 @@ public:
      */
     void loadIndex(const std::string &filePath);
 
+    /**
+     * @brief 获取索引的向量维度
+     * @return 向量维度
+     */
+    int getDim() const;
+
+    /**
+     * @brief 获取索引中的向量数量
+     * @return 向量数量
+     */
+    size_t getVectorCount() const;
+
+    /**
+     * @brief 读取索引中的全部向量及其ID
+     * @param data 输出参数，向量数据（按维度依次拼接，余弦相似度索引为归一化后的向量）
+     * @param labels 输出参数，与向量一一对应的ID
+     * @return 索引不是 IndexIDMap 包装的 IndexFlat 时返回false
+     */
+    bool getVectors(std::vector<float> *data, std::vector<long> *labels) const;
+
+    /**
+     * @brief 把内积搜索得到的余弦相似度转换为余弦距离
+     * @param indices 搜索结果ID，为-1的位置不转换
+     * @param distances 输入输出参数，搜索结果距离
+     */
+    static void toCosineDistances(const std::vector<long> &indices, std::vector<float> *distances);
+
 private:
+    /**
+     * @brief 直接扫描扁平索引中的向量，支持截止时间和过滤位图
+     * @param query 查询向量数据（可包含多个查询向量）
+     * @param k 每个查询返回的最近邻数量
+     * @param bitmap 可选的ID过滤位图，只计算位图中ID的距离
+     * @param deadline 截止时间，不限制时为 time_point::max()
+     * @param indices 输出参数，每个查询占k个位置的结果ID
+     * @param distances 输出参数，与indices对应的距离
+     * @param partial 输出参数，截止时间前未扫描完全部向量时置为true
+     * @return 索引不是 IndexIDMap 包装的 IndexFlat 时无法直接扫描，返回false且不写入结果
+     */
+    bool scanFlat(const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap,
+                  std::chrono::steady_clock::time_point deadline,
+                  std::vector<long> *indices, std::vector<float> *distances, bool *partial);
+
+    /**
+     * @brief 获取 IndexIDMap 包装的 IndexFlat
+     * @param idMap 输出参数，外层的 IndexIDMap
+     * @return 索引不是 IndexIDMap 包装的 IndexFlat 时返回nullptr
+     */
+    faiss::IndexFlat *getFlatIndex(faiss::IndexIDMap **idMap) const;
+
+    /**
+     * @brief 按需重建ID到 IndexFlat 行号的映射，调用方需持有独占锁
+     * @param idMap 外层的 IndexIDMap
+     */
+    void ensurePositions(const faiss::IndexIDMap *idMap);
+
     /**
      * @brief 指向FAISS索引对象的指针
      */
     faiss::Index *index;
+
+    /**
+     * @brief 按余弦相似度搜索时，返回归一化后的向量
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param buffer 存放归一化结果的缓冲区
+     * @return 不是余弦相似度索引时返回data本身，否则返回buffer
+     */
+    const std::vector<float> &prepareVectors(const std::vector<float> &data, std::vector<float> *buffer) const;
+
+    /**
+     * @brief 是否为余弦相似度索引
+     */
+    bool cosine;
+
+    /**
+     * @brief 读写锁：搜索、保存持有共享锁，写入、删除、加载持有独占锁
+     */
+    mutable std::shared_mutex mutex;
+
+    /**
+     * @brief ID到 IndexFlat 行号的映射，用于原地替换向量
+     *
+     * 第一次替换时按 id_map 建立；删除向量会压缩行号，加载会替换索引，两者都会使映射失效
+     */
+    std::unordered_map<long, size_t> positions;
+
+    /**
+     * @brief positions 是否与索引一致
+     */
+    bool positionsValid = false;
 };
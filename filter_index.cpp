@@ -1,12 +1,24 @@
 #include "filter_index.h"
 #include "logger.h"
 #include <sstream>
+#include <utility>
 
 // @brief 构造函数
 FilterIndex::FilterIndex()
 {
 }
 
+/**
+ * @brief 把新建或复制得到的位图包装为已发布的位图
+ * @param bitmap 位图
+ * @return 已发布的位图
+ */
+FilterIndex::BitmapPtr FilterIndex::publish(roaring_bitmap_t *bitmap)
+{
+    return BitmapPtr(bitmap, [](const roaring_bitmap_t *published)
+                     { roaring_bitmap_free(published); });
+}
+
 /**
  * @brief 添加整数字段过滤条件
  * @param fieldName 字段名
@@ -17,15 +29,10 @@ void FilterIndex::addIntFieldFilter(const std::string &fieldName,
                                     int64_t value,
                                     uint64_t id)
 {
-    // 创建新的bitmap对象，用于存储满足过滤条件的recordID
-    roaring_bitmap_t *bitmap = roaring_bitmap_create();
-    // 添加recordID
-    roaring_bitmap_add(bitmap, id);
-    // 将bitmap对象添加到intFieldFilter中
-    intFieldFilter[fieldName][value] = bitmap;
+    updateIntFieldFilters({IntFieldUpdate{fieldName, false, 0, value, id}});
     // 记录日志
-    globalLogger->debug("Added int field filter: fieldName={}, value={}, id={}",
-                        fieldName, value, id);
+    LOG_DEBUG("Added int field filter: fieldName={}, value={}, id={}",
+              fieldName, value, id);
 }
 
 /**
@@ -43,45 +50,91 @@ void FilterIndex::updateIntFieldFilter(const std::string &fieldName,
     // 记录日志 (旧值或新值)
     if (oldValue != nullptr)
     {
-        globalLogger->debug("Updated int field filter: fieldName={}, oldValue={}, newValue={}, id={}",
-                            fieldName, *oldValue, newValue, id);
+        LOG_DEBUG("Updated int field filter: fieldName={}, oldValue={}, newValue={}, id={}",
+                  fieldName, *oldValue, newValue, id);
     }
     else
     {
-        globalLogger->debug("Added int field filter: fieldName={}, oldValue=nullptr, newValue={}, id={}",
-                            fieldName, newValue, id);
+        LOG_DEBUG("Added int field filter: fieldName={}, oldValue=nullptr, newValue={}, id={}",
+                  fieldName, newValue, id);
     }
 
-    // 查找字段对应的map
-    auto it = intFieldFilter.find(fieldName);
-    if (it != intFieldFilter.end())
+    updateIntFieldFilters({IntFieldUpdate{fieldName, oldValue != nullptr,
+                                          oldValue != nullptr ? *oldValue : 0, newValue, id}});
+}
+
+/**
+ * @brief 批量更新整数字段过滤条件
+ * @param updates 按顺序应用的更新
+ *
+ * 1. 对每个受影响的（字段名, 字段值），在共享锁内取得当前位图并复制一份（不存在时新建）
+ * 2. 在锁外的副本上把ID从旧值的位图移到新值的位图
+ * 3. 在独占锁内一次性替换所有被修改的位图
+ */
+void FilterIndex::updateIntFieldFilters(const std::vector<IntFieldUpdate> &updates)
+{
+    if (updates.empty())
     {
-        std::map<long, roaring_bitmap_t *> &valueMap = it->second;
+        return;
+    }
+    std::lock_guard<std::mutex> writeLock(writeMutex);
 
-        // 如果有旧值，从旧值的位图中移除ID
-        auto oldBitmapItr = (oldValue != nullptr) ? valueMap.find(*oldValue) : valueMap.end();
-        if (oldBitmapItr != valueMap.end())
+    // 本批次的副本，发布前只有当前写入者可见
+    std::map<std::pair<std::string, int64_t>, roaring_bitmap_t *> copies;
+    // 取得（字段名, 字段值）的副本；位图不存在且create为false时返回nullptr
+    auto getCopy = [&](const std::string &fieldName, int64_t value, bool create) -> roaring_bitmap_t *
+    {
+        auto key = std::make_pair(fieldName, value);
+        auto copyItr = copies.find(key);
+        if (copyItr != copies.end())
         {
-            roaring_bitmap_t *oldBitmap = oldBitmapItr->second;
-            roaring_bitmap_remove(oldBitmap, id);
+            return copyItr->second;
         }
+        BitmapPtr current;
+        {
+            std::shared_lock<std::shared_mutex> lock(filterMutex);
+            auto fieldItr = intFieldFilter.find(fieldName);
+            if (fieldItr != intFieldFilter.end())
+            {
+                auto valueItr = fieldItr->second.find(value);
+                if (valueItr != fieldItr->second.end())
+                {
+                    current = valueItr->second;
+                }
+            }
+        }
+        if (!current && !create)
+        {
+            return nullptr;
+        }
+        roaring_bitmap_t *copy = current ? roaring_bitmap_copy(current.get()) : roaring_bitmap_create();
+        copies[key] = copy;
+        return copy;
+    };
 
-        // 将ID添加到新值的位图中
-        // 如果新值对应的位图不存在，则创建新的位图
-        auto newBitmapItr = valueMap.find(newValue);
-        if (newBitmapItr == valueMap.end())
+    for (const IntFieldUpdate &update : updates)
+    {
+        // 如果有旧值，从旧值的位图中移除ID
+        if (update.hasOldValue)
         {
-            roaring_bitmap_t *newBitmap = roaring_bitmap_create();
-            valueMap[newValue] = newBitmap;
-            newBitmapItr = valueMap.find(newValue);
+            roaring_bitmap_t *oldBitmap = getCopy(update.fieldName, update.oldValue, false);
+            if (oldBitmap != nullptr)
+            {
+                roaring_bitmap_remove(oldBitmap, update.id);
+            }
+        }
+        // 将ID添加到新值的位图中，位图不存在时创建
+        if (update.hasNewValue)
+        {
+            roaring_bitmap_add(getCopy(update.fieldName, update.newValue, true), update.id);
         }
-        roaring_bitmap_t *newBitmap = newBitmapItr->second;
-        roaring_bitmap_add(newBitmap, id);
     }
-    else
+
+    // 发布所有副本，被替换的旧位图在正在进行的查询释放引用后回收
+    std::unique_lock<std::shared_mutex> lock(filterMutex);
+    for (const auto &entry : copies)
     {
-        // 字段不存在，直接添加新过滤条件
-        addIntFieldFilter(fieldName, newValue, id);
+        intFieldFilter[entry.first.first][entry.first.second] = publish(entry.second);
     }
 }
 
@@ -91,46 +144,54 @@ void FilterIndex::updateIntFieldFilter(const std::string &fieldName,
  * @param op 过滤操作符
  * @param value 过滤值
  * @param resultBitmap 结果位图 (输出)
+ *
+ * 只在共享锁内取得位图的引用，并集运算在锁外进行
  */
 void FilterIndex::getIntFieldFilterBitmap(const std::string &fieldName,
                                           Operation op,
                                           int64_t value,
                                           roaring_bitmap_t *resultBitmap)
 {
-    // 查找字段对应的map
-    auto it = intFieldFilter.find(fieldName);
-    if (it != intFieldFilter.end())
+    std::vector<BitmapPtr> bitmaps;
     {
-        std::map<long, roaring_bitmap_t *> &valueMap = it->second;
-
-        if (op == Operation::EQUAL)
+        std::shared_lock<std::shared_mutex> lock(filterMutex);
+        // 查找字段对应的map
+        auto it = intFieldFilter.find(fieldName);
+        if (it != intFieldFilter.end())
         {
-            // 等于操作：获取值对应的位图并进行并集
-            auto bitmapItr = valueMap.find(value);
-            if (bitmapItr != valueMap.end())
+            const std::map<int64_t, BitmapPtr> &valueMap = it->second;
+
+            if (op == Operation::EQUAL)
             {
-                globalLogger->debug("Retrieved EQUAL bitmap for filter: fieldName={}, value={}",
-                                    fieldName, value);
-                // 将找到的位图与结果位图进行并集操作
-                roaring_bitmap_or_inplace(resultBitmap, bitmapItr->second);
+                // 等于操作：获取值对应的位图
+                auto bitmapItr = valueMap.find(value);
+                if (bitmapItr != valueMap.end())
+                {
+                    bitmaps.push_back(bitmapItr->second);
+                }
             }
-        }
-        else if (op == Operation::NOT_EQUAL)
-        {
-            // 不等于操作：获取所有不等于value的位图，并进行并集运算
-            for (const auto &pair : valueMap)
+            else if (op == Operation::NOT_EQUAL)
             {
-                if (pair.first != value)
+                // 不等于操作：获取所有不等于value的位图
+                for (const auto &pair : valueMap)
                 {
-                    // 将不等于value的位图与结果位图进行并集操作
-                    roaring_bitmap_or_inplace(resultBitmap, pair.second);
+                    if (pair.first != value)
+                    {
+                        bitmaps.push_back(pair.second);
+                    }
                 }
             }
-            globalLogger->debug("Retrieved NOT_EQUAL bitmap for filter: fieldName={}, value={}",
-                                fieldName, value);
+            // TODO: 实现其他操作符
         }
-        // TODO: 实现其他操作符
     }
+
+    // 将找到的位图与结果位图进行并集操作
+    for (const BitmapPtr &bitmap : bitmaps)
+    {
+        roaring_bitmap_or_inplace(resultBitmap, bitmap.get());
+    }
+    LOG_DEBUG("Retrieved filter bitmap: fieldName={}, value={}, bitmaps={}",
+              fieldName, value, bitmaps.size());
 }
 
 /**
@@ -141,16 +202,23 @@ std::string FilterIndex::serializeIntFieldFilter()
 {
     std::ostringstream oss;
 
+    // 在共享锁内复制一份索引的引用，序列化时不阻塞写入
+    std::map<std::string, std::map<int64_t, BitmapPtr>> pinnedFilter;
+    {
+        std::shared_lock<std::shared_mutex> lock(filterMutex);
+        pinnedFilter = intFieldFilter;
+    }
+
     // 将intFieldFilter序列化为字符串
-    for (const auto &fieldEntry : intFieldFilter)
+    for (const auto &fieldEntry : pinnedFilter)
     {
         const std::string &fieldName = fieldEntry.first;
-        const std::map<int64_t, roaring_bitmap_t *> &valueMap = fieldEntry.second;
+        const std::map<int64_t, BitmapPtr> &valueMap = fieldEntry.second;
 
         for (const auto &valueEntry : valueMap)
         {
             int64_t value = valueEntry.first;
-            const roaring_bitmap_t *bitmap = valueEntry.second;
+            const roaring_bitmap_t *bitmap = valueEntry.second.get();
 
             // 将 位图 序列化为字节数组
             uint32_t bitmapSize = roaring_bitmap_portable_size_in_bytes(bitmap);
@@ -177,6 +245,7 @@ void FilterIndex::deserializeIntFieldFilter(const std::string &serializedData)
 {
     std::istringstream iss(serializedData);
     std::string line;
+    std::map<std::string, std::map<int64_t, BitmapPtr>> loadedFilter;
 
     // 逐行读取并反序列化每个条目
     while (std::getline(iss, line))
@@ -196,7 +265,17 @@ void FilterIndex::deserializeIntFieldFilter(const std::string &serializedData)
         roaring_bitmap_t *bitmap = roaring_bitmap_portable_deserialize(serializedBitmap.data());
 
         // 将位图添加到intFieldFilter中
-        intFieldFilter[fieldName][value] = bitmap;
+        loadedFilter[fieldName][value] = publish(bitmap);
+    }
+
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    std::unique_lock<std::shared_mutex> lock(filterMutex);
+    for (auto &fieldEntry : loadedFilter)
+    {
+        for (auto &valueEntry : fieldEntry.second)
+        {
+            intFieldFilter[fieldEntry.first][valueEntry.first] = std::move(valueEntry.second);
+        }
     }
 }
 
@@ -4,6 +4,8 @@
 #include "scalar_storage.h"
 #include <set>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <string>
 #include <map>
@@ -13,6 +15,10 @@
  *
  * 该类用于管理和查询基于字段值的过滤条件索引。
  * 使用RoaringBitmap作为底层存储结构，提供高效的位图操作。
+ *
+ * 位图发布后不再修改（写时复制）：写入时复制受影响的位图，在副本上修改，
+ * 再在短暂的独占锁内替换索引中的指针。查询只在共享锁内取得位图的引用，
+ * 随后在锁外读取，因此查询不会因写入而等待，正在读取的旧位图在最后一个引用释放后才回收。
  */
 class FilterIndex
 {
@@ -30,6 +36,25 @@ public:
         // TODO: 其他操作符
     };
 
+    /**
+     * @brief 整数字段过滤条件的一次更新
+     *
+     * 代价：每次发布都要完整复制受影响的位图，一次单条写入的代价与这些位图的大小成正比，
+     * 而不是O(1)。这是查询完全不等待写入的代价；对大位图频繁的单条写入应改用 /bulk_upsert，
+     * 一个批次中同一个（字段名, 字段值）的位图只复制一次（见 updateIntFieldFilters）。
+     * 同一集合的写入本来就在集合的写入锁内串行执行，复制不会额外降低写入的并发度；
+     * 值没有变化的字段不产生更新（见 VectorDatabase::collectFilterUpdates），不会触发复制
+     */
+    struct IntFieldUpdate
+    {
+        std::string fieldName; ///< 字段名称
+        bool hasOldValue;      ///< 记录是否有旧的字段值
+        int64_t oldValue;      ///< 旧的字段值，hasOldValue为false时忽略
+        int64_t newValue;      ///< 新的字段值
+        uint64_t id;           ///< 记录ID
+        bool hasNewValue = true; ///< 为false时只从旧值的位图中移除ID（删除记录）
+    };
+
     FilterIndex();
 
     /**
@@ -54,6 +79,14 @@ public:
                               int64_t newValue,
                               uint64_t id);
 
+    /**
+     * @brief 批量更新整数字段的过滤条件
+     * @param updates 按顺序应用的更新
+     *
+     * 每个受影响的位图在一批中只复制一次，全部修改完成后一起发布
+     */
+    void updateIntFieldFilters(const std::vector<IntFieldUpdate> &updates);
+
     /**
      * @brief 获取满足过滤条件的recordID位图
      * @param fieldName 字段名称
@@ -104,6 +137,18 @@ public:
     // TODO: 其他类型字段过滤器
 
 private:
+    /**
+     * @brief 已发布的只读位图，最后一个引用释放时回收
+     */
+    using BitmapPtr = std::shared_ptr<const roaring_bitmap_t>;
+
+    /**
+     * @brief 把新建或复制得到的位图包装为已发布的位图
+     * @param bitmap 位图，所有权转移给返回值
+     * @return 已发布的位图
+     */
+    static BitmapPtr publish(roaring_bitmap_t *bitmap);
+
     /**
      * @brief 整数字段过滤索引
      *
@@ -111,6 +156,16 @@ private:
      * 第二层map的key是字段值
      * 最内层是存储记录ID的RoaringBitmap
      */
-    std::map<std::string, std::map<int64_t, roaring_bitmap_t *>> intFieldFilter;
+    std::map<std::string, std::map<int64_t, BitmapPtr>> intFieldFilter;
+
+    /**
+     * @brief 保护 intFieldFilter 本身（查找和替换位图指针），不在锁内读取或修改位图
+     */
+    mutable std::shared_mutex filterMutex;
+
+    /**
+     * @brief 写入锁，保证同一时刻只有一个写入者复制和发布位图，避免并发写入互相覆盖
+     */
+    std::mutex writeMutex;
     // TODO: 其他类型字段过滤索引
 };
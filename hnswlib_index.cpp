@@ -1,5 +1,10 @@
 #include "hnswlib_index.h"
 #include "logger.h"
+#include "search_planner.h"
+#include "thread_pool.h"
+#include "faiss/utils/distances.h"
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <fstream>
 #include <iostream>
@@ -13,28 +18,44 @@
  * @param efConstruction 构建最大近邻时的最大候选邻居数，默认为200
  *
  * 初始化HNSW索引，创建向量空间和索引结构。
- * 目前仅支持L2距离度量和内积距离度量
+ * 支持L2距离、内积和余弦相似度，余弦相似度与内积共用 hnswlib 的SIMD内积空间
  */
 HNSWLibIndex::HNSWLibIndex(int dim, size_t maxElements, IndexFactory::MetricType metric,
-                           int M, int efConstruction) : maxElements(maxElements)
+                           int M, int efConstruction) : dim(dim)
 {
-    hnswlib::SpaceInterface<float> *space;
-
     // 根据度量类型创建对应的向量空间
     if (metric == IndexFactory::MetricType::L2)
     {
         space = new hnswlib::L2Space(dim);
     }
-    else if (metric == IndexFactory::MetricType::INNER_PRODUCT)
+    else if (metric == IndexFactory::MetricType::INNER_PRODUCT || metric == IndexFactory::MetricType::COSINE)
     {
         space = new hnswlib::InnerProductSpace(dim);
+        cosine = metric == IndexFactory::MetricType::COSINE;
     }
     else
     {
         throw std::runtime_error("Unsupported metric type");
     }
-    // 创建HNSW索引结构
-    index = new hnswlib::HierarchicalNSW<float>(space, maxElements, M, efConstruction);
+    // 创建HNSW索引结构，开启墓碑位置复用
+    index = new hnswlib::HierarchicalNSW<float>(space, maxElements, M, efConstruction, 100, true);
+}
+
+/**
+ * @brief 析构函数
+ */
+HNSWLibIndex::~HNSWLibIndex()
+{
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> threadLock(rebuildThreadMutex);
+        if (rebuildThread.joinable())
+        {
+            rebuildThread.join();
+        }
+    }
+    delete index;
+    delete space;
 }
 
 /**
@@ -44,54 +65,719 @@ HNSWLibIndex::HNSWLibIndex(int dim, size_t maxElements, IndexFactory::MetricType
  */
 void HNSWLibIndex::insertVectors(const std::vector<float> &data, uint64_t label)
 {
-    index->addPoint(data.data(), static_cast<hnswlib::labeltype>(label));
+    std::vector<float> normalized;
+    const float *vector = prepareVectors(data.data(), 1, &normalized);
+    {
+        std::shared_lock<std::shared_mutex> lock(resizeMutex);
+        reserveCapacity(1, &lock);
+        try
+        {
+            if (addOrReplacePoint(index, vector, static_cast<hnswlib::labeltype>(label)))
+            {
+                tombstones++;
+            }
+            journal(static_cast<hnswlib::labeltype>(label), vector);
+        }
+        catch (...)
+        {
+            pendingInserts -= 1;
+            throw;
+        }
+        pendingInserts -= 1;
+    }
+    maybeStartRebuild();
+}
+
+/**
+ * @brief 向索引中批量插入向量数据
+ * @param data 待插入的向量数据（多个向量按维度依次拼接）
+ * @param labels 每个向量对应的标签
+ */
+void HNSWLibIndex::insertVectors(const std::vector<float> &data, const std::vector<long> &labels)
+{
+    buildIndex(data.data(), labels.data(), labels.size());
+}
+
+/**
+ * @brief 并行批量构建索引
+ * @param data 连续存放的向量数据
+ * @param labels 每个向量对应的标签
+ * @param count 向量数量
+ * @return 写入数量、耗时和吞吐量
+ *
+ * 分两轮写入：第一轮原地更新已存在的标签，第二轮写入新标签并复用墓碑位置。
+ * 两轮分开是因为 hnswlib 复用墓碑位置时假设该位置上没有并发操作，
+ * 而第一轮可能正在取消同一位置的删除标记。
+ * 进度由完成一块后发现已到报告时间的线程输出，通过CAS保证同一时刻只有一个线程输出
+ */
+HNSWBuildStats HNSWLibIndex::buildIndex(const float *data, const long *labels, size_t count)
+{
+    HNSWBuildStats stats;
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point startTime = Clock::now();
+    bool reportProgress = count >= HNSW_BUILD_PROGRESS_MIN_VECTORS;
+    auto elapsedSeconds = [startTime]()
+    {
+        return std::chrono::duration<double>(Clock::now() - startTime).count();
+    };
+    if (reportProgress)
+    {
+        globalLogger->info("HNSW build started: vectors = {}, threads = {}",
+                           count, getGlobalThreadPool()->size() + 1);
+    }
+
+    // 余弦相似度：整批向量在写入前归一化一次，两轮写入都使用归一化后的数据
+    std::vector<float> normalized;
+    data = prepareVectors(data, count, &normalized);
+
+    // 一次预留整批的容量，构建期间不会再扩容
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    reserveCapacity(count, &lock);
+    struct PendingGuard
+    {
+        std::atomic<size_t> &pending;
+        size_t count;
+        ~PendingGuard() { pending -= count; }
+    } pendingGuard{pendingInserts, count};
+
+    std::atomic<size_t> inserted{0};
+    std::atomic<int64_t> nextReportMillis{HNSW_BUILD_PROGRESS_INTERVAL_MS};
+    std::vector<char> isNew(count, 0);
+    size_t numChunks = (count + HNSW_BUILD_CHUNK_SIZE - 1) / HNSW_BUILD_CHUNK_SIZE;
+    auto insertChunk = [&](size_t chunk, bool newLabels)
+    {
+        size_t begin = chunk * HNSW_BUILD_CHUNK_SIZE;
+        size_t end = std::min(count, begin + HNSW_BUILD_CHUNK_SIZE);
+        size_t written = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            const float *vector = data + i * dim;
+            hnswlib::labeltype label = static_cast<hnswlib::labeltype>(labels[i]);
+            if (newLabels)
+            {
+                if (!isNew[i])
+                {
+                    continue;
+                }
+                index->addPoint(vector, label, true);
+            }
+            else if (updateExistingPoint(index, vector, label))
+            {
+                tombstones++;
+            }
+            else
+            {
+                isNew[i] = 1;
+                continue;
+            }
+            journal(label, vector);
+            written++;
+        }
+        size_t done = inserted.fetch_add(written) + written;
+        if (!reportProgress)
+        {
+            return;
+        }
+
+        int64_t elapsedMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - startTime).count();
+        int64_t reportMillis = nextReportMillis.load();
+        if (elapsedMillis >= reportMillis &&
+            nextReportMillis.compare_exchange_strong(reportMillis, elapsedMillis + HNSW_BUILD_PROGRESS_INTERVAL_MS))
+        {
+            globalLogger->info("HNSW build progress: {}/{} ({:.1f}%), {:.0f} vectors/s",
+                               done, count, 100.0 * done / count, done / elapsedSeconds());
+        }
+    };
+    getGlobalThreadPool()->parallelFor(0, numChunks, [&](size_t chunk)
+                                       { insertChunk(chunk, false); });
+    getGlobalThreadPool()->parallelFor(0, numChunks, [&](size_t chunk)
+                                       { insertChunk(chunk, true); });
+    lock.unlock();
+    maybeStartRebuild();
+
+    stats.inserted = count;
+    stats.seconds = elapsedSeconds();
+    stats.vectorsPerSecond = stats.seconds > 0 ? count / stats.seconds : 0;
+    if (reportProgress)
+    {
+        globalLogger->info("HNSW build finished: vectors = {}, seconds = {:.1f}, {:.0f} vectors/s",
+                           count, stats.seconds, stats.vectorsPerSecond);
+    }
+    return stats;
+}
+
+/**
+ * @brief 为即将写入的向量预留容量，不足时扩容
+ * @param count 即将写入的向量数量
+ * @param lock 调用方持有的共享锁
+ *
+ * 所需容量为已写入的向量数加上所有已预留、尚未写入完成的向量数。更新已存在的标签不占用新位置，
+ * 这里按新增计算，只会让扩容稍早发生。多个线程同时发现容量不足时，只有第一个取得独占锁的线程扩容，
+ * 其余线程取得锁后重新检查
+ */
+void HNSWLibIndex::reserveCapacity(size_t count, std::shared_lock<std::shared_mutex> *lock)
+{
+    size_t required = index->getCurrentElementCount() + pendingInserts.fetch_add(count) + count;
+    if (required <= index->getMaxElements())
+    {
+        return;
+    }
+
+    lock->unlock();
+    {
+        std::unique_lock<std::shared_mutex> resizeLock(resizeMutex);
+        size_t current = index->getMaxElements();
+        required = index->getCurrentElementCount() + pendingInserts.load();
+        if (required > current)
+        {
+            size_t capacity = grownCapacity(current, required);
+            index->resizeIndex(capacity);
+            globalLogger->info("HNSW index resized: {} -> {} (required {})", current, capacity, required);
+        }
+    }
+    lock->lock();
+}
+
+/**
+ * @brief 按增长策略计算能容纳指定数量的容量
+ * @param current 当前容量
+ * @param required 需要容纳的向量数量
+ * @return 新容量
+ */
+size_t HNSWLibIndex::grownCapacity(size_t current, size_t required)
+{
+    size_t capacity = std::max<size_t>(current, 1);
+    while (capacity < required)
+    {
+        size_t next = HNSW_GROWTH_INCREMENT > 0
+                          ? capacity + HNSW_GROWTH_INCREMENT
+                          : static_cast<size_t>(capacity * HNSW_GROWTH_FACTOR);
+        capacity = std::max(next, capacity + 1);
+    }
+    return capacity;
+}
+
+/**
+ * @brief 按余弦相似度搜索时，返回归一化后的向量
+ * @param data 向量数据
+ * @param count 向量数量
+ * @param buffer 存放归一化结果的缓冲区
+ * @return 归一化后的向量
+ *
+ * 归一化使用 faiss 的向量化实现，零向量保持不变
+ */
+const float *HNSWLibIndex::prepareVectors(const float *data, size_t count, std::vector<float> *buffer) const
+{
+    if (!cosine)
+    {
+        return data;
+    }
+    buffer->assign(data, data + count * dim);
+    faiss::fvec_renorm_L2(dim, count, buffer->data());
+    return buffer->data();
 }
 
 /**
  * @brief 在索引中查询与待查询向量最近邻的k个向量
- * @param query 待查询向量
- * @param k 返回的最近邻数量
- * @param efSearch 查询k近邻时的最大候选邻居数，默认为50
+ * @param query 待查询向量（可包含多个查询向量，按维度依次拼接）
+ * @param k 每个查询返回的最近邻数量
+ * @param efSearch 查询k近邻时的最大候选邻居数，为0时自动选择
+ * @param deadline 搜索的截止时间
+ * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
  * @return 返回一个pair，包含最近邻的标签和对应的距离
  */
 std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::searchVectors(
     const std::vector<float> &query, int k, 
-    const roaring_bitmap_t *bitmap, int efSearch)
+    const roaring_bitmap_t *bitmap, int efSearch,
+    std::chrono::steady_clock::time_point deadline, bool *partial)
+{
+    // 搜索期间不允许扩容重新分配底层内存
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+
+    // 候选数量只作用于本次调用；setEf 修改的是所有请求共享的设置，并发请求之间会互相覆盖
+    size_t ef = efSearch > 0 ? std::max<size_t>(efSearch, k) : chooseEf(k, bitmap);
+
+    // 用待查询向量数组的长度 除以 向量维度 来计算待查询向量的数量
+    size_t numQueries = query.size() / dim;
+    std::vector<float> normalizedQuery;
+    const float *queries = prepareVectors(query.data(), numQueries, &normalizedQuery);
+
+    // 结果数组按查询依次排列，每个查询占k个位置，未命中的位置与 faiss 一致：ID为-1，距离为最大值
+    std::vector<long> indices(numQueries * k, -1);
+    std::vector<float> distances(numQueries * k, std::numeric_limits<float>::max());
+
+    // 每个查询各自执行k近邻搜索，多个查询并行分发到全局线程池
+    // hnswlib 的 searchKnn 是只读操作，可以安全地并发调用
+    bool hasDeadline = deadline != std::chrono::steady_clock::time_point::max();
+    std::atomic<bool> expired{false};
+    getGlobalThreadPool()->parallelFor(0, numQueries, [&](size_t q)
+    {
+        // 创建ID过滤器（过滤器的operator()不是const，每个查询各自持有一份）
+        RoaringBitmapIDFilter filter(bitmap);
+        hnswlib::BaseFilterFunctor *isIdAllowed = bitmap != nullptr ? &filter : nullptr;
+
+        if (hasDeadline)
+        {
+            // 排在后面的查询开始时已经超时，直接留空
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                expired = true;
+                return;
+            }
+            // 停止条件自带候选数量，不依赖索引上共享的ef设置
+            DeadlineStopCondition stopCondition(ef, k, deadline);
+            auto result = index->searchStopConditionClosest(queries + q * dim, stopCondition, isIdAllowed);
+            if (stopCondition.isExpired())
+            {
+                expired = true;
+            }
+            // 结果已按距离由近到远排列
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                indices[q * k + i] = static_cast<long>(result[i].second);
+                distances[q * k + i] = result[i].first;
+            }
+            return;
+        }
+
+        auto result = searchKnn(queries + q * dim, k, ef, isIdAllowed);
+
+        // 优先队列顶部是距离最远的结果，从后往前填充，使结果按距离由近到远排列
+        size_t offset = q * k + result.size();
+        while (!result.empty())
+        {
+            --offset;
+            indices[offset] = static_cast<long>(result.top().second);
+            distances[offset] = result.top().first;
+            result.pop();
+        }
+    });
+
+    if (partial && expired)
+    {
+        *partial = true;
+    }
+    return {indices, distances};
+}
+
+/**
+ * @brief 选择一次搜索的候选数量，调用方需持有共享锁
+ * @param k 返回的最近邻数量
+ * @param bitmap 过滤位图，为nullptr时不过滤
+ * @return 候选数量
+ */
+size_t HNSWLibIndex::chooseEf(int k, const roaring_bitmap_t *bitmap) const
+{
+    if (bitmap == nullptr)
+    {
+        return std::max<size_t>(k, HNSW_DEFAULT_EF_SEARCH);
+    }
+    return scaleEfForFilter(k, index->getCurrentElementCount() - index->getDeletedCount(),
+                            roaring_bitmap_get_cardinality(bitmap));
+}
+
+/**
+ * @brief 在上层逐层贪心地移动到离查询最近的节点
+ * @param query 一个查询向量
+ * @return 底层搜索的入口节点
+ */
+hnswlib::tableint HNSWLibIndex::descendUpperLayers(const float *query) const
 {
-    // 设置搜索参数
-    index->setEf(efSearch);
+    hnswlib::tableint currObj = index->enterpoint_node_;
+    float curdist = index->fstdistfunc_(query, index->getDataByInternalId(currObj), index->dist_func_param_);
+    for (int level = index->maxlevel_; level > 0; level--)
+    {
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            unsigned int *data = reinterpret_cast<unsigned int *>(index->get_linklist(currObj, level));
+            int size = index->getListCount(data);
+            hnswlib::tableint *neighbors = reinterpret_cast<hnswlib::tableint *>(data + 1);
+            for (int i = 0; i < size; i++)
+            {
+                float d = index->fstdistfunc_(query, index->getDataByInternalId(neighbors[i]),
+                                              index->dist_func_param_);
+                if (d < curdist)
+                {
+                    curdist = d;
+                    currObj = neighbors[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+    return currObj;
+}
 
-    // 创建ID过滤器
-    RoaringBitmapIDFilter* filter = nullptr;
-    if (bitmap != nullptr)
+/**
+ * @brief 使用指定候选数量的k近邻搜索
+ * @param query 一个查询向量
+ * @param k 返回的最近邻数量
+ * @param ef 候选数量
+ * @param isIdAllowed 过滤器，为nullptr时不过滤
+ * @return 按距离由远到近出队的结果
+ */
+std::priority_queue<std::pair<float, hnswlib::labeltype>> HNSWLibIndex::searchKnn(
+    const float *query, size_t k, size_t ef, hnswlib::BaseFilterFunctor *isIdAllowed) const
+{
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> result;
+    if (index->cur_element_count == 0)
+    {
+        return result;
+    }
+
+    // 在上层逐层贪心地移动到离查询最近的节点，作为底层搜索的入口
+    hnswlib::tableint currObj = descendUpperLayers(query);
+
+    // 没有删除标记和过滤条件时使用不做检查的快速路径
+    auto topCandidates = index->num_deleted_ == 0 && isIdAllowed == nullptr
+                             ? index->searchBaseLayerST<true>(currObj, query, std::max(ef, k), isIdAllowed)
+                             : index->searchBaseLayerST<false>(currObj, query, std::max(ef, k), isIdAllowed);
+    while (topCandidates.size() > k)
+    {
+        topCandidates.pop();
+    }
+    while (!topCandidates.empty())
     {
-        filter = new RoaringBitmapIDFilter(bitmap);
+        result.emplace(topCandidates.top().first, index->getExternalLabel(topCandidates.top().second));
+        topCandidates.pop();
     }
-    // 执行k近邻搜索
-    auto result = index->searchKnn(query.data(), k, filter);
+    return result;
+}
 
-    // 准备返回结果
-    std::vector<long> indices;
-    std::vector<float> distances;
+/**
+ * @brief 只在满足过滤条件的节点之间遍历的过滤图搜索
+ * @param query 待查询向量（可包含多个查询向量，按维度依次拼接）
+ * @param k 每个查询返回的最近邻数量
+ * @param bitmap 过滤位图
+ * @param efSearch 候选数量，为0时使用默认值
+ * @param deadline 搜索的截止时间
+ * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
+ * @return 返回一个pair，包含最近邻的标签和对应的距离
+ */
+std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::searchTwoHop(
+    const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap, int efSearch,
+    std::chrono::steady_clock::time_point deadline, bool *partial)
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
 
-    // 从优先队列中提取结果
-    while (!result.empty())
+    // 候选中只有满足条件的节点，不需要按选择率放大
+    size_t ef = std::max<size_t>(efSearch > 0 ? efSearch : HNSW_DEFAULT_EF_SEARCH, k);
+
+    size_t live = index->getCurrentElementCount() - index->getDeletedCount();
+    size_t matches = std::min<size_t>(roaring_bitmap_get_cardinality(bitmap), live);
+    size_t bridgeBudget = twoHopBridgeBudget(live, matches);
+
+    size_t numQueries = query.size() / dim;
+    std::vector<long> indices(numQueries * k, -1);
+    std::vector<float> distances(numQueries * k, std::numeric_limits<float>::max());
+    if (matches == 0)
     {
-        auto item = result.top();
-        indices.push_back(item.second);
-        distances.push_back(item.first);
-        result.pop();
+        return {indices, distances};
     }
+    std::vector<float> normalizedQuery;
+    const float *queries = prepareVectors(query.data(), numQueries, &normalizedQuery);
 
-    // 释放过滤器
-    if (filter != nullptr)
+    std::atomic<bool> expired{false};
+    getGlobalThreadPool()->parallelFor(0, numQueries, [&](size_t q)
     {
-        delete filter;
-    }    
+        bool queryExpired = false;
+        auto result = searchKnnTwoHop(queries + q * dim, k, ef, bitmap, bridgeBudget, deadline,
+                                      &queryExpired);
+        if (queryExpired)
+        {
+            expired = true;
+        }
+        size_t offset = q * k + result.size();
+        while (!result.empty())
+        {
+            --offset;
+            indices[offset] = static_cast<long>(result.top().second);
+            distances[offset] = result.top().first;
+            result.pop();
+        }
+    });
 
+    if (partial && expired)
+    {
+        *partial = true;
+    }
     return {indices, distances};
 }
 
+/**
+ * @brief 只在满足过滤条件的节点之间遍历的底层搜索
+ * @param query 一个查询向量
+ * @param k 返回的最近邻数量
+ * @param ef 候选数量
+ * @param bitmap 过滤位图
+ * @param bridgeBudget 每个节点最多经过的桥梁数量
+ * @param deadline 截止时间
+ * @param expired 输出参数，超过截止时间而提前停止时置为true
+ * @return 按距离由远到近出队的结果
+ *
+ * 与 hnswlib 的 searchBaseLayerST 相同地维护候选队列和ef个结果，区别是近邻集合的构成：
+ * 满足条件的近邻直接加入；不满足条件的近邻作为桥梁，把它的近邻中满足条件的加入，
+ * 其余的继续作为桥梁排队，选择率很低时可以经过多跳到达满足条件的节点。
+ * 展开过的桥梁和加入过的节点记入访问表；排队但未展开的桥梁不记入，之后仍可以作为别的节点的桥梁。
+ * 入口节点不满足条件时只作为起点展开，不进入结果
+ */
+std::priority_queue<std::pair<float, hnswlib::labeltype>> HNSWLibIndex::searchKnnTwoHop(
+    const float *query, size_t k, size_t ef, const roaring_bitmap_t *bitmap, size_t bridgeBudget,
+    std::chrono::steady_clock::time_point deadline, bool *expired) const
+{
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> result;
+    if (index->cur_element_count == 0)
+    {
+        return result;
+    }
+
+    // 已删除的节点与不满足条件的节点相同，只作为桥梁
+    auto isAllowed = [this, bitmap](hnswlib::tableint id)
+    {
+        hnswlib::labeltype label = index->getExternalLabel(id);
+        return label <= std::numeric_limits<uint32_t>::max() && !index->isMarkedDeleted(id) &&
+               roaring_bitmap_contains(bitmap, static_cast<uint32_t>(label));
+    };
+
+    hnswlib::VisitedList *visitedList = index->visited_list_pool_->getFreeVisitedList();
+    hnswlib::vl_type *visited = visitedList->mass;
+    hnswlib::vl_type visitedTag = visitedList->curV;
+
+    // candidates 以距离的相反数入队，队首是距离最近的候选；topCandidates 队首是结果中距离最远的
+    std::priority_queue<std::pair<float, hnswlib::tableint>> candidates;
+    std::priority_queue<std::pair<float, hnswlib::tableint>> topCandidates;
+    float lowerBound = std::numeric_limits<float>::max();
+
+    // 距离足够近的满足条件的节点加入候选和结果
+    auto consider = [&](hnswlib::tableint id)
+    {
+        float d = index->fstdistfunc_(query, index->getDataByInternalId(id), index->dist_func_param_);
+        if (topCandidates.size() < ef || d < lowerBound)
+        {
+            candidates.emplace(-d, id);
+            topCandidates.emplace(d, id);
+            if (topCandidates.size() > ef)
+            {
+                topCandidates.pop();
+            }
+            lowerBound = topCandidates.top().first;
+        }
+    };
+
+    hnswlib::tableint entryPoint = descendUpperLayers(query);
+    visited[entryPoint] = visitedTag;
+    if (isAllowed(entryPoint))
+    {
+        consider(entryPoint);
+    }
+    else
+    {
+        candidates.emplace(-std::numeric_limits<float>::max(), entryPoint);
+    }
+
+    bool hasDeadline = deadline != std::chrono::steady_clock::time_point::max();
+    size_t expansions = 0;
+    size_t maxNeighbors = HNSW_TWO_HOP_NEIGHBOR_FACTOR * index->maxM0_;
+    std::vector<hnswlib::tableint> bridgeQueue;
+    while (!candidates.empty())
+    {
+        float candidateDist = -candidates.top().first;
+        if (candidateDist > lowerBound && topCandidates.size() == ef)
+        {
+            break;
+        }
+        if (hasDeadline && ++expansions % HNSW_DEADLINE_CHECK_INTERVAL == 0 &&
+            std::chrono::steady_clock::now() >= deadline)
+        {
+            *expired = true;
+            break;
+        }
+        hnswlib::tableint current = candidates.top().second;
+        candidates.pop();
+
+        hnswlib::linklistsizeint *data = index->get_linklist0(current);
+        size_t size = index->getListCount(data);
+        hnswlib::tableint *neighbors = reinterpret_cast<hnswlib::tableint *>(data + 1);
+
+        // 先加入满足条件的近邻，不满足条件的近邻作为桥梁按广度优先继续展开，
+        // 直到收集满 maxNeighbors 个满足条件的近邻或用完桥梁数量
+        size_t collected = 0;
+        size_t bridges = 0;
+        bridgeQueue.clear();
+        for (size_t i = 0; i < size; i++)
+        {
+            hnswlib::tableint neighbor = neighbors[i];
+            if (visited[neighbor] == visitedTag)
+            {
+                continue;
+            }
+            if (isAllowed(neighbor))
+            {
+                visited[neighbor] = visitedTag;
+                consider(neighbor);
+                collected++;
+            }
+            else
+            {
+                bridgeQueue.push_back(neighbor);
+            }
+        }
+        for (size_t head = 0; head < bridgeQueue.size() && collected < maxNeighbors && bridges < bridgeBudget;
+             head++)
+        {
+            hnswlib::tableint bridge = bridgeQueue[head];
+            // 同一个节点可能经由多个桥梁入队
+            if (visited[bridge] == visitedTag)
+            {
+                continue;
+            }
+            visited[bridge] = visitedTag;
+            bridges++;
+            hnswlib::linklistsizeint *bridgeData = index->get_linklist0(bridge);
+            size_t bridgeSize = index->getListCount(bridgeData);
+            hnswlib::tableint *bridgeNeighbors = reinterpret_cast<hnswlib::tableint *>(bridgeData + 1);
+            for (size_t j = 0; j < bridgeSize && collected < maxNeighbors; j++)
+            {
+                hnswlib::tableint neighbor = bridgeNeighbors[j];
+                if (visited[neighbor] == visitedTag)
+                {
+                    continue;
+                }
+                if (isAllowed(neighbor))
+                {
+                    visited[neighbor] = visitedTag;
+                    consider(neighbor);
+                    collected++;
+                }
+                else
+                {
+                    bridgeQueue.push_back(neighbor);
+                }
+            }
+        }
+    }
+    index->visited_list_pool_->releaseVisitedList(visitedList);
+
+    while (topCandidates.size() > k)
+    {
+        topCandidates.pop();
+    }
+    while (!topCandidates.empty())
+    {
+        result.emplace(topCandidates.top().first, index->getExternalLabel(topCandidates.top().second));
+        topCandidates.pop();
+    }
+    return result;
+}
+
+/**
+ * @brief 只对过滤位图中的ID计算距离的精确搜索
+ * @param query 待查询向量
+ * @param k 每个查询返回的最近邻数量
+ * @param bitmap 过滤位图
+ * @return 返回一个pair，包含最近邻的标签和对应的距离
+ *
+ * 先在标签表锁内一次性把位图中的ID转换为内部ID，之后各查询并行计算距离，不再访问标签表
+ */
+std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::searchExact(
+    const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap)
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+
+    std::vector<uint32_t> labels(roaring_bitmap_get_cardinality(bitmap));
+    roaring_bitmap_to_uint32_array(bitmap, labels.data());
+    std::vector<hnswlib::tableint> internalIds;
+    internalIds.reserve(labels.size());
+    {
+        std::unique_lock<std::mutex> lookupLock(index->label_lookup_lock);
+        for (uint32_t label : labels)
+        {
+            auto found = index->label_lookup_.find(static_cast<hnswlib::labeltype>(label));
+            if (found != index->label_lookup_.end() && !index->isMarkedDeleted(found->second))
+            {
+                internalIds.push_back(found->second);
+            }
+        }
+    }
+
+    size_t numQueries = query.size() / dim;
+    std::vector<long> indices(numQueries * k, -1);
+    std::vector<float> distances(numQueries * k, std::numeric_limits<float>::max());
+    std::vector<float> normalizedQuery;
+    const float *queries = prepareVectors(query.data(), numQueries, &normalizedQuery);
+    getGlobalThreadPool()->parallelFor(0, numQueries, [&](size_t q)
+    {
+        const float *queryVector = queries + q * dim;
+        // 大顶堆保留距离最近的k个
+        std::priority_queue<std::pair<float, hnswlib::tableint>> top;
+        for (hnswlib::tableint id : internalIds)
+        {
+            float d = index->fstdistfunc_(queryVector, index->getDataByInternalId(id), index->dist_func_param_);
+            if (top.size() < static_cast<size_t>(k))
+            {
+                top.emplace(d, id);
+            }
+            else if (d < top.top().first)
+            {
+                top.pop();
+                top.emplace(d, id);
+            }
+        }
+        size_t offset = q * k + top.size();
+        while (!top.empty())
+        {
+            --offset;
+            indices[offset] = static_cast<long>(index->getExternalLabel(top.top().second));
+            distances[offset] = top.top().first;
+            top.pop();
+        }
+    });
+    return {indices, distances};
+}
+
+size_t HNSWLibIndex::getLiveCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    return index->getCurrentElementCount() - index->getDeletedCount();
+}
+
+size_t HNSWLibIndex::getMaxNeighbors() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    return index->maxM0_;
+}
+
+/**
+ * @brief 按标签读取索引中保存的向量
+ * @param label 向量的标签
+ * @param vector 输出参数，读取到的向量
+ * @return 标签存在时返回true
+ *
+ * 直接从索引的数据区拷贝向量，不需要访问标量存储
+ */
+bool HNSWLibIndex::getVector(uint64_t label, std::vector<float> *vector) const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    try
+    {
+        *vector = index->getDataByLabel<float>(static_cast<hnswlib::labeltype>(label));
+        return true;
+    }
+    catch (const std::runtime_error &e)
+    {
+        // 标签不存在或已被标记删除
+        return false;
+    }
+}
+
 /**
  * @brief 保存索引到文件
  * @param filePath 保存索引文件的路径
@@ -100,6 +786,7 @@ std::pair<std::vector<long>, std::vector<float>> HNSWLibIndex::searchVectors(
  */
 void HNSWLibIndex::saveIndex(const std::string &filePath)
 {
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
     // 调用底层HNSWlib库的saveIndex方法保存索引
     index->saveIndex(filePath);
 }
@@ -110,19 +797,350 @@ void HNSWLibIndex::saveIndex(const std::string &filePath)
  *
  * 从指定的文件路径加载HNSWLib索引。加载前会检查文件是否存在，
  * 如果文件不存在，会打印警告信息并跳过加载。
+ * 容量取初始容量与（文件中的向量数按增长策略扩容一次）中的较大者，
+ * 避免沿用保存时过大的容量，也避免加载后第一次写入就扩容。
  */
 void HNSWLibIndex::loadIndex(const std::string &filePath)
 {
     // 创建文件流并检查文件是否存在
-    std::ifstream file(filePath);
+    std::ifstream file(filePath, std::ios::binary);
     if (file.good())
     {
+        // 文件头依次为 offsetLevel0_、max_elements_、cur_element_count
+        size_t header[3] = {0, 0, 0};
+        file.read(reinterpret_cast<char *>(header), sizeof(header));
         file.close(); // 关闭文件流
+        size_t count = header[2];
+
+        std::unique_lock<std::shared_mutex> lock(resizeMutex);
+        size_t capacity = std::max(index->getMaxElements(), grownCapacity(count, count + 1));
         // 从文件加载索引，需要提供文件路径、空间接口和最大元素数
-        index->loadIndex(filePath, space, maxElements);
+        index->loadIndex(filePath, space, capacity);
+        // 文件中的删除标记在加载后仍是墓碑
+        tombstones = index->getDeletedCount();
+        globalLogger->info("HNSW index loaded: vectors = {}, deleted = {}, capacity = {}",
+                           count, tombstones.load(), capacity);
     }else{
         // 文件未找到，打印警告
         globalLogger->warn("HNSW index file not found: {}. Skipping load HNSW index.",
                            filePath);
     }
 }
+
+/**
+ * @brief 获取索引的向量维度
+ * @return 向量维度
+ */
+int HNSWLibIndex::getDim() const
+{
+    return dim;
+}
+
+size_t HNSWLibIndex::getVectorCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    return index->getCurrentElementCount();
+}
+
+size_t HNSWLibIndex::getMaxElements() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    return index->getMaxElements();
+}
+
+size_t HNSWLibIndex::getDeletedCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    return index->getDeletedCount();
+}
+
+double HNSWLibIndex::getTombstoneRatio() const
+{
+    std::shared_lock<std::shared_mutex> lock(resizeMutex);
+    size_t count = index->getCurrentElementCount();
+    return count == 0 ? 0.0 : static_cast<double>(tombstones.load()) / count;
+}
+
+/**
+ * @brief 标签已在索引中（包括已删除的）时原地更新向量
+ * @param target 目标索引
+ * @param data 向量数据
+ * @param label 标签
+ * @return 标签不在索引中时返回false且不写入
+ */
+bool HNSWLibIndex::updateExistingPoint(hnswlib::HierarchicalNSW<float> *target, const float *data,
+                                       hnswlib::labeltype label)
+{
+    bool deleted;
+    {
+        std::unique_lock<std::mutex> lookupLock(target->label_lookup_lock);
+        auto found = target->label_lookup_.find(label);
+        if (found == target->label_lookup_.end())
+        {
+            return false;
+        }
+        deleted = target->isMarkedDeleted(found->second);
+    }
+    if (deleted)
+    {
+        try
+        {
+            target->unmarkDelete(label);
+        }
+        catch (const std::runtime_error &e)
+        {
+            // 同一标签的并发写入已经取消了删除标记
+        }
+    }
+    // 标签已存在时 addPoint 走 updatePoint 原地更新向量和邻居
+    target->addPoint(data, label, false);
+    return true;
+}
+
+/**
+ * @brief 写入向量：已存在的标签原地更新，新标签优先复用墓碑位置
+ * @param target 目标索引
+ * @param data 向量数据
+ * @param label 标签
+ * @return 标签原本已存在时返回true
+ */
+bool HNSWLibIndex::addOrReplacePoint(hnswlib::HierarchicalNSW<float> *target, const float *data,
+                                     hnswlib::labeltype label)
+{
+    if (updateExistingPoint(target, data, label))
+    {
+        return true;
+    }
+    target->addPoint(data, label, true);
+    return false;
+}
+
+/**
+ * @brief 标签存在且未删除时标记删除
+ * @param target 目标索引
+ * @param label 标签
+ * @return 实际标记删除时返回true
+ */
+bool HNSWLibIndex::markDeleteIfPresent(hnswlib::HierarchicalNSW<float> *target, hnswlib::labeltype label)
+{
+    try
+    {
+        target->markDelete(label);
+        return true;
+    }
+    catch (const std::runtime_error &e)
+    {
+        // 标签不存在或已被标记删除
+        return false;
+    }
+}
+
+/**
+ * @brief 从索引中删除向量
+ * @param labels 要删除的标签
+ * @return 实际删除的数量（不存在或已删除的标签不计入）
+ *
+ * 只做删除标记，与搜索和写入并发执行。删除后墓碑比例超过阈值时启动后台重建
+ */
+size_t HNSWLibIndex::removeVectors(const std::vector<long> &labels)
+{
+    size_t removed = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(resizeMutex);
+        for (long label : labels)
+        {
+            hnswlib::labeltype hnswLabel = static_cast<hnswlib::labeltype>(label);
+            if (markDeleteIfPresent(index, hnswLabel))
+            {
+                removed++;
+                tombstones++;
+                journal(hnswLabel, nullptr);
+            }
+        }
+    }
+    if (removed > 0)
+    {
+        maybeStartRebuild();
+    }
+    return removed;
+}
+
+/**
+ * @brief 重建期间把一次写入或删除记录到写入日志，调用方需持有共享锁
+ * @param label 标签
+ * @param data 写入的向量，删除时为nullptr
+ *
+ * journaling 只在持有独占锁时修改，因此持有共享锁的写入看到的值在本次写入期间不会变化：
+ * 要么写入发生在重建开始之前（会被重建拷贝到），要么一定会被记录到日志
+ */
+void HNSWLibIndex::journal(hnswlib::labeltype label, const float *data)
+{
+    if (!journaling)
+    {
+        return;
+    }
+    JournalEntry entry;
+    entry.label = label;
+    entry.deleted = data == nullptr;
+    if (data)
+    {
+        entry.vector.assign(data, data + dim);
+    }
+    std::lock_guard<std::mutex> journalLock(journalMutex);
+    journalEntries.push_back(std::move(entry));
+}
+
+/**
+ * @brief 墓碑比例超过阈值且没有正在进行的重建时，启动后台重建
+ *
+ * 需要在释放扩容锁之后调用：启动前会等待上一次重建的线程退出
+ */
+void HNSWLibIndex::maybeStartRebuild()
+{
+    if (stopping || rebuildRunning)
+    {
+        return;
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock(resizeMutex);
+        size_t count = index->getCurrentElementCount();
+        if (count < HNSW_REBUILD_MIN_VECTORS ||
+            static_cast<double>(tombstones.load()) <= HNSW_REBUILD_TOMBSTONE_RATIO * count)
+        {
+            return;
+        }
+    }
+    bool expected = false;
+    if (!rebuildRunning.compare_exchange_strong(expected, true))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> threadLock(rebuildThreadMutex);
+    if (rebuildThread.joinable())
+    {
+        rebuildThread.join();
+    }
+    rebuildThread = std::thread(&HNSWLibIndex::rebuild, this);
+}
+
+/**
+ * @brief 后台重建：用存活的向量构建新索引，应用写入日志后原子切换
+ *
+ * 1. 独占锁内开启写入日志，此后的写入和删除都会记录到日志
+ * 2. 按内部ID分块，每块在共享锁内拷贝未删除的标签和向量，在锁外并行写入新索引
+ * 3. 在锁外反复应用写入日志，直到剩余的日志少于 HNSW_REBUILD_FINAL_DRAIN
+ * 4. 独占锁内应用剩余的日志并切换索引，搜索和写入只在这一步短暂阻塞
+ */
+void HNSWLibIndex::rebuild()
+{
+    auto startTime = std::chrono::steady_clock::now();
+    hnswlib::HierarchicalNSW<float> *fresh = nullptr;
+    size_t total = 0;
+    size_t live = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(resizeMutex);
+        journaling = true;
+        total = index->getCurrentElementCount();
+        live = total - index->getDeletedCount();
+        fresh = new hnswlib::HierarchicalNSW<float>(space, grownCapacity(std::max<size_t>(live, 1), total),
+                                                    index->M_, index->ef_construction_, 100, true);
+    }
+
+    // 应用一批写入日志，新索引写满时扩容
+    auto applyJournal = [&](std::vector<JournalEntry> &entries)
+    {
+        for (const JournalEntry &entry : entries)
+        {
+            if (entry.deleted)
+            {
+                markDeleteIfPresent(fresh, entry.label);
+                continue;
+            }
+            if (fresh->getCurrentElementCount() >= fresh->getMaxElements())
+            {
+                fresh->resizeIndex(grownCapacity(fresh->getMaxElements(), fresh->getCurrentElementCount() + 1));
+            }
+            addOrReplacePoint(fresh, entry.vector.data(), entry.label);
+        }
+    };
+
+    size_t numChunks = (total + HNSW_BUILD_CHUNK_SIZE - 1) / HNSW_BUILD_CHUNK_SIZE;
+    getGlobalThreadPool()->parallelFor(0, numChunks, [&](size_t chunk)
+    {
+        if (stopping)
+        {
+            return;
+        }
+        size_t begin = chunk * HNSW_BUILD_CHUNK_SIZE;
+        size_t end = std::min(total, begin + HNSW_BUILD_CHUNK_SIZE);
+        std::vector<hnswlib::labeltype> chunkLabels;
+        std::vector<float> chunkData;
+        {
+            std::shared_lock<std::shared_mutex> lock(resizeMutex);
+            for (size_t id = begin; id < end; id++)
+            {
+                if (index->isMarkedDeleted(static_cast<hnswlib::tableint>(id)))
+                {
+                    continue;
+                }
+                const float *vector = reinterpret_cast<const float *>(
+                    index->getDataByInternalId(static_cast<hnswlib::tableint>(id)));
+                chunkLabels.push_back(index->getExternalLabel(static_cast<hnswlib::tableint>(id)));
+                chunkData.insert(chunkData.end(), vector, vector + dim);
+            }
+        }
+        // 新索引的容量能容纳拷贝时所有未删除的向量，这里不会写满
+        for (size_t i = 0; i < chunkLabels.size(); i++)
+        {
+            addOrReplacePoint(fresh, chunkData.data() + i * dim, chunkLabels[i]);
+        }
+    });
+
+    std::vector<JournalEntry> entries;
+    while (!stopping)
+    {
+        {
+            std::lock_guard<std::mutex> journalLock(journalMutex);
+            if (journalEntries.size() < HNSW_REBUILD_FINAL_DRAIN)
+            {
+                break;
+            }
+            entries.swap(journalEntries);
+        }
+        applyJournal(entries);
+        entries.clear();
+    }
+
+    if (stopping)
+    {
+        std::unique_lock<std::shared_mutex> lock(resizeMutex);
+        journaling = false;
+        journalEntries.clear();
+        lock.unlock();
+        delete fresh;
+        rebuildRunning = false;
+        return;
+    }
+
+    hnswlib::HierarchicalNSW<float> *old;
+    size_t liveAfter;
+    {
+        std::unique_lock<std::shared_mutex> lock(resizeMutex);
+        {
+            std::lock_guard<std::mutex> journalLock(journalMutex);
+            entries.swap(journalEntries);
+        }
+        applyJournal(entries);
+        journaling = false;
+        old = index;
+        index = fresh;
+        tombstones = index->getDeletedCount();
+        liveAfter = index->getCurrentElementCount() - index->getDeletedCount();
+    }
+    delete old;
+    rebuildCount++;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    globalLogger->info("HNSW index rebuilt: slots = {}, live vectors = {}, seconds = {:.1f}",
+                       total, liveAfter, seconds);
+    rebuildRunning = false;
+}
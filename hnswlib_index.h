@@ -1,15 +1,51 @@
 #pragma once
 
 #include "hnswlib/hnswlib.h"
+#include "constants.h"
 #include "index_factory.h"
 #include "roaring/roaring.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
 
+/**
+ * @struct HNSWBuildStats
+ * @brief 一次批量构建的统计
+ */
+struct HNSWBuildStats
+{
+    size_t inserted = 0;          ///< 写入的向量数量
+    double seconds = 0;           ///< 耗时（秒）
+    double vectorsPerSecond = 0;  ///< 吞吐量（向量/秒）
+};
+
 /**
  * @brief HNSW索引类，用于高效的高维向量搜索
  * 
  * 该类封装了HNSW（Hierarchical Navigable Small World）算法，
  * 用于在高维空间中快速搜索最近邻向量。
+ *
+ * hnswlib 内部按节点加锁，addPoint 与 searchKnn 可以并发执行，写入不会阻塞搜索。
+ *
+ * 索引容量按需增长：写入前预留容量，不足时按 HNSW_GROWTH_FACTOR（或固定的
+ * HNSW_GROWTH_INCREMENT）调用 resizeIndex 扩容。扩容会重新分配底层内存，
+ * 因此写入、搜索、读取和保存持有共享锁，只有扩容持有独占锁，平时各操作之间互不阻塞。
+ *
+ * 删除通过 markDelete 标记墓碑，索引开启了 allow_replace_deleted，新写入的向量优先复用墓碑位置；
+ * 更新已存在的标签时先标记删除旧位置再写入。墓碑（当前的删除标记加上自上次重建以来被复用的位置）
+ * 占索引位置的比例超过 HNSW_REBUILD_TOMBSTONE_RATIO 时，后台线程用存活的向量重新构建一个索引，
+ * 重建期间的写入和删除记录在写入日志中，构建完成后应用到新索引，再在独占锁内原子地切换。
+ *
+ * 余弦相似度使用内积空间：写入的向量归一化一次后存入索引（读取到的向量也是归一化后的），
+ * 查询向量每次搜索归一化一次，内积空间返回的 1 - 内积 即为余弦距离。
+ *
+ * 带过滤条件的搜索除了 hnswlib 自带的过滤搜索（searchVectors），还提供只在满足条件的节点之间
+ * 遍历的两跳过滤图搜索（searchTwoHop）和只扫描位图中ID的精确搜索（searchExact），由 search_planner.h 选择。
  */
 class HNSWLibIndex
 {
@@ -17,7 +53,7 @@ public:
     /**
      * @brief 构造函数
      * @param dim 向量维度
-     * @param maxElements 索引能容纳的最大向量数量
+     * @param maxElements 索引的初始容量，写满后自动扩容
      * @param metric 距离度量类型
      * @param M 索引节点的最大近邻数，默认为16
      * @param efConstruction 构建最大近邻时的最大候选邻居数，默认为200
@@ -25,6 +61,14 @@ public:
     HNSWLibIndex(int dim, size_t maxElements, IndexFactory::MetricType metric,
                  int M = 16, int efConstruction = 200);
 
+    /**
+     * @brief 析构函数，等待正在进行的后台重建退出
+     */
+    ~HNSWLibIndex();
+
+    HNSWLibIndex(const HNSWLibIndex &) = delete;
+    HNSWLibIndex &operator=(const HNSWLibIndex &) = delete;
+
     /**
      * @brief 向索引中插入向量数据
      * @param data 待插入的向量数据
@@ -32,16 +76,113 @@ public:
      */
     void insertVectors(const std::vector<float> &data, uint64_t label);
 
+    /**
+     * @brief 向索引中批量插入向量数据
+     * @param data 待插入的向量数据（多个向量按维度依次拼接）
+     * @param labels 每个向量对应的标签
+     *
+     * hnswlib 的 addPoint 支持并发调用，多个向量会分发到全局线程池并行插入（见 buildIndex）
+     */
+    void insertVectors(const std::vector<float> &data, const std::vector<long> &labels);
+
+    /**
+     * @brief 并行批量构建索引
+     * @param data 连续存放的向量数据（count个向量按维度依次拼接）
+     * @param labels 每个向量对应的标签
+     * @param count 向量数量
+     * @return 写入数量、耗时和吞吐量
+     *
+     * 向量按 HNSW_BUILD_CHUNK_SIZE 个一块，由全局线程池（线程数等于CPU核心数）的各线程
+     * 动态领取，先完成的线程继续领取剩余的块，不会因为个别向量插入较慢而空等。
+     * 向量数达到 HNSW_BUILD_PROGRESS_MIN_VECTORS 时，每隔 HNSW_BUILD_PROGRESS_INTERVAL_MS
+     * 输出一次进度和吞吐量，结束时输出总耗时
+     */
+    HNSWBuildStats buildIndex(const float *data, const long *labels, size_t count);
+
+    /**
+     * @brief 从索引中删除向量
+     * @param labels 要删除的标签
+     * @return 实际删除的数量（不存在或已删除的标签不计入）
+     *
+     * 被删除的位置成为墓碑，不再出现在搜索结果中，之后的写入会复用这些位置
+     */
+    size_t removeVectors(const std::vector<long> &labels);
+
     /**
      * @brief 在索引中查询与待查询向量最近邻的k个向量
-     * @param query 待查询向量
-     * @param k 返回的最近邻数量
-     * @param efSearch 查询k近邻时的最大候选邻居数，默认为50
+     * @param query 待查询向量（可包含多个查询向量，按维度依次拼接）
+     * @param k 每个查询返回的最近邻数量
+     * @param efSearch 查询k近邻时的最大候选邻居数，为0时自动选择（见 chooseEf）
+     * @param deadline 搜索的截止时间，默认不限制
+     * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
      * @return 返回一个pair，包含最近邻的标签和对应的距离
+     *
+     * 与FaissIndex::searchVectors保持一致：结果按查询依次排列，每个查询占k个位置，
+     * 按距离由近到远排序，不足k个的位置ID为-1、距离为float最大值（与 faiss 一致）。多个查询会分发到全局线程池并行执行。
+     * 设置了截止时间时，超时的查询停止扩展候选节点，返回已找到的最近邻。
+     * 候选数量随每次调用传入，不修改索引上共享的ef设置，并发的请求可以使用不同的值。
      */
     std::pair<std::vector<long>, std::vector<float>> searchVectors(
         const std::vector<float> &query, int k, 
-        const roaring_bitmap_t *bitmap = nullptr, int efSearch = 50);
+        const roaring_bitmap_t *bitmap = nullptr, int efSearch = 0,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+        bool *partial = nullptr);
+
+    /**
+     * @brief 只在满足过滤条件的节点之间遍历的过滤图搜索
+     * @param query 待查询向量（可包含多个查询向量，按维度依次拼接）
+     * @param k 每个查询返回的最近邻数量
+     * @param bitmap 过滤位图
+     * @param efSearch 候选数量，为0时使用 max(k, HNSW_DEFAULT_EF_SEARCH)，不按选择率放大
+     * @param deadline 搜索的截止时间，默认不限制
+     * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
+     * @return 返回一个pair，包含最近邻的标签和对应的距离，格式与 searchVectors 相同
+     *
+     * hnswlib 的过滤搜索仍然扩展不满足条件的节点，匹配数很少时候选队列被这些节点占满，
+     * 只能按选择率放大ef。这里底层只有满足条件的节点进入候选和结果，不满足条件的近邻只作为桥梁：
+     * 直接检查它的近邻，把其中满足条件的当作当前节点的近邻（两跳扩展），其余的继续作为桥梁。
+     * 每个节点经过的桥梁数量随选择率的倒数增长（见 twoHopBridgeBudget），
+     * 收集满 HNSW_TWO_HOP_NEIGHBOR_FACTOR 倍底层近邻数后停止扩展。
+     * 只对满足条件的节点计算距离，不满足条件的节点只查询位图。
+     * 满足条件的节点不连通时结果可能不足k个，由调用方决定是否改用其他方式
+     */
+    std::pair<std::vector<long>, std::vector<float>> searchTwoHop(
+        const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap, int efSearch = 0,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+        bool *partial = nullptr);
+
+    /**
+     * @brief 只对过滤位图中的ID计算距离的精确搜索
+     * @param query 待查询向量（可包含多个查询向量，按维度依次拼接）
+     * @param k 每个查询返回的最近邻数量
+     * @param bitmap 过滤位图
+     * @return 返回一个pair，包含最近邻的标签和对应的距离，格式与 searchVectors 相同
+     *
+     * 代价与位图基数成正比，与索引大小无关，适合匹配数很少的过滤条件。
+     * 位图中不在索引里或已删除的ID被跳过
+     */
+    std::pair<std::vector<long>, std::vector<float>> searchExact(
+        const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap);
+
+    /**
+     * @brief 获取未删除的向量数量
+     * @return 存活向量数
+     */
+    size_t getLiveCount() const;
+
+    /**
+     * @brief 获取底层每个节点的最大近邻数
+     * @return 最大近邻数（2 * M）
+     */
+    size_t getMaxNeighbors() const;
+
+    /**
+     * @brief 按标签读取索引中保存的向量
+     * @param label 向量的标签
+     * @param vector 输出参数，读取到的向量
+     * @return 标签存在时返回true
+     */
+    bool getVector(uint64_t label, std::vector<float> *vector) const;
 
     /**
      * @brief 保存索引到文件
@@ -52,9 +193,47 @@ public:
     /**
      * @brief 从文件加载索引
      * @param filePath 文件路径
+     *
+     * 容量按文件中的向量数量加一次扩容的余量确定，而不是沿用保存时的容量
      */
     void loadIndex(const std::string &filePath);
 
+    /**
+     * @brief 获取索引的向量维度
+     * @return 向量维度
+     */
+    int getDim() const;
+
+    /**
+     * @brief 获取索引中的向量数量（包含已标记删除的向量）
+     * @return 向量数量
+     */
+    size_t getVectorCount() const;
+
+    /**
+     * @brief 获取索引当前的容量
+     * @return 扩容前能容纳的最大向量数量
+     */
+    size_t getMaxElements() const;
+
+    /**
+     * @brief 获取已标记删除、尚未被复用的向量数量
+     * @return 删除标记的数量
+     */
+    size_t getDeletedCount() const;
+
+    /**
+     * @brief 获取墓碑占索引位置的比例
+     * @return 自上次重建以来的墓碑数除以索引位置数
+     */
+    double getTombstoneRatio() const;
+
+    /**
+     * @brief 获取后台重建完成的次数
+     * @return 重建次数
+     */
+    uint64_t getRebuildCount() const { return rebuildCount.load(); }
+
     /**
      * @brief 基于 Roaring Bitmap 的 ID 过滤器
      * 该类继承自 hnswlib::BaseFilterFunctor，用于通过 Roaring Bitmap 判断某个ID是否在集合中。
@@ -73,7 +252,9 @@ public:
          * @return 如果ID在集合中返回true，否则返回false
          */
         bool operator()(hnswlib::labeltype label) {
-            return roaring_bitmap_contains(bitmap, static_cast<uint32_t>(label));
+            // 位图只能保存32位ID，超出范围的ID不能截断后再查询
+            return label <= std::numeric_limits<uint32_t>::max() &&
+                   roaring_bitmap_contains(bitmap, static_cast<uint32_t>(label));
         }
     private:
         /**
@@ -82,13 +263,244 @@ public:
         const roaring_bitmap_t *bitmap;
     };
 
-private:                                  
+    /**
+     * @brief 带截止时间的搜索停止条件
+     * 该类继承自 hnswlib::BaseSearchStopCondition，在底层图上的行为与按ef搜索相同
+     * （保留ef个候选，候选距离超过当前最远结果时停止），另外每扩展若干个节点检查一次时钟，
+     * 超过截止时间后立即停止扩展。
+     */
+    class DeadlineStopCondition : public hnswlib::BaseSearchStopCondition<float>
+    {
+    public:
+        /**
+         * @brief 构造函数
+         * @param ef 搜索时保留的候选数量
+         * @param k 最终返回的结果数量
+         * @param deadline 截止时间
+         */
+        DeadlineStopCondition(size_t ef, size_t k, std::chrono::steady_clock::time_point deadline)
+            : ef(ef), k(k), deadline(deadline) {}
+
+        void add_point_to_result(hnswlib::labeltype label, const void *datapoint, float dist) override
+        {
+            resultCount++;
+        }
+
+        void remove_point_from_result(hnswlib::labeltype label, const void *datapoint, float dist) override
+        {
+            resultCount--;
+        }
+
+        bool should_stop_search(float candidateDist, float lowerBound) override
+        {
+            if (candidateDist > lowerBound && resultCount == ef)
+            {
+                return true;
+            }
+            // 读取时钟的开销相对一次节点扩展不可忽略，因此间隔检查
+            if (++expansions % HNSW_DEADLINE_CHECK_INTERVAL == 0 &&
+                std::chrono::steady_clock::now() >= deadline)
+            {
+                expired = true;
+            }
+            return expired;
+        }
+
+        bool should_consider_candidate(float candidateDist, float lowerBound) override
+        {
+            return resultCount < ef || lowerBound > candidateDist;
+        }
+
+        bool should_remove_extra() override
+        {
+            return resultCount > ef;
+        }
+
+        void filter_results(std::vector<std::pair<float, hnswlib::labeltype>> &candidates) override
+        {
+            // 候选已按距离由近到远排列，只保留前k个
+            if (candidates.size() > k)
+            {
+                candidates.resize(k);
+            }
+        }
+
+        /**
+         * @brief 搜索是否因超过截止时间而提前停止
+         * @return 提前停止时返回true
+         */
+        bool isExpired() const { return expired; }
+
+    private:
+        size_t ef;                                       ///< 保留的候选数量
+        size_t k;                                        ///< 返回的结果数量
+        std::chrono::steady_clock::time_point deadline;  ///< 截止时间
+        size_t resultCount = 0;                          ///< 当前保留的候选数量
+        size_t expansions = 0;                           ///< 已扩展的节点数量
+        bool expired = false;                            ///< 是否已超过截止时间
+    };
+
+private:
+    ///< 向量维度
+    int dim;
+    ///< 是否为余弦相似度索引：向量归一化后存入内积空间
+    bool cosine = false;
     ///< 向量空间接口，用于计算向量数据之间的距离的相似度
     hnswlib::SpaceInterface<float> *space;     
     ///< HNSW索引，用于存储向量数据和执行查询操作
     hnswlib::HierarchicalNSW<float> *index;   
 
-    ///< 索引能容纳的最大向量数量
-    size_t maxElements;
+    /**
+     * @brief 按余弦相似度搜索时，返回归一化后的向量
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param count 向量数量
+     * @param buffer 存放归一化结果的缓冲区
+     * @return 不是余弦相似度索引时返回data本身，否则返回buffer中的数据
+     */
+    const float *prepareVectors(const float *data, size_t count, std::vector<float> *buffer) const;
+
+    /**
+     * @brief 为即将写入的向量预留容量，不足时扩容
+     * @param count 即将写入的向量数量
+     * @param lock 调用方持有的共享锁，扩容期间会暂时释放
+     *
+     * 预留的数量计入 pendingInserts，写入完成后由调用方减去
+     */
+    void reserveCapacity(size_t count, std::shared_lock<std::shared_mutex> *lock);
+
+    /**
+     * @brief 选择一次搜索的候选数量，调用方需持有共享锁
+     * @param k 返回的最近邻数量
+     * @param bitmap 过滤位图，为nullptr时不过滤
+     * @return 候选数量
+     *
+     * 不过滤时为 max(k, HNSW_DEFAULT_EF_SEARCH)，带过滤时按位图基数占存活向量的比例放大（见 scaleEfForFilter）
+     */
+    size_t chooseEf(int k, const roaring_bitmap_t *bitmap) const;
+
+    /**
+     * @brief 在上层逐层贪心地移动到离查询最近的节点，调用方需持有共享锁且索引非空
+     * @param query 一个查询向量
+     * @return 底层搜索的入口节点
+     */
+    hnswlib::tableint descendUpperLayers(const float *query) const;
+
+    /**
+     * @brief 使用指定候选数量的k近邻搜索
+     * @param query 一个查询向量
+     * @param k 返回的最近邻数量
+     * @param ef 候选数量
+     * @param isIdAllowed 过滤器，为nullptr时不过滤
+     * @return 按距离由远到近出队的结果
+     *
+     * 与 hnswlib 的 searchKnn 相同，只是 ef 由参数传入而不是读取索引上的 ef_
+     */
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> searchKnn(
+        const float *query, size_t k, size_t ef, hnswlib::BaseFilterFunctor *isIdAllowed) const;
+
+    /**
+     * @brief 只在满足过滤条件的节点之间遍历的底层搜索（见 searchTwoHop）
+     * @param query 一个查询向量
+     * @param k 返回的最近邻数量
+     * @param ef 候选数量
+     * @param bitmap 过滤位图
+     * @param bridgeBudget 每个节点最多经过的桥梁数量
+     * @param deadline 截止时间
+     * @param expired 输出参数，超过截止时间而提前停止时置为true
+     * @return 按距离由远到近出队的结果
+     */
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> searchKnnTwoHop(
+        const float *query, size_t k, size_t ef, const roaring_bitmap_t *bitmap, size_t bridgeBudget,
+        std::chrono::steady_clock::time_point deadline, bool *expired) const;
+
+    /**
+     * @brief 按增长策略计算能容纳指定数量的容量
+     * @param current 当前容量
+     * @param required 需要容纳的向量数量
+     * @return 新容量
+     */
+    static size_t grownCapacity(size_t current, size_t required);
+
+    /**
+     * @brief 标签已在索引中（包括已删除的）时原地更新向量
+     * @param target 目标索引
+     * @param data 向量数据
+     * @param label 标签
+     * @return 标签不在索引中时返回false且不写入
+     *
+     * 已删除的标签先取消删除标记再更新，使每个标签始终只占用一个位置：
+     * 若让已删除标签换到别的墓碑位置，旧位置被复用时 hnswlib 会从标签表中删掉该标签的新映射
+     */
+    static bool updateExistingPoint(hnswlib::HierarchicalNSW<float> *target, const float *data,
+                                    hnswlib::labeltype label);
+
+    /**
+     * @brief 写入向量：已存在的标签原地更新，新标签优先复用墓碑位置
+     * @param target 目标索引
+     * @param data 向量数据
+     * @param label 标签
+     * @return 标签原本已存在时返回true
+     */
+    static bool addOrReplacePoint(hnswlib::HierarchicalNSW<float> *target, const float *data,
+                                  hnswlib::labeltype label);
+
+    /**
+     * @brief 标签存在且未删除时标记删除
+     * @param target 目标索引
+     * @param label 标签
+     * @return 实际标记删除时返回true
+     */
+    static bool markDeleteIfPresent(hnswlib::HierarchicalNSW<float> *target, hnswlib::labeltype label);
+
+    /**
+     * @brief 重建期间把一次写入或删除记录到写入日志，调用方需持有共享锁
+     * @param label 标签
+     * @param data 写入的向量，删除时为nullptr
+     */
+    void journal(hnswlib::labeltype label, const float *data);
+
+    /**
+     * @brief 墓碑比例超过阈值且没有正在进行的重建时，启动后台重建
+     */
+    void maybeStartRebuild();
+
+    /**
+     * @brief 后台重建：用存活的向量构建新索引，应用写入日志后原子切换
+     */
+    void rebuild();
+
+    /**
+     * @struct JournalEntry
+     * @brief 重建期间的一次写入或删除
+     */
+    struct JournalEntry
+    {
+        hnswlib::labeltype label;  ///< 标签
+        bool deleted;              ///< 是否为删除
+        std::vector<float> vector; ///< 写入的向量，删除时为空
+    };
+
+    ///< 扩容锁：扩容和切换重建后的索引持有独占锁，其他操作持有共享锁
+    mutable std::shared_mutex resizeMutex;
+    ///< 已预留容量、尚未写入完成的向量数量
+    std::atomic<size_t> pendingInserts{0};
+    ///< 自上次重建（或加载）以来标记删除和原地更新的次数，两者都会降低图的质量
+    std::atomic<size_t> tombstones{0};
+    ///< 后台重建完成的次数
+    std::atomic<uint64_t> rebuildCount{0};
 
+    ///< 是否有正在进行的后台重建
+    std::atomic<bool> rebuildRunning{false};
+    ///< 重建是否已开始记录写入日志，只在持有独占锁时修改
+    std::atomic<bool> journaling{false};
+    ///< 析构时通知后台重建尽快退出
+    std::atomic<bool> stopping{false};
+    ///< 保护写入日志
+    std::mutex journalMutex;
+    ///< 重建期间的写入日志，按发生顺序排列
+    std::vector<JournalEntry> journalEntries;
+    ///< 保护后台重建线程对象
+    std::mutex rebuildThreadMutex;
+    ///< 后台重建线程
+    std::thread rebuildThread;
 };
@@ -1,33 +1,115 @@
 #include "http_server.h"
 #include "faiss_index.h"
 #include "hnswlib_index.h"
+#include "ivf_index.h"
 #include "index_factory.h"
 #include "constants.h"
 #include "logger.h"
+#include "binary_protocol.h"
+#include "request.h"
+#include "request_timing.h"
+#include "search_response.h"
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 
 // NOTE: 括号内的都是传入的参数，括号外的是成员变量
 // 使用cpp-httplib库创建HTTP服务器对象server，并设置监听的主机和端口
-HttpServer::HttpServer(const std::string &host, int port, VectorDatabase *vectorDatabase)
-    : host(host), port(port), vectorDatabase(vectorDatabase)
+HttpServer::HttpServer(const std::string &host, int port, VectorDatabase *vectorDatabase,
+                       const HttpServerOptions &options)
+    : host(host), port(port), vectorDatabase(vectorDatabase), options(options)
 {
+    // 为配置了并发上限的接口创建限制器
+    for (const auto &limit : options.endpointConcurrencyLimits)
+    {
+        concurrencyLimiters[limit.first] = std::make_unique<ConcurrencyLimiter>(limit.second);
+    }
+
+    // 为每个数据接口创建运行指标，之后只读取映射本身，请求路径上无需加锁
+    for (const char *path : {"/insert", "/search", "/upsert", "/query", "/bulk_upsert", "/delete"})
+    {
+        endpointMetrics[path] = std::make_unique<EndpointMetrics>();
+    }
+
+    // 使用有界任务队列替换 httplib 默认的无界线程池
+    server.new_task_queue = [this]
+    {
+        size_t workerThreads = this->options.workerThreads > 0
+                                   ? this->options.workerThreads
+                                   : static_cast<size_t>(CPPHTTPLIB_THREAD_POOL_COUNT);
+        return new BoundedTaskQueue(workerThreads, this->options.maxQueuedConnections,
+                                    this->options.shedThreads, this->options.maxShedConnections,
+                                    &taskQueueStats);
+    };
+
+    // 降载线程上的请求不进入路由，直接返回503
+    server.set_pre_routing_handler([this](const httplib::Request &req, httplib::Response &res)
+    {
+        if (!BoundedTaskQueue::isShedding())
+        {
+            return httplib::Server::HandlerResponse::Unhandled;
+        }
+        res.status = RESPONSE_STATUS_OVERLOADED;
+        res.set_header("Retry-After", HTTP_RETRY_AFTER_SECONDS);
+        // 响应带上 Connection: close，要求客户端关闭连接、下次重连时重新排队。
+        // httplib 在路由之前已经决定是否继续读取这个连接，这里无法让服务端主动关闭；
+        // 它只在写响应时检查请求的 Connection 头（见 Server::write_response_core），
+        // 因此修改的是 httplib 内部的非 const 请求对象。客户端关闭后连接循环读到EOF即退出，
+        // 不遵守的客户端最多占用降载线程到 keep-alive 超时
+        httplib::Request &mutableReq = const_cast<httplib::Request &>(req);
+        mutableReq.headers.erase("Connection");
+        mutableReq.set_header("Connection", "close");
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Server is overloaded, retry later");
+        return httplib::Server::HandlerResponse::Handled;
+    });
+
     // NOTE: lambda表达式写法
     // 当请求路径为 "/insert" 时，调用 insertHandler 函数处理请求
     server.Post("/insert", [&](const httplib::Request &req, httplib::Response &res)
-                { insertHandler(req, res); });
+                { runWithConcurrencyLimit("/insert", res, [&]
+                                          { insertHandler(req, res); }); });
     // 当请求路径为 "/search" 时，调用 searchHandler 函数处理请求
     server.Post("/search", [&](const httplib::Request &req, httplib::Response &res)
-                { searchHandler(req, res); });
+                { runWithConcurrencyLimit("/search", res, [&]
+                                          { searchHandler(req, res); }); });
     // 当请求路径为 "/upsert" 时，调用 upsertHandler 函数处理请求
     server.Post("/upsert", [&](const httplib::Request &req, httplib::Response &res)
-                { upsertHandler(req, res); });
+                { runWithConcurrencyLimit("/upsert", res, [&]
+                                          { upsertHandler(req, res); }); });
     // 当请求路径为 "/query" 时，调用 queryHandler 函数处理请求
     server.Post("/query", [&](const httplib::Request &req, httplib::Response &res)
-                { queryHandler(req, res); });
+                { runWithConcurrencyLimit("/query", res, [&]
+                                          { queryHandler(req, res); }); });
+    // 当请求路径为 "/delete" 时，调用 deleteHandler 函数处理请求
+    server.Post("/delete", [&](const httplib::Request &req, httplib::Response &res)
+                { runWithConcurrencyLimit("/delete", res, [&]
+                                          { deleteHandler(req, res); }); });
+    // 当请求路径为 "/bulk_upsert" 时，调用 bulkUpsertHandler 以流式方式读取请求体
+    server.Post("/bulk_upsert", [&](const httplib::Request &req, httplib::Response &res,
+                                    const httplib::ContentReader &contentReader)
+                { runWithConcurrencyLimit("/bulk_upsert", res, [&]
+                                          { bulkUpsertHandler(req, res, contentReader); }); });
     server.Post("/admin/snapshot", [&](const httplib::Request &req, httplib::Response &res)
                 { snapshotHandler(req, res); });
+    server.Post("/admin/train", [&](const httplib::Request &req, httplib::Response &res)
+                { trainHandler(req, res); });
+    // 创建和列出命名集合
+    server.Post("/admin/collections", [&](const httplib::Request &req, httplib::Response &res)
+                { createCollectionHandler(req, res); });
+    server.Get("/admin/collections", [&](const httplib::Request &req, httplib::Response &res)
+               { listCollectionsHandler(req, res); });
+    server.Get("/admin/stats", [&](const httplib::Request &req, httplib::Response &res)
+               { statsHandler(req, res); });
+    // 当请求路径为 "/metrics" 时，以 Prometheus 文本格式返回运行指标
+    server.Get("/metrics", [&](const httplib::Request &req, httplib::Response &res)
+               { metricsHandler(req, res); });
 }
 
 void HttpServer::start()
@@ -57,9 +139,9 @@ void HttpServer::setJsonResponse(const rapidjson::Document &jsonResponse, httpli
     jsonResponse.Accept(writer);
 
     // 4.设置 HTTP 响应
-    // - 使用 buffer.GetString() 获取生成的 JSON 字符串
+    // - 使用 buffer.GetString() 和 buffer.GetSize() 获取生成的 JSON 字符串，避免再计算一次长度
     // - RESPONSE_CONTENT_TYPE_JSON 指定内容类型为 "application/json"
-    res.set_content(buffer.GetString(), RESPONSE_CONTENT_TYPE_JSON);
+    res.set_content(buffer.GetString(), buffer.GetSize(), RESPONSE_CONTENT_TYPE_JSON);
 }
 
 /**
@@ -101,7 +183,7 @@ void HttpServer::setErrorJsonResponse(httplib::Response &res, int error_code, co
  * @param check_type 检查类型（SEARCH或INSERT）
  * @return bool 如果所有必要参数都存在且格式正确则返回true，否则返回false
  */
-bool HttpServer::isRequestValid(const rapidjson::Document &jsonRequest,
+bool HttpServer::isRequestValid(const rapidjson::Value &jsonRequest,
                                 CheckType check_type)
 {
     switch (check_type)
@@ -138,37 +220,6 @@ bool HttpServer::isRequestValid(const rapidjson::Document &jsonRequest,
     }
 }
 
-/**
- * @brief 从请求中获取索引类型
- * @details 该函数从 JSON 请求中解析索引类型参数：
- *          1. 如果请求中包含 indexType 字段，则根据其值返回对应的索引类型
- *          2. 如果请求中不包含 indexType 字段，则返回 UNKNOWN 类型
- * @param jsonRequest JSON 请求文档对象
- * @return IndexFactory::IndexType 返回解析出的索引类型
- * @note 目前仅支持 FLAT 类型的索引，其他类型将返回 UNKNOWN
- */
-IndexFactory::IndexType HttpServer::getIndexTypeFromRequest(const rapidjson::Document &jsonRequest)
-{
-    // 如果请求中包含 indexType 字段
-    if (jsonRequest.HasMember(REQUEST_INDEX_TYPE))
-    {
-        // 获取索引类型字符串
-        std::string indexTypeStr = jsonRequest[REQUEST_INDEX_TYPE].GetString();
-        // 根据字符串值返回对应的索引类型
-        if (indexTypeStr == INDEX_TYPE_FLAT)
-        {
-            return IndexFactory::IndexType::FLAT;
-        }
-        else if (indexTypeStr == INDEX_TYPE_HNSW)
-        {
-            return IndexFactory::IndexType::HNSW;
-        }
-        // TODO: 支持其他索引类型
-    }
-    // 如果请求中不包含 indexType 字段或类型未知，返回 UNKNOWN
-    return IndexFactory::IndexType::UNKNOWN;
-}
-
 /**
  * @brief 处理向量搜索请求的处理器函数
  * @details 该函数处理客户端发送的向量搜索请求，主要功能包括：
@@ -182,96 +233,269 @@ IndexFactory::IndexType HttpServer::getIndexTypeFromRequest(const rapidjson::Doc
 void HttpServer::searchHandler(const httplib::Request &req, httplib::Response &res)
 {
     // 打印接收到了搜索请求
-    globalLogger->debug("Received search request");
+    LOG_DEBUG("Received search request");
 
-    // 解析请求体中的JSON请求内容
-    rapidjson::Document jsonRequest;
-    jsonRequest.Parse(req.body.c_str());
+    // 分阶段计时：请求带有调试头时返回 Server-Timing 头，耗时超过阈值时输出慢请求日志
+    uint64_t queueWaitMicros = BoundedTaskQueue::takeQueueWaitMicros();
+    RequestTiming timing("search", req.has_header(HEADER_DEBUG_TIMING),
+                         options.slowRequestThresholdMillis * 1000, queueWaitMicros);
 
-    // 打印用户的输入参数
-    globalLogger->info("Search request parameters: {}", req.body);
+    SearchRequest request; // 解码后的搜索请求
+    std::string errorMsg;
 
-    // 检查JSON文档是否为有效的对象
-    if (!jsonRequest.IsObject())
     {
-        globalLogger->error("Invalid JSON request");
+        ScopedStageTimer parseTimer(TimingStage::PARSE);
+        if (isBinaryContentType(req.get_header_value("Content-Type")))
+        {
+            // 二进制请求：向量直接从请求体中拷贝，其余参数来自元数据JSON
+            BinaryRequest binaryRequest;
+            if (parseBinaryRequest(req.body, &binaryRequest, &errorMsg) &&
+                decodeSearchOptions(binaryRequest.meta, &request, &errorMsg))
+            {
+                request.vectors.swap(binaryRequest.vectors);
+                request.numQueries = binaryRequest.count;
+                request.isBatch = request.numQueries > 1;
+            }
+        }
+        else
+        {
+            // 采样打印用户的输入参数
+            logRequestBody("Search", req.body);
+
+            // 原位解析请求体，并一次性解码出全部查询参数
+            ScopedRequestJson jsonScope;
+            RequestDocument &jsonRequest = parseRequestJson(req.body);
+            decodeSearchRequest(jsonRequest, &request, &errorMsg);
+        }
+    }
+
+    // 集合必须存在，每个查询向量的维度必须与集合一致
+    if (errorMsg.empty())
+    {
+        checkCollection(request.collection, request.vectors.size() / request.numQueries, &errorMsg);
+    }
+
+    // 参数不合法时返回错误响应
+    if (!errorMsg.empty())
+    {
+        globalLogger->error(errorMsg);
         res.status = 400; // Bad Request - 请求格式错误
-        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
-                             "Invalid JSON request");
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
         return;
     }
 
-    // 检查请求参数的合法性（vectors和k参数是否存在且格式正确）
-    if (!isRequestValid(jsonRequest, CheckType::SEARCH))
+    int k = request.k;
+    size_t numQueries = request.numQueries;
+    LOG_DEBUG("Query parameters: k = {}, numQueries = {}, queueWaitMicros = {}",
+              k, numQueries, queueWaitMicros);
+
+    // 使用VectorDatabase 的 search 接口执行查询（批量查询在一次索引调用中完成）
+    // 超过请求的时间预算时返回已找到的部分结果
+    bool partial = false;
+    SearchPlan plan;
+    std::pair<std::vector<long>, std::vector<float>> results = vectorDatabase->search(request, &partial, &plan);
+
+    // 按需一次性读取命中记录的字段和向量，省去客户端再调用 /query
+    SearchHitPayload payload;
     {
-        globalLogger->error(
-            "Missing vectors or k parameter in the request");
-        res.status = 400;
-        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
-                             "Missing vectors or k parameters in the request");
-        return;
+        ScopedStageTimer fetchTimer(TimingStage::FETCH);
+        payload = buildHitPayload(request, results.first);
     }
 
-    // 获取请求中的查询参数：vectors待查询向量
-    // TODO: 支持查询多个向量（目前仅支持单个，即vectors字段的值仅为单个向量）
-    std::vector<float> query;
-    for (const auto &q : jsonRequest[REQUEST_VECTORS].GetArray())
+    // 直接把结果写成JSON文本，不再构建中间的 rapidjson::Document
+    if (results.first.size() >= SEARCH_STREAMING_MIN_SLOTS)
     {
-        // 将待查询向量的每个元素添加到query数组中
-        query.push_back(q.GetFloat());
+        // 结果集很大时使用分块传输：每次只序列化一段，写出后复用同一块缓冲区
+        struct StreamState
+        {
+            rapidjson::StringBuffer buffer;
+            SearchResponseWriter writer;
+            StreamState(std::pair<std::vector<long>, std::vector<float>> results,
+                        size_t numQueries, int k, bool isBatch, SearchHitPayload payload)
+                : writer(std::move(results), numQueries, k, isBatch, buffer, std::move(payload)) {}
+        };
+        auto state = std::make_shared<StreamState>(std::move(results), numQueries, k, request.isBatch,
+                                                   std::move(payload));
+        state->writer.setPartial(partial);
+        if (request.explain)
+        {
+            state->writer.setPlan(plan);
+        }
+        // 分块序列化在处理函数返回后进行，不计入 Server-Timing
+        if (timing.isHeaderRequested())
+        {
+            res.set_header("Server-Timing", timing.toServerTiming());
+        }
+        res.set_chunked_content_provider(
+            RESPONSE_CONTENT_TYPE_JSON,
+            [state](size_t /*offset*/, httplib::DataSink &sink)
+            {
+                bool finished = state->writer.write(SEARCH_STREAMING_CHUNK_VALUES);
+                if (!sink.write(state->buffer.GetString(), state->buffer.GetSize()))
+                {
+                    return false;
+                }
+                state->buffer.Clear();
+                if (finished)
+                {
+                    sink.done();
+                }
+                return true;
+            });
+        return;
     }
-    // 获取请求中的查询参数：k返回的结果向量的数量
-    int k = jsonRequest[REQUEST_K].GetInt();
 
-    globalLogger->debug("Query parameters: k = {}", k);
+    // 线程局部缓冲区在请求之间复用，按估算大小预留空间后一次写完
+    thread_local rapidjson::StringBuffer buffer;
+    buffer.Clear();
+    {
+        ScopedStageTimer serializeTimer(TimingStage::SERIALIZE);
+        SearchResponseWriter writer(std::move(results), numQueries, k, request.isBatch, buffer,
+                                    std::move(payload));
+        writer.setPartial(partial);
+        if (request.explain)
+        {
+            writer.setPlan(plan);
+        }
+        buffer.Reserve(writer.estimateSize());
+        writer.write(std::numeric_limits<size_t>::max());
+        res.set_content(buffer.GetString(), buffer.GetSize(), RESPONSE_CONTENT_TYPE_JSON);
+    }
+    if (timing.isHeaderRequested())
+    {
+        res.set_header("Server-Timing", timing.toServerTiming());
+    }
+}
 
-    // 获取请求中的查询参数：indexType索引类型
-    IndexFactory::IndexType index_type = getIndexTypeFromRequest(jsonRequest);
-    if (index_type == IndexFactory::IndexType::UNKNOWN)
+/**
+ * @brief 组装随搜索结果返回的字段和命中向量
+ * @param request 搜索请求
+ * @param ids 搜索结果中的ID，每个查询占k个位置
+ * @return 与结果位置一一对应的附加数据
+ *
+ * 所有命中ID去重后只读取一次：HNSW命中的向量直接从索引读取，
+ * 字段以及其余命中的向量来自标量存储的一次批量读取。只有请求的字段会被投影进响应。
+ */
+SearchHitPayload HttpServer::buildHitPayload(const SearchRequest &request, const std::vector<long> &ids)
+{
+    SearchHitPayload payload;
+    payload.hasFields = !request.includeFields.empty();
+    payload.hasVectors = request.includeVector;
+    if (!payload.hasFields && !payload.hasVectors)
     {
-        globalLogger->error(
-            "Invalid indexType parameter in the request");
-        // 如果索引类型无效，返回错误响应
-        res.status = 400;
-        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
-                             "Invalid indexType parameter in the request");
-        return;
+        return payload;
     }
 
-    // 使用VectorDatabase 的 search 接口执行查询
-    std::pair<std::vector<long>, std::vector<float>> results = vectorDatabase->search(jsonRequest);
+    // 收集去重后的有效ID
+    std::vector<uint64_t> uniqueIds;
+    std::unordered_map<long, size_t> idPositions;
+    for (long id : ids)
+    {
+        if (id != -1 && idPositions.emplace(id, uniqueIds.size()).second)
+        {
+            uniqueIds.push_back(static_cast<uint64_t>(id));
+        }
+    }
 
-    // 将结果转换为JSON格式
-    rapidjson::Document jsonResponse;
-    jsonResponse.SetObject();
-    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    // 优先从索引中读取命中向量，读不到的再从记录中获取
+    std::vector<std::vector<float>> vectors(uniqueIds.size());
+    bool needRecords = payload.hasFields;
+    if (payload.hasVectors)
+    {
+        vectors = vectorDatabase->getIndexVectors(request.indexType, uniqueIds, request.collection);
+        for (const std::vector<float> &vector : vectors)
+        {
+            needRecords = needRecords || vector.empty();
+        }
+    }
 
-    // 检查搜索结果的有效性并构建响应数据
-    bool valid_results = false;
-    rapidjson::Value vectors(rapidjson::kArrayType);   // 存储找到的向量ID
-    rapidjson::Value distances(rapidjson::kArrayType); // 存储对应的距离值
+    // 一次批量读取所有命中记录
+    std::vector<std::string> records;
+    if (needRecords)
+    {
+        records = vectorDatabase->queryRecords(uniqueIds, request.collection);
+    }
 
-    // 遍历搜索结果，只添加有效的结果（ID != -1）
-    for (size_t i = 0; i < results.first.size(); i++)
+    std::vector<std::string> projected(uniqueIds.size());
+    rapidjson::StringBuffer buffer;
+    for (size_t i = 0; i < records.size(); i++)
     {
-        if (results.first[i] != -1) // -1表示无效结果
+        if (records[i].empty())
+        {
+            continue;
+        }
+        rapidjson::Document record;
+        record.Parse(records[i].data(), records[i].size());
+        if (!record.IsObject())
+        {
+            continue;
+        }
+
+        // 只投影请求的字段，记录中不存在的字段不输出
+        if (payload.hasFields)
+        {
+            buffer.Clear();
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            for (const std::string &field : request.includeFields)
+            {
+                rapidjson::Value name(rapidjson::StringRef(field.data(), field.size()));
+                auto member = record.FindMember(name);
+                if (member != record.MemberEnd())
+                {
+                    writer.Key(field.data(), static_cast<rapidjson::SizeType>(field.size()));
+                    member->value.Accept(writer);
+                }
+            }
+            writer.EndObject();
+            projected[i].assign(buffer.GetString(), buffer.GetSize());
+        }
+
+        // 索引中读不到向量时使用记录中的vectors字段
+        if (payload.hasVectors && vectors[i].empty())
         {
-            valid_results = true;
-            vectors.PushBack(results.first[i], allocator);
-            distances.PushBack(results.second[i], allocator);
+            auto member = record.FindMember(REQUEST_VECTORS);
+            if (member != record.MemberEnd() && member->value.IsArray())
+            {
+                for (const auto &value : member->value.GetArray())
+                {
+                    if (!value.IsNumber())
+                    {
+                        vectors[i].clear();
+                        break;
+                    }
+                    vectors[i].push_back(value.GetFloat());
+                }
+            }
         }
     }
 
-    // 如果存在有效结果，将结果添加到响应中
-    if (valid_results)
+    // 按结果位置展开，同一ID在多个查询中命中时共用一份数据
+    if (payload.hasFields)
     {
-        jsonResponse.AddMember(RESPONSE_VECTORS, vectors.Move(), allocator);
-        jsonResponse.AddMember(RESPONSE_DISTANCES, distances.Move(), allocator);
+        payload.fields.resize(ids.size());
     }
-    // 设置返回码为成功
-    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
-    // 设置JSON响应
-    setJsonResponse(jsonResponse, res);
+    if (payload.hasVectors)
+    {
+        payload.vectors.resize(ids.size());
+    }
+    for (size_t position = 0; position < ids.size(); position++)
+    {
+        if (ids[position] == -1)
+        {
+            continue;
+        }
+        size_t index = idPositions[ids[position]];
+        if (payload.hasFields)
+        {
+            payload.fields[position] = projected[index];
+        }
+        if (payload.hasVectors)
+        {
+            payload.vectors[position] = vectors[index];
+        }
+    }
+    return payload;
 }
 
 /**
@@ -291,14 +515,14 @@ void HttpServer::insertHandler(const httplib::Request &req,
                                httplib::Response &res)
 {
     // 打印接收到了插入请求
-    globalLogger->debug("Received insert request");
+    LOG_DEBUG("Received insert request");
 
     // 解析请求体中的JSON请求内容
-    rapidjson::Document jsonRequest;
-    jsonRequest.Parse(req.body.c_str());
+    ScopedRequestJson jsonScope;
+    RequestDocument &jsonRequest = parseRequestJson(req.body);
 
-    // 打印用户的输入参数
-    globalLogger->info("Insert request parameters: {}", req.body);
+    // 采样打印用户的输入参数
+    logRequestBody("Insert", req.body);
 
     // 检查JSON文档是否为有效的对象
     if (!jsonRequest.IsObject())
@@ -329,7 +553,7 @@ void HttpServer::insertHandler(const httplib::Request &req,
     }
     // 获取请求中的插入参数：id待插入向量的唯一标识
     uint64_t id = jsonRequest[REQUEST_ID].GetUint64();
-    globalLogger->debug("Insert parameters: id = {}", id);
+    LOG_DEBUG("Insert parameters: id = {}", id);
 
     // 获取请求中的插入参数：indexType索引类型
     IndexFactory::IndexType indexType = getIndexTypeFromRequest(jsonRequest);
@@ -343,8 +567,18 @@ void HttpServer::insertHandler(const httplib::Request &req,
         return;
     }
 
-    // 从全局索引工厂获取对应类型的索引实例
-    void *index = getGlobalIndexFactory()->getIndex(indexType);
+    // 从请求所属集合的索引工厂获取对应类型的索引实例
+    std::string collectionName;
+    std::string errorMsg;
+    if (!decodeCollectionName(jsonRequest, &collectionName, &errorMsg) ||
+        !checkCollection(collectionName, data.size(), &errorMsg))
+    {
+        globalLogger->error(errorMsg);
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+        return;
+    }
+    void *index = vectorDatabase->getCollection(collectionName)->getIndexFactory()->getIndex(indexType);
 
     // 根据索引类型初始化索引对象并调用insert_vectors函数
     switch (indexType)
@@ -361,6 +595,12 @@ void HttpServer::insertHandler(const httplib::Request &req,
         hnswIndex->insertVectors(data, id);
         break;
     }
+    case IndexFactory::IndexType::IVF:
+    {
+        IVFIndex *ivfIndex = static_cast<IVFIndex *>(index);
+        ivfIndex->upsertVectors(data, {static_cast<long>(id)});
+        break;
+    }
     // TODO: 支持其他索引类型
     case IndexFactory::IndexType::UNKNOWN:
     default:
@@ -391,48 +631,242 @@ void HttpServer::insertHandler(const httplib::Request &req,
 void HttpServer::upsertHandler(const httplib::Request &req, httplib::Response &res)
 {
     // 打印接收到了更新请求
-    globalLogger->debug("Received upsert request");
+    LOG_DEBUG("Received upsert request");
 
-    // 解析请求体中的JSON请求内容
-    rapidjson::Document jsonRequest;
-    jsonRequest.Parse(req.body.c_str());
+    // 分阶段计时：请求带有调试头时返回 Server-Timing 头，耗时超过阈值时输出慢请求日志
+    RequestTiming timing("upsert", req.has_header(HEADER_DEBUG_TIMING),
+                         options.slowRequestThresholdMillis * 1000, BoundedTaskQueue::takeQueueWaitMicros());
 
-    // 打印用户的输入参数
-    globalLogger->info("Upsert request parameters: {}", req.body);
+    UpsertRequest request; // 解码后的更新请求
+    std::string errorMsg;
 
-    // 检查JSON文档是否为有效的对象
-    if (!jsonRequest.IsObject())
     {
-        globalLogger->error("Invalid JSON request");
-        res.status = 400;
-        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
-                             "Invalid JSON request");
-        return;
+        ScopedStageTimer parseTimer(TimingStage::PARSE);
+        if (isBinaryContentType(req.get_header_value("Content-Type")))
+        {
+            // 二进制请求：元数据JSON中是除vectors外的记录字段，向量直接从请求体中拷贝
+            BinaryRequest binaryRequest;
+            if (parseBinaryRequest(req.body, &binaryRequest, &errorMsg))
+            {
+                if (binaryRequest.count != 1)
+                {
+                    errorMsg = "Binary upsert expects an object metadata and exactly one vector";
+                }
+                else
+                {
+                    // 预先填入向量，解码时会把它补进写入标量存储和WAL日志的记录文本中
+                    request.vector.swap(binaryRequest.vectors);
+                    decodeUpsertRequest(binaryRequest.meta, &request, &errorMsg);
+                }
+            }
+        }
+        else
+        {
+            // 采样打印用户的输入参数
+            logRequestBody("Upsert", req.body);
+
+            // 原位解析请求体；请求体本身保持不变，可直接作为记录文本
+            ScopedRequestJson jsonScope;
+            RequestDocument &jsonRequest = parseRequestJson(req.body);
+            decodeUpsertRequest(jsonRequest, &request, &errorMsg, req.body);
+        }
+    }
+
+    // 集合必须存在，向量维度必须与集合一致
+    if (errorMsg.empty())
+    {
+        checkCollection(request.collection, request.vector.size(), &errorMsg);
     }
 
     // 检查请求参数的合法性（vectors和id参数是否存在且格式正确）
-    if (!isRequestValid(jsonRequest, CheckType::UPSERT)){
-        globalLogger->error("Missing vectors or id parameter in the request");
+    if (!errorMsg.empty())
+    {
+        globalLogger->error(errorMsg);
         res.status = 400;
-        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
-                             "Missing vectors or id parameters in the request");
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
         return;
     }
 
-    // 获取请求中的更新参数：id待更新向量的唯一标识
-    uint64_t id = jsonRequest[REQUEST_ID].GetUint64();
-    globalLogger->debug("Upsert parameters: id = {}", id);
-    // 获取请求参数中的索引类型
-    IndexFactory::IndexType indexType = getIndexTypeFromRequest(jsonRequest);
+    LOG_DEBUG("Upsert parameters: id = {}", request.id);
+
+    // 调用 VectorDatabase::upsert 接口执行更新操作，WAL日志在集合的写入锁内写入
+    vectorDatabase->upsert(request, true);
+
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+    if (timing.isHeaderRequested())
+    {
+        res.set_header("Server-Timing", timing.toServerTiming());
+    }
+}
+
+/**
+ * @brief 处理批量更新请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ * @param contentReader 请求体读取器，用于流式读取请求体
+ *
+ * 请求体支持两种格式：
+ * 1. NDJSON（Content-Type: application/x-ndjson）：每行一条记录，边接收边处理，
+ *    不需要把整个请求体放进内存
+ * 2. JSON数组：[{...}, {...}]，整体解析后按批次处理
+ *
+ * 每条记录的格式与 /upsert 的请求体相同。记录按 BULK_UPSERT_BATCH_SIZE 分批，
+ * 每个批次调用一次 VectorDatabase::bulkUpsert，每个集合实际写入的记录写入一条 bulk_upsert WAL 日志。
+ * 格式不合法的记录会被跳过并计入 failed。
+ */
+void HttpServer::bulkUpsertHandler(const httplib::Request &req, httplib::Response &res,
+                                   const httplib::ContentReader &contentReader)
+{
+    // 打印接收到了批量更新请求
+    LOG_DEBUG("Received bulk upsert request");
+
+    size_t upserted = 0; // 成功写入的记录数量
+    size_t failed = 0;   // 被跳过的记录数量
+
+    // 当前批次中已解码的请求，每条请求自己持有向量和记录文本，
+    // 因此解析用的JSON文档在解码后即可复用
+    std::vector<UpsertRequest> batch;
+    batch.reserve(BULK_UPSERT_BATCH_SIZE);
+
+    // 把当前批次写入数据库和WAL日志，然后清空批次
+    auto flushBatch = [&]()
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        // 实际写入的记录在集合的写入锁内写入WAL日志，被跳过的记录不进入日志
+        size_t applied = vectorDatabase->bulkUpsert(batch, true);
+        upserted += applied;
+        failed += batch.size() - applied;
+        batch.clear();
+    };
+
+    // 解码一条记录，合法则放入批次，批次满时写入
+    // vector 非空时表示二进制请求中该记录的向量；rawText 为记录的原始JSON文本
+    auto addRecord = [&](const rapidjson::Value &record, std::vector<float> vector,
+                         std::string_view rawText)
+    {
+        std::string errorMsg;
+        batch.emplace_back();
+        batch.back().vector.swap(vector);
+        if (!decodeUpsertRequest(record, &batch.back(), &errorMsg, rawText) ||
+            batch.back().indexType == IndexFactory::IndexType::UNKNOWN ||
+            vectorDatabase->getCollection(batch.back().collection) == nullptr)
+        {
+            batch.pop_back();
+            failed++;
+            return;
+        }
+        if (batch.size() >= BULK_UPSERT_BATCH_SIZE)
+        {
+            flushBatch();
+        }
+    };
 
-    // 调用 VectorDatabase::upsert 接口执行更新操作
-    vectorDatabase->upsert(id, jsonRequest, indexType);
-    // 调用 VectorDatabase::writeWALLog 接口写入 WAL 日志
-    vectorDatabase->writeWALLog("upsert", jsonRequest);
+    std::string contentType = req.get_header_value("Content-Type");
+    if (isBinaryContentType(contentType))
+    {
+        // 二进制请求：元数据是记录数组，第i个向量属于第i条记录
+        std::string body;
+        contentReader([&](const char *data, size_t length)
+        {
+            body.append(data, length);
+            return true;
+        });
+
+        BinaryRequest binaryRequest;
+        std::string errorMsg;
+        if (!parseBinaryRequest(body, &binaryRequest, &errorMsg) ||
+            !binaryRequest.meta.IsArray() || binaryRequest.meta.Size() != binaryRequest.count)
+        {
+            if (errorMsg.empty())
+            {
+                errorMsg = "Binary bulk upsert expects an array metadata with one record per vector";
+            }
+            globalLogger->error(errorMsg);
+            res.status = 400;
+            setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+            return;
+        }
+
+        for (rapidjson::SizeType i = 0; i < binaryRequest.count; i++)
+        {
+            const float *data = binaryRequest.vectors.data() + static_cast<size_t>(i) * binaryRequest.dim;
+            addRecord(binaryRequest.meta[i], std::vector<float>(data, data + binaryRequest.dim), {});
+        }
+        flushBatch();
+    }
+    else if (contentType.find(CONTENT_TYPE_NDJSON) != std::string::npos)
+    {
+        // NDJSON：按行切分，收到完整的一行就解析一条记录
+        // 解析结束后释放超长行占用的线程局部内存
+        ScopedRequestJson jsonScope;
+        std::string pending;
+        contentReader([&](const char *data, size_t length)
+        {
+            pending.append(data, length);
+            size_t lineStart = 0;
+            size_t lineEnd;
+            while ((lineEnd = pending.find('\n', lineStart)) != std::string::npos)
+            {
+                if (lineEnd > lineStart)
+                {
+                    std::string_view line(pending.data() + lineStart, lineEnd - lineStart);
+                    addRecord(parseRequestJson(line), {}, line);
+                }
+                lineStart = lineEnd + 1;
+            }
+            pending.erase(0, lineStart);
+            return true;
+        });
+        // 最后一行可能没有换行符
+        if (pending.find_first_not_of(" \t\r") != std::string::npos)
+        {
+            addRecord(parseRequestJson(pending), {}, pending);
+        }
+        flushBatch();
+    }
+    else
+    {
+        // JSON数组：读取完整请求体后整体解析
+        std::string body;
+        contentReader([&](const char *data, size_t length)
+        {
+            body.append(data, length);
+            return true;
+        });
+
+        // 请求体已是本地副本，直接原位解析，不再拷贝到线程局部缓冲区
+        ScopedRequestJson jsonScope;
+        RequestDocument &jsonRequest = parseRequestJsonInsitu(&body);
+        if (!jsonRequest.IsArray())
+        {
+            globalLogger->error("Invalid JSON request, bulk upsert expects an array or NDJSON");
+            res.status = 400;
+            setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR,
+                                 "Invalid JSON request, bulk upsert expects an array or NDJSON");
+            return;
+        }
+        // 数组元素没有单独的原始文本，解码时各自序列化为记录文本
+        for (const auto &item : jsonRequest.GetArray())
+        {
+            addRecord(item, {}, {});
+        }
+        flushBatch();
+    }
+
+    globalLogger->info("Bulk upsert finished: upserted = {}, failed = {}", upserted, failed);
 
     rapidjson::Document jsonResponse;
     jsonResponse.SetObject();
     rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    jsonResponse.AddMember(RESPONSE_UPSERTED, static_cast<uint64_t>(upserted), allocator);
+    jsonResponse.AddMember(RESPONSE_FAILED, static_cast<uint64_t>(failed), allocator);
     jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
     setJsonResponse(jsonResponse, res);
 }
@@ -452,17 +886,38 @@ void HttpServer::upsertHandler(const httplib::Request &req, httplib::Response &r
 void HttpServer::queryHandler(const httplib::Request &req, httplib::Response &res)
 {
     // 打印接收到了查询请求
-    globalLogger->debug("Received query request");
+    LOG_DEBUG("Received query request");
 
     // 解析请求体中的JSON请求内容
-    rapidjson::Document jsonRequest;
-    jsonRequest.Parse(req.body.c_str());
+    ScopedRequestJson jsonScope;
+    RequestDocument &jsonRequest = parseRequestJson(req.body);
+
+    // 采样打印用户的输入参数
+    logRequestBody("Query", req.body);
+
+    // 集合必须存在
+    std::string collection;
+    std::string errorMsg;
+    if (jsonRequest.IsObject() &&
+        (!decodeCollectionName(jsonRequest, &collection, &errorMsg) ||
+         !checkCollection(collection, 0, &errorMsg)))
+    {
+        globalLogger->error(errorMsg);
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+        return;
+    }
 
-    // 打印用户的输入参数
-    globalLogger->info("Query request parameters: {}", req.body);
+    // 带有ids列表时按列表批量查询
+    if (jsonRequest.IsObject() && jsonRequest.HasMember(REQUEST_IDS))
+    {
+        queryRecordsHandler(jsonRequest[REQUEST_IDS], collection, res);
+        return;
+    }
 
     // 检查JSON文档是否为有效的对象
-    if (!jsonRequest.IsObject())
+    if (!jsonRequest.IsObject() || !jsonRequest.HasMember(REQUEST_ID) ||
+        !jsonRequest[REQUEST_ID].IsUint64())
     {
         globalLogger->error("Invalid JSON request");
         res.status = 400;
@@ -473,10 +928,10 @@ void HttpServer::queryHandler(const httplib::Request &req, httplib::Response &re
 
     // 从JSON请求中获取查询参数：id待查询数据的唯一标识
     uint64_t id = jsonRequest[REQUEST_ID].GetUint64();
-    globalLogger->debug("Query parameters: id = {}", id);
+    LOG_DEBUG("Query parameters: id = {}", id);
 
     // 查询JSON数据
-    rapidjson::Document jsonData = vectorDatabase->query(id);
+    rapidjson::Document jsonData = vectorDatabase->query(id, collection);
 
     // 将结果转换为JSON格式
     rapidjson::Document jsonResponse;
@@ -497,6 +952,133 @@ void HttpServer::queryHandler(const httplib::Request &req, httplib::Response &re
     setJsonResponse(jsonResponse, res);
 }
 
+/**
+ * @brief 处理删除请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ *
+ * 请求形如 {"id": 1, "collection": "docs"}。记录存在时先删除再写入WAL日志，
+ * 日志内容只包含ID和集合名；记录不存在时不写日志，deleted为0
+ */
+void HttpServer::deleteHandler(const httplib::Request &req, httplib::Response &res)
+{
+    LOG_DEBUG("Received delete request");
+
+    ScopedRequestJson jsonScope;
+    RequestDocument &jsonRequest = parseRequestJson(req.body);
+    logRequestBody("Delete", req.body);
+
+    std::string collection;
+    std::string errorMsg;
+    if (!jsonRequest.IsObject() || !jsonRequest.HasMember(REQUEST_ID) || !jsonRequest[REQUEST_ID].IsUint64())
+    {
+        errorMsg = "Missing id parameter in the request";
+    }
+    else if (decodeCollectionName(jsonRequest, &collection, &errorMsg))
+    {
+        checkCollection(collection, 0, &errorMsg);
+    }
+    if (!errorMsg.empty())
+    {
+        globalLogger->error(errorMsg);
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+        return;
+    }
+
+    uint64_t id = jsonRequest[REQUEST_ID].GetUint64();
+    // 记录存在时在集合的写入锁内写入 delete 日志
+    bool deleted = vectorDatabase->remove(id, collection, true);
+
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    jsonResponse.AddMember(RESPONSE_DELETED, deleted ? 1 : 0, allocator);
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+}
+
+/**
+ * @brief 批量查询多个ID的记录
+ * @param ids 请求中的ID列表
+ * @param collection 集合名
+ * @param res HTTP响应对象
+ *
+ * 所有ID通过一次 RocksDB MultiGet 读取，结果按请求中的顺序放在 results 中，
+ * 不存在的ID对应 null 并列在 missing 中。记录文本原样写入响应，不再解析和重新序列化。
+ */
+void HttpServer::queryRecordsHandler(const rapidjson::Value &ids, const std::string &collection,
+                                     httplib::Response &res)
+{
+    // ids必须是非空的无符号整数数组，且数量不超过上限
+    if (!ids.IsArray() || ids.Empty() || ids.Size() > QUERY_MAX_IDS)
+    {
+        globalLogger->error("Invalid ids parameter in query request");
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid ids parameter in the request");
+        return;
+    }
+    std::vector<uint64_t> idList;
+    idList.reserve(ids.Size());
+    for (const auto &id : ids.GetArray())
+    {
+        if (!id.IsUint64())
+        {
+            globalLogger->error("Invalid id in query request");
+            res.status = 400;
+            setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Invalid ids parameter in the request");
+            return;
+        }
+        idList.push_back(id.GetUint64());
+    }
+
+    // 一次批量读取所有记录
+    std::vector<std::string> records = vectorDatabase->queryRecords(idList, collection);
+
+    size_t totalSize = 64;
+    for (const std::string &record : records)
+    {
+        totalSize += record.size() + 24;
+    }
+    rapidjson::StringBuffer buffer;
+    buffer.Reserve(totalSize);
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    // 按请求顺序写入记录，不存在的ID写入null
+    writer.StartObject();
+    writer.Key(RESPONSE_RESULTS);
+    writer.StartArray();
+    for (const std::string &record : records)
+    {
+        if (record.empty())
+        {
+            writer.Null();
+        }
+        else
+        {
+            writer.RawValue(record.data(), record.size(), rapidjson::kObjectType);
+        }
+    }
+    writer.EndArray();
+
+    // 单独列出不存在的ID，便于调用方处理
+    writer.Key(RESPONSE_MISSING);
+    writer.StartArray();
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].empty())
+        {
+            writer.Uint64(idList[i]);
+        }
+    }
+    writer.EndArray();
+    writer.Key(RESPONSE_RETCODE);
+    writer.Int(RESPONSE_RETCODE_SUCCESS);
+    writer.EndObject();
+
+    res.set_content(buffer.GetString(), buffer.GetSize(), RESPONSE_CONTENT_TYPE_JSON);
+}
+
 /**
  * @brief 处理快照请求
  * @param req HTTP请求对象
@@ -507,7 +1089,7 @@ void HttpServer::queryHandler(const httplib::Request &req, httplib::Response &re
 void HttpServer::snapshotHandler(const httplib::Request &req, httplib::Response &res)
 {
     // 打印接收到了快照请求
-    globalLogger->debug("Received snapshot request");
+    LOG_DEBUG("Received snapshot request");
 
     vectorDatabase->takeSnapshot();
 
@@ -517,4 +1099,455 @@ void HttpServer::snapshotHandler(const httplib::Request &req, httplib::Response
     rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
     jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
     setJsonResponse(jsonResponse, res);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 处理IVF训练请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ *
+ * 请求形如 {"collection": "docs", "sampleSize": 65536} 或 {"collection": "docs", "vectors": [[...], ...]}，
+ * 也可以用 centroids 直接上传已训练的聚类中心。训练得到的聚类中心写入WAL日志（见 VectorDatabase::trainIvf），
+ * 重启后恢复出与本次相同的索引
+ */
+void HttpServer::trainHandler(const httplib::Request &req, httplib::Response &res)
+{
+    LOG_DEBUG("Received train request");
+
+    ScopedRequestJson jsonScope;
+    RequestDocument &jsonRequest = parseRequestJson(req.body);
+    TrainRequest request;
+    std::string errorMsg;
+    if (decodeTrainRequest(jsonRequest, &request, &errorMsg))
+    {
+        size_t dim = 0;
+        if (request.numVectors > 0)
+        {
+            dim = request.vectors.size() / request.numVectors;
+        }
+        else if (request.numCentroids > 0)
+        {
+            dim = request.centroids.size() / request.numCentroids;
+        }
+        checkCollection(request.collection, dim, &errorMsg);
+    }
+    if (!errorMsg.empty())
+    {
+        globalLogger->error(errorMsg);
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+        return;
+    }
+
+    IVFTrainStats stats;
+    try
+    {
+        stats = vectorDatabase->trainIvf(request, true);
+    }
+    catch (const std::runtime_error &e)
+    {
+        globalLogger->error("IVF training failed: {}", e.what());
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, e.what());
+        return;
+    }
+
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    jsonResponse.AddMember(RESPONSE_SAMPLES, static_cast<uint64_t>(stats.samples), allocator);
+    jsonResponse.AddMember(RESPONSE_BUFFERED, static_cast<uint64_t>(stats.buffered), allocator);
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+}
+
+/**
+ * @brief 处理创建集合请求
+ * @param req HTTP请求对象，请求体为集合配置
+ * @param res HTTP响应对象
+ *
+ * 请求体形如 {"name": "docs", "dim": 768, "metric": "IP", "M": 32, "efConstruction": 200,
+ * "maxElements": 1000000, "nlist": 1024}，除name和dim外都是可选参数，metric 为 L2、IP 或 COSINE。集合已存在时返回400
+ */
+void HttpServer::createCollectionHandler(const httplib::Request &req, httplib::Response &res)
+{
+    LOG_DEBUG("Received create collection request");
+
+    ScopedRequestJson jsonScope;
+    RequestDocument &jsonRequest = parseRequestJson(req.body);
+    CollectionConfig config;
+    std::string errorMsg;
+    if (!decodeCollectionConfig(jsonRequest, &config, &errorMsg) ||
+        !vectorDatabase->createCollection(config, &errorMsg))
+    {
+        globalLogger->error(errorMsg);
+        res.status = 400;
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, errorMsg);
+        return;
+    }
+    globalLogger->info("Collection {} created by admin request", config.name);
+
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+}
+
+/**
+ * @brief 处理列出集合请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ *
+ * 返回每个集合的配置和各索引中的向量数量；默认集合只返回名称和向量数量
+ */
+void HttpServer::listCollectionsHandler(const httplib::Request &req, httplib::Response &res)
+{
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+
+    rapidjson::Value list(rapidjson::kArrayType);
+    for (const Collection *collection : vectorDatabase->getCollections())
+    {
+        rapidjson::Value item;
+        if (collection->isDefault())
+        {
+            item.SetObject();
+            item.AddMember(COLLECTION_NAME, rapidjson::StringRef(DEFAULT_COLLECTION_NAME), allocator);
+        }
+        else
+        {
+            encodeCollectionConfig(collection->getConfig(), &item, allocator);
+        }
+
+        IndexFactory *indexFactory = collection->getIndexFactory();
+        FaissIndex *faissIndex = static_cast<FaissIndex *>(indexFactory->getIndex(IndexFactory::IndexType::FLAT));
+        HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(indexFactory->getIndex(IndexFactory::IndexType::HNSW));
+        IVFIndex *ivfIndex = static_cast<IVFIndex *>(indexFactory->getIndex(IndexFactory::IndexType::IVF));
+        rapidjson::Value vectors(rapidjson::kObjectType);
+        if (faissIndex)
+        {
+            vectors.AddMember(INDEX_TYPE_FLAT, static_cast<uint64_t>(faissIndex->getVectorCount()), allocator);
+        }
+        if (hnswIndex)
+        {
+            vectors.AddMember(INDEX_TYPE_HNSW, static_cast<uint64_t>(hnswIndex->getVectorCount()), allocator);
+        }
+        if (ivfIndex)
+        {
+            vectors.AddMember(INDEX_TYPE_IVF, static_cast<uint64_t>(ivfIndex->getVectorCount()), allocator);
+        }
+        item.AddMember(RESPONSE_VECTORS, vectors.Move(), allocator);
+        list.PushBack(item.Move(), allocator);
+    }
+    jsonResponse.AddMember(RESPONSE_COLLECTIONS, list.Move(), allocator);
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+}
+
+/**
+ * @brief 检查请求的集合是否存在、向量维度是否与集合一致
+ * @param name 集合名
+ * @param dim 请求中（每个）向量的长度，为0时不检查维度
+ * @param errorMsg 输出参数，检查失败时的错误信息
+ * @return 检查通过返回true
+ */
+bool HttpServer::checkCollection(const std::string &name, size_t dim, std::string *errorMsg)
+{
+    Collection *collection = vectorDatabase->getCollection(name);
+    if (collection == nullptr)
+    {
+        *errorMsg = "Collection not found: " + name;
+        return false;
+    }
+    if (dim > 0 && !collection->acceptsDim(dim))
+    {
+        *errorMsg = "Vector dimension " + std::to_string(dim) + " does not match collection dim " +
+                    std::to_string(collection->getConfig().dim);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 在接口并发限制内执行请求处理函数
+ * @param path 接口路径
+ * @param res HTTP响应对象
+ * @param handler 请求处理函数
+ */
+void HttpServer::runWithConcurrencyLimit(const std::string &path, httplib::Response &res,
+                                         const std::function<void()> &handler)
+{
+    // 在返回（包括429拒绝和处理函数抛出异常）时记录请求数和处理延迟
+    struct Recorder
+    {
+        EndpointMetrics *metrics;
+        const httplib::Response &res;
+        std::chrono::steady_clock::time_point startTime;
+        ~Recorder()
+        {
+            // 未设置状态码时 httplib 返回200；抛出的异常由 httplib 转换为500
+            int status = std::uncaught_exceptions() > 0 ? 500 : (res.status < 0 ? 200 : res.status);
+            size_t statusClass = static_cast<size_t>(std::min(std::max(status / 100, 1), 5)) - 1;
+            metrics->responses[statusClass].add();
+            metrics->latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startTime).count()));
+        }
+    } recorder{endpointMetrics.at(path).get(), res, std::chrono::steady_clock::now()};
+
+    auto it = concurrencyLimiters.find(path);
+    if (it == concurrencyLimiters.end())
+    {
+        handler();
+        return;
+    }
+
+    ConcurrencyLimiter *limiter = it->second.get();
+    if (!limiter->tryAcquire())
+    {
+        globalLogger->warn("Rejected {} request: concurrency limit {} reached", path, limiter->getLimit());
+        res.status = RESPONSE_STATUS_TOO_MANY;
+        res.set_header("Retry-After", HTTP_RETRY_AFTER_SECONDS);
+        setErrorJsonResponse(res, RESPONSE_RETCODE_ERROR, "Too many concurrent requests, retry later");
+        return;
+    }
+
+    // 处理函数抛出异常时也要归还名额
+    struct Releaser
+    {
+        ConcurrencyLimiter *limiter;
+        ~Releaser() { limiter->release(); }
+    } releaser{limiter};
+    handler();
+}
+
+/**
+ * @brief 处理运行统计请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ */
+void HttpServer::statsHandler(const httplib::Request &req, httplib::Response &res)
+{
+    rapidjson::Document jsonResponse;
+    jsonResponse.SetObject();
+    rapidjson::Document::AllocatorType &allocator = jsonResponse.GetAllocator();
+
+    // 任务队列统计：排队等待时间单独统计，便于区分排队延迟和处理延迟
+    uint64_t executed = taskQueueStats.executed.load();
+    uint64_t totalWait = taskQueueStats.totalWaitMicros.load();
+    rapidjson::Value taskQueue(rapidjson::kObjectType);
+    taskQueue.AddMember("maxQueued", static_cast<uint64_t>(options.maxQueuedConnections), allocator);
+    taskQueue.AddMember("queued", static_cast<uint64_t>(taskQueueStats.queued.load()), allocator);
+    taskQueue.AddMember("active", static_cast<uint64_t>(taskQueueStats.active.load()), allocator);
+    taskQueue.AddMember("executed", executed, allocator);
+    taskQueue.AddMember("shed", taskQueueStats.shed.load(), allocator);
+    taskQueue.AddMember("maxShedQueued", static_cast<uint64_t>(options.maxShedConnections), allocator);
+    taskQueue.AddMember("shedQueued", static_cast<uint64_t>(taskQueueStats.shedQueued.load()), allocator);
+    taskQueue.AddMember("shedBlocked", taskQueueStats.shedBlocked.load(), allocator);
+    taskQueue.AddMember("queueWaitAvgMicros", executed > 0 ? totalWait / executed : 0, allocator);
+    taskQueue.AddMember("queueWaitMaxMicros", taskQueueStats.maxWaitMicros.load(), allocator);
+    jsonResponse.AddMember("taskQueue", taskQueue.Move(), allocator);
+
+    // 各接口的并发限制统计
+    rapidjson::Value endpoints(rapidjson::kObjectType);
+    for (const auto &entry : concurrencyLimiters)
+    {
+        rapidjson::Value endpoint(rapidjson::kObjectType);
+        endpoint.AddMember("limit", static_cast<uint64_t>(entry.second->getLimit()), allocator);
+        endpoint.AddMember("inFlight", static_cast<uint64_t>(entry.second->getInFlight()), allocator);
+        endpoint.AddMember("rejected", entry.second->getRejected(), allocator);
+        endpoints.AddMember(rapidjson::StringRef(entry.first.c_str()), endpoint.Move(), allocator);
+    }
+    jsonResponse.AddMember("endpoints", endpoints.Move(), allocator);
+
+    // 搜索结果缓存统计（仅在开启缓存时输出），用于评估缓存容量是否合适
+    const SearchCache *searchCache = vectorDatabase->getSearchCache();
+    if (searchCache)
+    {
+        rapidjson::Value cache(rapidjson::kObjectType);
+        cache.AddMember("maxBytes", static_cast<uint64_t>(searchCache->getMaxBytes()), allocator);
+        cache.AddMember("bytes", static_cast<uint64_t>(searchCache->getBytes()), allocator);
+        cache.AddMember("entries", static_cast<uint64_t>(searchCache->getEntries()), allocator);
+        cache.AddMember("hits", searchCache->getHits(), allocator);
+        cache.AddMember("staleHits", searchCache->getStaleHits(), allocator);
+        cache.AddMember("misses", searchCache->getMisses(), allocator);
+        cache.AddMember("evictions", searchCache->getEvictions(), allocator);
+        jsonResponse.AddMember("searchCache", cache.Move(), allocator);
+    }
+
+    // FLAT搜索合批统计（仅在开启合批时输出）
+    const SearchBatcher *searchBatcher = vectorDatabase->getSearchBatcher();
+    if (searchBatcher)
+    {
+        rapidjson::Value batcher(rapidjson::kObjectType);
+        batcher.AddMember("batches", searchBatcher->getBatches(), allocator);
+        batcher.AddMember("queries", searchBatcher->getBatchedQueries(), allocator);
+        jsonResponse.AddMember("searchBatcher", batcher.Move(), allocator);
+    }
+
+    jsonResponse.AddMember(RESPONSE_RETCODE, RESPONSE_RETCODE_SUCCESS, allocator);
+    setJsonResponse(jsonResponse, res);
+}
+
+/**
+ * @brief 处理 Prometheus 指标抓取请求
+ * @param req HTTP请求对象
+ * @param res HTTP响应对象
+ */
+void HttpServer::metricsHandler(const httplib::Request &req, httplib::Response &res)
+{
+    PrometheusWriter writer;
+
+    // 各接口的请求数和处理延迟：同名指标需要连续输出，因此按指标分多轮遍历接口
+    for (const auto &entry : endpointMetrics)
+    {
+        for (size_t i = 0; i < entry.second->responses.size(); i++)
+        {
+            uint64_t count = entry.second->responses[i].value();
+            if (count > 0)
+            {
+                writer.counter("vdb_http_requests_total", "HTTP requests by endpoint and status class.",
+                               "endpoint=\"" + entry.first + "\",code=\"" + std::to_string(i + 1) + "xx\"", count);
+            }
+        }
+    }
+    std::map<std::string, HistogramSnapshot> latencies;
+    for (const auto &entry : endpointMetrics)
+    {
+        latencies[entry.first] = entry.second->latency.snapshot();
+    }
+    for (const auto &entry : latencies)
+    {
+        writer.histogram("vdb_http_request_duration_seconds", "HTTP request handling time.",
+                         "endpoint=\"" + entry.first + "\"", entry.second);
+    }
+    for (const auto &entry : latencies)
+    {
+        writer.quantiles("vdb_http_request_latency_seconds",
+                         "HTTP request handling time quantiles (upper bound of the log bucket).",
+                         "endpoint=\"" + entry.first + "\"", entry.second);
+    }
+
+    // 并发限制拒绝的请求数
+    for (const auto &entry : concurrencyLimiters)
+    {
+        writer.counter("vdb_http_rejected_total", "Requests rejected with 429 by the endpoint concurrency limit.",
+                       "endpoint=\"" + entry.first + "\"", entry.second->getRejected());
+    }
+
+    // 任务队列
+    writer.gauge("vdb_task_queue_queued", "Connections waiting for a worker thread.", "",
+                 static_cast<double>(taskQueueStats.queued.load()));
+    writer.gauge("vdb_task_queue_active", "Connections being handled by worker threads.", "",
+                 static_cast<double>(taskQueueStats.active.load()));
+    HistogramSnapshot queueWait = taskQueueStats.waitLatency.snapshot();
+    writer.histogram("vdb_task_queue_wait_seconds", "Time connections waited for a worker thread.", "",
+                     queueWait);
+    writer.quantiles("vdb_task_queue_wait_latency_seconds",
+                     "Queue wait time quantiles (upper bound of the log bucket).", "", queueWait);
+    writer.counter("vdb_task_queue_shed_total", "Connections rejected with 503 because the queue was full.", "",
+                   taskQueueStats.shed.load());
+    writer.gauge("vdb_task_queue_shed_queued", "Connections waiting for a shed thread.", "",
+                 static_cast<double>(taskQueueStats.shedQueued.load()));
+    writer.counter("vdb_task_queue_shed_blocked_total",
+                   "Times the accept thread waited because the shed queue was full.", "",
+                   taskQueueStats.shedBlocked.load());
+
+    // 索引规模：同名指标需要连续输出，因此按指标分别遍历集合
+    std::vector<Collection *> collections = vectorDatabase->getCollections();
+    for (const Collection *collection : collections)
+    {
+        std::string labels = "collection=\"" + collection->getName() + "\",index=";
+        IndexFactory *indexFactory = collection->getIndexFactory();
+        FaissIndex *faissIndex = static_cast<FaissIndex *>(indexFactory->getIndex(IndexFactory::IndexType::FLAT));
+        HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(indexFactory->getIndex(IndexFactory::IndexType::HNSW));
+        IVFIndex *ivfIndex = static_cast<IVFIndex *>(indexFactory->getIndex(IndexFactory::IndexType::IVF));
+        if (faissIndex)
+        {
+            writer.gauge("vdb_index_vectors", "Vectors stored in the index.", labels + "\"" INDEX_TYPE_FLAT "\"",
+                         static_cast<double>(faissIndex->getVectorCount()));
+        }
+        if (hnswIndex)
+        {
+            writer.gauge("vdb_index_vectors", "Vectors stored in the index.", labels + "\"" INDEX_TYPE_HNSW "\"",
+                         static_cast<double>(hnswIndex->getVectorCount()));
+        }
+        if (ivfIndex)
+        {
+            writer.gauge("vdb_index_vectors", "Vectors stored in the index.", labels + "\"" INDEX_TYPE_IVF "\"",
+                         static_cast<double>(ivfIndex->getVectorCount()));
+        }
+    }
+    // HNSW 的容量、墓碑和后台重建，每个指标各遍历一轮集合
+    auto forEachHnswIndex = [&](const std::function<void(const std::string &, const HNSWLibIndex *)> &write)
+    {
+        for (const Collection *collection : collections)
+        {
+            HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(
+                collection->getIndexFactory()->getIndex(IndexFactory::IndexType::HNSW));
+            if (hnswIndex)
+            {
+                write("collection=\"" + collection->getName() + "\",index=\"" INDEX_TYPE_HNSW "\"", hnswIndex);
+            }
+        }
+    };
+    forEachHnswIndex([&](const std::string &labels, const HNSWLibIndex *hnswIndex)
+                     { writer.gauge("vdb_index_max_elements", "Capacity of the index.", labels,
+                                    static_cast<double>(hnswIndex->getMaxElements())); });
+    forEachHnswIndex([&](const std::string &labels, const HNSWLibIndex *hnswIndex)
+                     { writer.gauge("vdb_index_deleted_vectors", "Deleted vectors whose slots are not reused yet.",
+                                    labels, static_cast<double>(hnswIndex->getDeletedCount())); });
+    forEachHnswIndex([&](const std::string &labels, const HNSWLibIndex *hnswIndex)
+                     { writer.gauge("vdb_index_tombstone_ratio",
+                                    "Deletes and in-place updates since the last rebuild, per slot.",
+                                    labels, hnswIndex->getTombstoneRatio()); });
+    forEachHnswIndex([&](const std::string &labels, const HNSWLibIndex *hnswIndex)
+                     { writer.counter("vdb_index_rebuilds_total", "Background rebuilds of the index.",
+                                      labels, hnswIndex->getRebuildCount()); });
+
+    // WAL 和快照：上次快照之后的日志量决定了重启时需要重放的数据量
+    const Persistence &persistence = vectorDatabase->getPersistence();
+    writer.gauge("vdb_wal_bytes_since_snapshot", "WAL bytes written since the last snapshot.", "",
+                 static_cast<double>(persistence.getWALBytesSinceSnapshot()));
+    writer.gauge("vdb_wal_entries_since_snapshot", "WAL entries written since the last snapshot.", "",
+                 static_cast<double>(persistence.getWALEntriesSinceSnapshot()));
+    writer.histogram("vdb_snapshot_duration_seconds", "Time taken to write a snapshot.", "",
+                     persistence.getSnapshotDuration().snapshot());
+
+    // RocksDB 内部统计，属性名中的 "." 和 "-" 转换为 "_"
+    for (const auto &entry : vectorDatabase->getStorageStats())
+    {
+        std::string name = entry.first;
+        std::replace(name.begin(), name.end(), '.', '_');
+        std::replace(name.begin(), name.end(), '-', '_');
+        writer.gauge("vdb_" + name, "RocksDB property " + entry.first + ".", "", static_cast<double>(entry.second));
+    }
+
+    // 搜索结果缓存（仅在开启缓存时输出）
+    const SearchCache *searchCache = vectorDatabase->getSearchCache();
+    if (searchCache)
+    {
+        writer.gauge("vdb_search_cache_bytes", "Bytes used by the search result cache.", "",
+                     static_cast<double>(searchCache->getBytes()));
+        writer.gauge("vdb_search_cache_entries", "Entries in the search result cache.", "",
+                     static_cast<double>(searchCache->getEntries()));
+        writer.counter("vdb_search_cache_hits_total", "Search result cache hits.", "", searchCache->getHits());
+        writer.counter("vdb_search_cache_stale_hits_total", "Search result cache hits allowed by maxStalenessMs.", "",
+                       searchCache->getStaleHits());
+        writer.counter("vdb_search_cache_misses_total", "Search result cache misses.", "", searchCache->getMisses());
+        writer.counter("vdb_search_cache_evictions_total", "Search result cache evictions.", "",
+                       searchCache->getEvictions());
+    }
+
+    // FLAT搜索合批（仅在开启合批时输出）
+    const SearchBatcher *searchBatcher = vectorDatabase->getSearchBatcher();
+    if (searchBatcher)
+    {
+        writer.counter("vdb_search_batches_total", "Batched FLAT index searches.", "", searchBatcher->getBatches());
+        writer.counter("vdb_search_batched_queries_total", "Queries served by batched FLAT index searches.", "",
+                       searchBatcher->getBatchedQueries());
+    }
+
+    res.set_content(writer.str(), CONTENT_TYPE_PROMETHEUS);
+}
@@ -4,20 +4,55 @@
  * 
  * 该文件定义了HTTP服务器类，用于处理向量数据库的HTTP请求。
  * 主要功能包括：
- * 1. 处理向量的插入、更新、搜索和查询请求
+ * 1. 处理向量的插入、更新、删除、搜索和查询请求
  * 2. 验证请求参数的合法性
  * 3. 生成JSON格式的响应
+ * 4. 支持二进制请求格式（见 binary_protocol.h）
+ * 5. 以 Prometheus 文本格式输出运行指标（见 metrics.h）
+ * 6. 创建和列出命名集合（见 collection.h）
  */
 
 #pragma once
 
+#include "constants.h"
 #include "faiss_index.h"
 #include "vector_database.h"
 #include "httplib/httplib.h"
 #include "index_factory.h"
+#include "metrics.h"
 #include "rapidjson/document.h"
+#include "search_response.h"
+#include "server_task_queue.h"
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
 
+/**
+ * @struct HttpServerOptions
+ * @brief HTTP服务器的并发与降载配置
+ */
+struct HttpServerOptions
+{
+    size_t workerThreads = HTTP_WORKER_THREADS;                 ///< 工作线程数量，为0时使用 httplib 的默认值
+    size_t maxQueuedConnections = HTTP_MAX_QUEUED_CONNECTIONS;  ///< 等待工作线程的最大连接数，超出后返回503
+    size_t shedThreads = HTTP_SHED_THREADS;                     ///< 负责返回503的降载线程数量
+    size_t maxShedConnections = HTTP_MAX_SHED_CONNECTIONS;      ///< 等待降载线程的最大连接数，超出后暂停接受新连接
+    std::map<std::string, size_t> endpointConcurrencyLimits;    ///< 各接口同时处理的最大请求数，超出后返回429
+    uint64_t slowRequestThresholdMillis = SLOW_REQUEST_THRESHOLD_MS; ///< 搜索和更新请求超过该耗时时输出慢请求日志，为0时关闭
+};
+
+/**
+ * @struct EndpointMetrics
+ * @brief 单个接口的请求计数和处理延迟
+ */
+struct EndpointMetrics
+{
+    std::array<ShardedCounter, 5> responses; ///< 按状态码类别（1xx~5xx）统计的请求数
+    LatencyHistogram latency;                ///< 处理延迟（不含排队等待和分块发送的时间）
+};
+
 /**
  * @class HttpServer
  * @brief HTTP服务器类，处理向量数据库的HTTP请求
@@ -25,8 +60,17 @@
  * 该类使用cpp-httplib库实现HTTP服务器功能，提供以下接口：
  * - 向量插入（/insert）
  * - 向量更新（/upsert）
+ * - 向量批量更新（/bulk_upsert）
  * - 向量搜索（/search）
  * - 向量查询（/query）
+ * - 向量删除（/delete）
+ * - 运行统计（/admin/stats）
+ * - 集合管理（/admin/collections）
+ * - IVF索引训练（/admin/train）
+ * - Prometheus 指标（/metrics）
+ *
+ * 连接由可配置的有界任务队列处理（见 server_task_queue.h）：
+ * 队列已满时返回503，单个接口并发达到上限时返回429，过载时尽快拒绝而不是无限排队。
  */
 class HttpServer
 {
@@ -54,10 +98,12 @@ public:
      * @param host 服务器主机地址
      * @param port 服务器端口号
      * @param vectorDatabase 向量数据库实例指针
+     * @param options 并发与降载配置
      * 
      * 初始化HTTP服务器，设置监听地址和端口，并关联向量数据库实例
      */
-    HttpServer(const std::string &host, int port, VectorDatabase *vectorDatabase);
+    HttpServer(const std::string &host, int port, VectorDatabase *vectorDatabase,
+               const HttpServerOptions &options = HttpServerOptions());
 
     /**
      * @brief 启动HTTP服务器
@@ -76,6 +122,14 @@ private:
      */
     void searchHandler(const httplib::Request &req, httplib::Response &res);
 
+    /**
+     * @brief 组装随搜索结果返回的字段和命中向量
+     * @param request 搜索请求（includeFields、includeVector）
+     * @param ids 搜索结果中的ID，每个查询占k个位置
+     * @return 与结果位置一一对应的附加数据
+     */
+    SearchHitPayload buildHitPayload(const SearchRequest &request, const std::vector<long> &ids);
+
     /**
      * @brief 处理插入请求
      * @param req HTTP请求对象
@@ -94,15 +148,44 @@ private:
      */
     void upsertHandler(const httplib::Request &req, httplib::Response &res);
 
+    /**
+     * @brief 处理批量更新请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     * @param contentReader 请求体读取器
+     *
+     * 以NDJSON或JSON数组格式接收大量记录，按批次写入索引、标量存储和WAL日志
+     */
+    void bulkUpsertHandler(const httplib::Request &req, httplib::Response &res,
+                           const httplib::ContentReader &contentReader);
+
+    /**
+     * @brief 处理删除请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     *
+     * 删除指定ID的向量、过滤条件和记录
+     */
+    void deleteHandler(const httplib::Request &req, httplib::Response &res);
+
     /**
      * @brief 处理查询请求
      * @param req HTTP请求对象
      * @param res HTTP响应对象
      * 
-     * 处理向量查询请求，返回指定ID的向量信息
+     * 处理向量查询请求，返回指定ID的向量信息；请求带有 ids 列表时按列表批量查询
      */
     void queryHandler(const httplib::Request &req, httplib::Response &res);
 
+    /**
+     * @brief 批量查询多个ID的记录
+     * @param ids 请求中的ID列表
+     * @param collection 集合名
+     * @param res HTTP响应对象
+     */
+    void queryRecordsHandler(const rapidjson::Value &ids, const std::string &collection,
+                             httplib::Response &res);
+
     /**
      * @brief 处理快照请求
      * @param req HTTP请求对象
@@ -110,6 +193,71 @@ private:
      */
     void snapshotHandler(const httplib::Request &req, httplib::Response &res);
 
+    /**
+     * @brief 处理IVF训练请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     *
+     * 用上传的向量或从标量存储抽样的向量训练集合的IVF索引，成功后写入WAL日志
+     */
+    void trainHandler(const httplib::Request &req, httplib::Response &res);
+
+    /**
+     * @brief 处理创建集合请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     *
+     * 按请求体中的配置创建命名集合，集合配置持久化到标量存储
+     */
+    void createCollectionHandler(const httplib::Request &req, httplib::Response &res);
+
+    /**
+     * @brief 处理列出集合请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     */
+    void listCollectionsHandler(const httplib::Request &req, httplib::Response &res);
+
+    /**
+     * @brief 检查请求的集合是否存在、向量维度是否与集合一致
+     * @param name 集合名，为空时为默认集合
+     * @param dim 请求中（每个）向量的长度，为0时不检查维度
+     * @param errorMsg 输出参数，检查失败时的错误信息
+     * @return 检查通过返回true
+     */
+    bool checkCollection(const std::string &name, size_t dim, std::string *errorMsg);
+
+    /**
+     * @brief 处理运行统计请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     *
+     * 返回任务队列（排队深度、降载次数、排队等待时间）和各接口并发限制的统计
+     */
+    void statsHandler(const httplib::Request &req, httplib::Response &res);
+
+    /**
+     * @brief 处理 Prometheus 指标抓取请求
+     * @param req HTTP请求对象
+     * @param res HTTP响应对象
+     *
+     * 以 Prometheus 文本格式返回各接口的请求数和延迟分布、索引规模、WAL和快照、
+     * RocksDB、任务队列、搜索缓存和合批的指标。分片计数在抓取时合并，请求路径上没有锁
+     */
+    void metricsHandler(const httplib::Request &req, httplib::Response &res);
+
+    /**
+     * @brief 在接口并发限制内执行请求处理函数
+     * @param path 接口路径
+     * @param res HTTP响应对象
+     * @param handler 请求处理函数
+     *
+     * 接口没有配置并发上限时直接执行；已达上限时返回429，不执行处理函数。
+     * 无论是否被拒绝，都会记录该接口的请求数和处理延迟
+     */
+    void runWithConcurrencyLimit(const std::string &path, httplib::Response &res,
+                                 const std::function<void()> &handler);
+
     /**
      * @brief 设置JSON格式的响应
      * @param json_response JSON响应文档
@@ -137,19 +285,14 @@ private:
      * 
      * 根据不同的请求类型验证必要参数的存在性和格式
      */
-    bool isRequestValid(const rapidjson::Document &json_request, CheckType check_type);
-
-    /**
-     * @brief 从请求中获取索引类型
-     * @param json_request JSON请求文档
-     * @return IndexFactory::IndexType 索引类型
-     * 
-     * 解析请求中的索引类型参数，返回对应的索引类型枚举值
-     */
-    IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Document &json_request);
+    bool isRequestValid(const rapidjson::Value &json_request, CheckType check_type);
 
     httplib::Server server;           ///< HTTP服务器实例
     std::string host;                 ///< 服务器主机地址
     int port;                         ///< 服务器端口号
     VectorDatabase *vectorDatabase;   ///< 向量数据库实例指针
+    HttpServerOptions options;        ///< 并发与降载配置
+    TaskQueueStats taskQueueStats;    ///< 任务队列运行统计
+    std::map<std::string, std::unique_ptr<ConcurrencyLimiter>> concurrencyLimiters; ///< 各接口的并发限制，构造后不再修改
+    std::map<std::string, std::unique_ptr<EndpointMetrics>> endpointMetrics; ///< 各接口的运行指标，构造后不再修改
 };
\ No newline at end of file
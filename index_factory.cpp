@@ -1,5 +1,6 @@
 #include "index_factory.h"
 #include "hnswlib_index.h"
+#include "ivf_index.h"
 #include "faiss/IndexFlat.h"
 #include "faiss/IndexIDMap.h"
 #include "filter_index.h"
@@ -23,18 +24,24 @@ IndexFactory *getGlobalIndexFactory()
 /**
  * @brief 初始化向量索引
  *
- * @param type 索引类型，当前支持FLAT、HNSW 类型索引
+ * @param type 索引类型，当前支持FLAT、HNSW、IVF 类型索引
  * @param dim 向量维度
  * @param numData 索引能容纳的最大向量数量
  * @param metric 距离度量方式（默认L2欧氏距离）
+ * @param M HNSW索引节点的最大近邻数
+ * @param efConstruction HNSW构建索引时的候选邻居数
+ * @param nlist IVF索引的倒排列表数量
  *
  * @note 此函数会根据指定的索引类型、维度和度量方式创建相应的FAISS索引
  */
-void IndexFactory::init(IndexType type, int dim, int numData, MetricType metric)
+void IndexFactory::init(IndexType type, int dim, int numData, MetricType metric,
+                        int M, int efConstruction, int nlist)
 {
     // 根据传入的度量类型参数，确定FAISS索引使用的哪种度量方式
-    // 因为FAISS的度量方式和我们的度量方式不一致，所以需要转换
+    // 因为FAISS的度量方式和我们的度量方式不一致，所以需要转换：
+    // 余弦相似度在FAISS中是归一化向量上的内积，归一化由 FaissIndex 完成
     faiss::MetricType faiss_metric = (metric == MetricType::L2) ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT;
+    bool cosine = metric == MetricType::COSINE;
 
     // 根据索引类型创建相应的索引实例
     switch (type)
@@ -45,13 +52,13 @@ void IndexFactory::init(IndexType type, int dim, int numData, MetricType metric)
         // 2. 用IndexIDMap包装，以支持自定义ID映射
         // 3. 用FaissIndex进一步包装，适配我们系统的接口
         // 4. 存入索引映射表，以便后续通过类型访问
-        indexMap[type] = new FaissIndex(new faiss::IndexIDMap(new faiss::IndexFlat(dim, faiss_metric)));
+        indexMap[type] = new FaissIndex(new faiss::IndexIDMap(new faiss::IndexFlat(dim, faiss_metric)), cosine);
         break;
     case IndexType::HNSW:
         // 创建一个HNSW索引
         // 1. 创建HNSWLibIndex对象
         // 2. 存入索引映射表，以便后续通过类型访问
-        indexMap[type] = new HNSWLibIndex(dim, numData, metric, 16, 200);
+        indexMap[type] = new HNSWLibIndex(dim, numData, metric, M, efConstruction);
         break;
     case IndexType::FILTER:
         // 创建一个过滤索引
@@ -59,6 +66,10 @@ void IndexFactory::init(IndexType type, int dim, int numData, MetricType metric)
         // 2. 存入索引映射表，以便后续通过类型访问
         indexMap[type] = new FilterIndex();
         break;
+    case IndexType::IVF:
+        // 创建一个IVF索引，训练之前写入的向量暂存在扁平缓冲区中
+        indexMap[type] = new IVFIndex(dim, metric, static_cast<size_t>(nlist));
+        break;
     case IndexType::UNKNOWN:
     default:
         // 未知索引类型不做处理
@@ -108,7 +119,7 @@ void IndexFactory::saveIndex(const std::string &folderPath, ScalarStorage &scala
             return;
         }
     }
-    globalLogger->debug("Snapshot directory {} ensured", folderPath);
+    LOG_DEBUG("Snapshot directory {} ensured", folderPath);
 
     // 遍历所有已创建的索引
     for (const auto &indexEntry : indexMap)
@@ -121,7 +132,7 @@ void IndexFactory::saveIndex(const std::string &folderPath, ScalarStorage &scala
                                std::to_string(static_cast<int>(type)) +
                                ".index";
 
-        globalLogger->debug("Saving index type {} to file {}", static_cast<int>(type), fileName);
+        LOG_DEBUG("Saving index type {} to file {}", static_cast<int>(type), fileName);
 
         // 根据索引类型调用相应的 saveIndex 方法
         switch (type)
@@ -138,6 +149,10 @@ void IndexFactory::saveIndex(const std::string &folderPath, ScalarStorage &scala
             // 将void*指针转换为FilterIndex*并调用saveIndex，需要传入ScalarStorage
             static_cast<FilterIndex *>(index)->saveIndex(scalarStorage,fileName);
             break;
+        case IndexType::IVF:
+            // 训练之后保存 IndexIVFFlat，训练之前保存缓冲区
+            static_cast<IVFIndex *>(index)->saveIndex(fileName);
+            break;
         case IndexType::UNKNOWN:
         default:
             // 未知或默认类型，跳过保存
@@ -183,6 +198,10 @@ void IndexFactory::loadIndex(const std::string& folderPath, ScalarStorage &scala
             // 将void*指针转换为FilterIndex*并调用loadIndex，需要传入ScalarStorage
             static_cast<FilterIndex *>(index)->loadIndex(scalarStorage,fileName);
             break;
+        case IndexType::IVF:
+            // 将void*指针转换为IVFIndex*并调用loadIndex
+            static_cast<IVFIndex *>(index)->loadIndex(fileName);
+            break;
         case IndexType::UNKNOWN:
         default:
             // 未知或默认类型，跳过加载
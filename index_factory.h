@@ -8,6 +8,7 @@
 #pragma once
 
 #include <map>
+#include "constants.h"
 #include "faiss_index.h"
 #include "scalar_storage.h"
 
@@ -22,6 +23,7 @@ public:
         FLAT,        ///< 扁平索引
         HNSW,        ///< HNSW索引
         FILTER,      ///< 过滤索引
+        IVF,         ///< IVF索引（倒排列表，需要训练）
         UNKNOWN = -1 ///< 未知索引类型
     };
 
@@ -42,8 +44,13 @@ public:
      * @param dim 向量维度
      * @param numData 索引能容纳的最大向量数量
      * @param metric 距离度量类型，默认为L2距离
+     * @param M HNSW索引节点的最大近邻数
+     * @param efConstruction HNSW构建索引时的候选邻居数
+     * @param nlist IVF索引的倒排列表数量
      */
-    void init(IndexType type, int dim = 1, int numData = 0, MetricType metric = MetricType::L2);
+    void init(IndexType type, int dim = 1, int numData = 0, MetricType metric = MetricType::L2,
+              int M = HNSW_DEFAULT_M, int efConstruction = HNSW_DEFAULT_EF_CONSTRUCTION,
+              int nlist = IVF_DEFAULT_NLIST);
 
     /**
      * @brief 获取指定类型的索引实例
@@ -0,0 +1,339 @@
+#include "ivf_index.h"
+#include "logger.h"
+#include "faiss/IndexFlat.h"
+#include "faiss/IndexIDMap.h"
+#include "faiss/index_io.h"
+#include "faiss/utils/distances.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+/**
+ * @brief 构造函数
+ * @param dim 向量维度
+ * @param metric 距离度量类型
+ * @param nlist 倒排列表数量
+ *
+ * 训练之前只创建缓冲区，IVF索引在训练时创建
+ */
+IVFIndex::IVFIndex(int dim, IndexFactory::MetricType metric, size_t nlist)
+    : dim(dim),
+      metricType(metric == IndexFactory::MetricType::L2 ? faiss::METRIC_L2 : faiss::METRIC_INNER_PRODUCT),
+      cosine(metric == IndexFactory::MetricType::COSINE), nlist(nlist)
+{
+    // 训练完成后缓冲区被释放，IndexIDMap 需要一并释放其中的 IndexFlat
+    faiss::IndexIDMap *bufferIndex = new faiss::IndexIDMap(new faiss::IndexFlat(dim, metricType));
+    bufferIndex->own_fields = true;
+    buffer.reset(new FaissIndex(bufferIndex, cosine));
+}
+
+/**
+ * @brief 析构函数
+ */
+IVFIndex::~IVFIndex()
+{
+    delete index;
+}
+
+/**
+ * @brief 按余弦相似度搜索时，返回归一化后的向量
+ * @param data 向量数据
+ * @param buffer 存放归一化结果的缓冲区
+ * @return 归一化后的向量
+ */
+const std::vector<float> &IVFIndex::prepareVectors(const std::vector<float> &data,
+                                                   std::vector<float> *buffer) const
+{
+    if (!cosine)
+    {
+        return data;
+    }
+    *buffer = data;
+    faiss::fvec_renorm_L2(dim, buffer->size() / dim, buffer->data());
+    return *buffer;
+}
+
+/**
+ * @brief 批量写入向量，已存在的ID被替换
+ * @param data 向量数据
+ * @param labels 每个向量对应的ID
+ *
+ * 聚类中心训练后不再变化，到聚类中心的距离在共享锁内计算；
+ * 之后取得独占锁时索引已被替换（加载）的话重新计算
+ */
+void IVFIndex::upsertVectors(const std::vector<float> &data, const std::vector<long> &labels)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+    std::vector<float> normalized;
+    std::vector<faiss::idx_t> assignments(labels.size());
+    faiss::IndexIVFFlat *assignedIndex = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (!index)
+        {
+            // 缓冲区自己负责归一化和并发控制；训练完成前的切换需要独占锁，因此不会丢失这次写入
+            buffer->upsertVectors(data, labels);
+            return;
+        }
+        const std::vector<float> &vectors = prepareVectors(data, &normalized);
+        index->quantizer->assign(labels.size(), vectors.data(), assignments.data());
+        assignedIndex = index;
+    }
+
+    const float *vectors = cosine ? normalized.data() : data.data();
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (index != assignedIndex)
+    {
+        index->quantizer->assign(labels.size(), vectors, assignments.data());
+    }
+    // 哈希表形式的 DirectMap 只支持按ID数组删除
+    faiss::IDSelectorArray oldVectors(labels.size(), labels.data());
+    index->remove_ids(oldVectors);
+    index->add_core(labels.size(), vectors, labels.data(), assignments.data());
+}
+
+/**
+ * @brief 删除指定ID的向量
+ * @param ids 要删除的向量ID列表
+ */
+void IVFIndex::removeVectors(const std::vector<long> &ids)
+{
+    if (ids.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!index)
+    {
+        buffer->removeVectors(ids);
+        return;
+    }
+    faiss::IDSelectorArray selector(ids.size(), ids.data());
+    index->remove_ids(selector);
+}
+
+/**
+ * @brief 用一批样本训练聚类中心
+ * @param samples 训练样本
+ * @return 聚类中心
+ */
+std::vector<float> IVFIndex::trainCentroids(const std::vector<float> &samples) const
+{
+    if (isTrained())
+    {
+        throw std::runtime_error("IVF index is already trained");
+    }
+    if (samples.size() % dim != 0)
+    {
+        throw std::runtime_error("IVF training samples do not match index dim " + std::to_string(dim));
+    }
+    size_t count = samples.size() / dim;
+    if (count < nlist)
+    {
+        throw std::runtime_error("IVF training needs at least " + std::to_string(nlist) +
+                                 " vectors, got " + std::to_string(count));
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // k-means 在临时的量化器上进行，不持有锁
+    std::vector<float> normalized;
+    const std::vector<float> &vectors = prepareVectors(samples, &normalized);
+    faiss::IndexFlat quantizer(dim, metricType);
+    faiss::IndexIVFFlat trained(&quantizer, dim, nlist, metricType);
+    trained.train(count, vectors.data());
+
+    std::vector<float> centroids(nlist * dim);
+    quantizer.reconstruct_n(0, nlist, centroids.data());
+    globalLogger->info("IVF centroids trained: nlist = {}, samples = {}, {:.1f} seconds", nlist, count,
+                       std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    return centroids;
+}
+
+/**
+ * @brief 使用给定的聚类中心创建IVF索引，并把缓冲区中的向量移入索引
+ * @param centroids 聚类中心
+ * @return 训练统计
+ */
+IVFTrainStats IVFIndex::applyCentroids(const std::vector<float> &centroids)
+{
+    if (centroids.size() != nlist * dim)
+    {
+        throw std::runtime_error("IVF index expects " + std::to_string(nlist) + " centroids of dim " +
+                                 std::to_string(dim));
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    IVFTrainStats stats;
+
+    // 聚类中心直接写入量化器，IndexIVFFlat 不需要其他训练
+    std::unique_ptr<faiss::IndexIVFFlat> trained(
+        new faiss::IndexIVFFlat(new faiss::IndexFlat(dim, metricType), dim, nlist, metricType));
+    trained->own_fields = true;
+    trained->set_direct_map_type(faiss::DirectMap::Hashtable);
+    trained->quantizer->add(nlist, centroids.data());
+    trained->is_trained = true;
+
+    // 缓冲区中的向量已经归一化，直接写入
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (index)
+    {
+        throw std::runtime_error("IVF index is already trained");
+    }
+    std::vector<float> bufferedData;
+    std::vector<long> bufferedLabels;
+    buffer->getVectors(&bufferedData, &bufferedLabels);
+    if (!bufferedLabels.empty())
+    {
+        trained->add_with_ids(bufferedLabels.size(), bufferedData.data(), bufferedLabels.data());
+    }
+    index = trained.release();
+    buffer.reset();
+    lock.unlock();
+
+    stats.buffered = bufferedLabels.size();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    globalLogger->info("IVF index trained: nlist = {}, buffered = {}, {:.1f} seconds",
+                       nlist, stats.buffered, stats.seconds);
+    return stats;
+}
+
+/**
+ * @brief 查询与输入向量最近邻的k个向量
+ * @param query 查询向量数据
+ * @param k 每个查询返回的最近邻数量
+ * @param bitmap 可选的ID过滤位图
+ * @param nprobe 探测的倒排列表数量
+ * @param deadline 截止时间
+ * @param partial 可选的输出参数
+ * @return 返回搜索结果
+ */
+std::pair<std::vector<long>, std::vector<float>> IVFIndex::searchVectors(
+    const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap, size_t nprobe,
+    std::chrono::steady_clock::time_point deadline, bool *partial)
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (!index)
+    {
+        return buffer->searchVectors(query, k, bitmap, deadline, partial);
+    }
+
+    size_t numQueries = query.size() / dim;
+    std::vector<long> indices(numQueries * k);
+    std::vector<float> distances(numQueries * k);
+    std::vector<float> normalizedQuery;
+    const std::vector<float> &searchQuery = prepareVectors(query, &normalizedQuery);
+
+    faiss::SearchParametersIVF searchParams;
+    searchParams.nprobe = std::max<size_t>(1, std::min(nprobe, index->nlist));
+    RoaringBitmapIDSelector idSelector(bitmap);
+    if (bitmap != nullptr)
+    {
+        searchParams.sel = &idSelector;
+    }
+    index->search(numQueries, searchQuery.data(), k, distances.data(), indices.data(), &searchParams);
+
+    if (cosine)
+    {
+        FaissIndex::toCosineDistances(indices, &distances);
+    }
+    return {indices, distances};
+}
+
+/**
+ * @brief 保存索引到文件
+ * @param filePath 保存路径
+ */
+void IVFIndex::saveIndex(const std::string &filePath) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (index)
+    {
+        faiss::write_index(index, filePath.c_str());
+    }
+    else
+    {
+        buffer->saveIndex(filePath);
+    }
+}
+
+/**
+ * @brief 从文件加载索引
+ * @param filePath 加载路径
+ *
+ * 文件中是 IndexIVFFlat 时恢复为已训练的索引，是 IndexIDMap 时恢复为训练之前的缓冲区
+ */
+void IVFIndex::loadIndex(const std::string &filePath)
+{
+    std::ifstream file(filePath);
+    if (!file.good())
+    {
+        globalLogger->warn("IVF index file not found: {}. Skipping load IVF index.", filePath);
+        return;
+    }
+    file.close();
+
+    faiss::Index *loaded = faiss::read_index(filePath.c_str());
+    if (loaded->d != dim)
+    {
+        globalLogger->error("IVF index file {} has dim {}, expected {}. Skipping load IVF index.",
+                            filePath, loaded->d, dim);
+        delete loaded;
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (faiss::IndexIVFFlat *ivf = dynamic_cast<faiss::IndexIVFFlat *>(loaded))
+    {
+        // 删除和替换依赖哈希表形式的 DirectMap，与保存时的类型相同时不会重建
+        ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+        delete index;
+        index = ivf;
+        nlist = ivf->nlist;
+        buffer.reset();
+    }
+    else if (dynamic_cast<faiss::IndexIDMap *>(loaded))
+    {
+        delete index;
+        index = nullptr;
+        buffer.reset(new FaissIndex(loaded, cosine));
+    }
+    else
+    {
+        globalLogger->error("IVF index file {} has an unexpected index type. Skipping load IVF index.", filePath);
+        delete loaded;
+    }
+}
+
+/**
+ * @brief 是否已完成训练
+ * @return 已训练返回true
+ */
+bool IVFIndex::isTrained() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return index != nullptr;
+}
+
+/**
+ * @brief 获取倒排列表数量
+ * @return 倒排列表数量
+ */
+size_t IVFIndex::getNlist() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return nlist;
+}
+
+/**
+ * @brief 获取索引中的向量数量
+ * @return 向量数量
+ */
+size_t IVFIndex::getVectorCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return index ? static_cast<size_t>(index->ntotal) : buffer->getVectorCount();
+}
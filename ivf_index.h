@@ -0,0 +1,174 @@
+#pragma once
+
+#include "constants.h"
+#include "faiss_index.h"
+#include "index_factory.h"
+#include "faiss/IndexIVFFlat.h"
+#include "roaring/roaring.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct IVFTrainStats
+ * @brief 一次训练的统计
+ */
+struct IVFTrainStats
+{
+    size_t samples = 0;   ///< 训练使用的样本数
+    size_t buffered = 0;  ///< 训练完成后从缓冲区移入索引的向量数
+    double seconds = 0;   ///< 耗时（秒），包括训练和移入缓冲区的向量
+};
+
+/**
+ * @brief IVF索引类，基于 faiss::IndexIVFFlat 的倒排索引
+ *
+ * 向量按最近的聚类中心分配到 nlist 个倒排列表中，搜索时只扫描离查询最近的 nprobe 个列表，
+ * nprobe 由每个请求指定，在延迟和召回率之间取舍。与HNSW相比构建时不需要维护图，
+ * 写入只需计算到各聚类中心的距离，适合规模很大的集合。
+ *
+ * 聚类中心需要先用一批样本训练（k-means）。训练之前写入的向量暂存在一个扁平索引（FaissIndex）中，
+ * 搜索时对其暴力扫描；训练完成后缓冲区中的向量一次移入IVF索引。训练只进行一次。
+ * 训练分为计算聚类中心（trainCentroids）和切换索引（applyCentroids）两步，
+ * 调用方可以把聚类中心记录下来，之后只执行第二步恢复出相同的索引。
+ *
+ * 搜索持有共享锁，写入、删除、训练完成后的切换和加载持有独占锁。写入时到聚类中心的距离在共享锁内计算，
+ * 独占锁只覆盖追加到倒排列表的部分。索引使用哈希表形式的 DirectMap，删除和替换已有ID不需要扫描倒排列表。
+ *
+ * 过滤条件通过 SearchParametersIVF 的 sel 交给 faiss，扫描倒排列表时跳过位图之外的ID。
+ * 余弦相似度与FLAT索引一致：使用内积度量，写入和查询的向量各归一化一次，结果转换为余弦距离。
+ */
+class IVFIndex
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param dim 向量维度
+     * @param metric 距离度量类型
+     * @param nlist 倒排列表（聚类中心）数量
+     */
+    IVFIndex(int dim, IndexFactory::MetricType metric, size_t nlist = IVF_DEFAULT_NLIST);
+
+    /**
+     * @brief 析构函数
+     */
+    ~IVFIndex();
+
+    IVFIndex(const IVFIndex &) = delete;
+    IVFIndex &operator=(const IVFIndex &) = delete;
+
+    /**
+     * @brief 批量写入向量，已存在的ID被替换
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param labels 每个向量对应的ID，同一批内不应重复
+     *
+     * 训练之前写入缓冲区；训练之后在一次独占锁内先删除旧向量再写入，搜索不会看到向量缺失的中间状态
+     */
+    void upsertVectors(const std::vector<float> &data, const std::vector<long> &labels);
+
+    /**
+     * @brief 删除指定ID的向量
+     * @param ids 要删除的向量ID列表
+     */
+    void removeVectors(const std::vector<long> &ids);
+
+    /**
+     * @brief 用一批样本训练聚类中心（k-means），不修改索引
+     * @param samples 训练样本（多个向量按维度依次拼接）
+     * @return nlist 个聚类中心，按维度依次拼接；余弦相似度索引的中心位于归一化后的空间
+     * @throws std::runtime_error 索引已训练、样本数少于 nlist 或样本长度不是维度的整数倍时抛出
+     *
+     * 训练不持有锁，期间写入和搜索照常使用缓冲区
+     */
+    std::vector<float> trainCentroids(const std::vector<float> &samples) const;
+
+    /**
+     * @brief 使用给定的聚类中心创建IVF索引，并把缓冲区中的向量移入索引
+     * @param centroids nlist 个聚类中心（trainCentroids 的结果）
+     * @return 训练统计（samples 为0）
+     * @throws std::runtime_error 索引已训练或聚类中心的数量、维度不一致时抛出
+     *
+     * 只有移入缓冲区中的向量和切换索引时持有独占锁，因此应在写入大量数据之前训练。
+     * 相同的聚类中心和缓冲区得到相同的索引，重放WAL日志时据此恢复训练结果
+     */
+    IVFTrainStats applyCentroids(const std::vector<float> &centroids);
+
+    /**
+     * @brief 查询与输入向量最近邻的k个向量
+     * @param query 查询向量数据（可包含多个查询向量）
+     * @param k 每个查询返回的最近邻数量
+     * @param bitmap 可选的ID过滤位图
+     * @param nprobe 探测的倒排列表数量，超过 nlist 时按 nlist 处理
+     * @param deadline 截止时间，只在训练之前扫描缓冲区时生效
+     * @param partial 可选的输出参数，截止时间前未扫描完缓冲区时置为true
+     * @return 返回一个 pair，第一个为匹配向量的ID数组，第二个为对应的距离数组
+     *
+     * 训练之后每个查询的代价由 nprobe 决定，不再检查截止时间
+     */
+    std::pair<std::vector<long>, std::vector<float>> searchVectors(
+        const std::vector<float> &query, int k, const roaring_bitmap_t *bitmap, size_t nprobe,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+        bool *partial = nullptr);
+
+    /**
+     * @brief 保存索引到文件
+     * @param filePath 保存路径
+     *
+     * 训练之后保存 IndexIVFFlat（包括聚类中心）；训练之前保存缓冲区的扁平索引
+     */
+    void saveIndex(const std::string &filePath) const;
+
+    /**
+     * @brief 从文件加载索引
+     * @param filePath 加载路径
+     *
+     * 按文件中的索引类型恢复为已训练的IVF索引或训练之前的缓冲区
+     */
+    void loadIndex(const std::string &filePath);
+
+    /**
+     * @brief 是否已完成训练
+     * @return 已训练返回true
+     */
+    bool isTrained() const;
+
+    /**
+     * @brief 获取倒排列表数量
+     * @return 倒排列表数量
+     */
+    size_t getNlist() const;
+
+    /**
+     * @brief 获取索引的向量维度
+     * @return 向量维度
+     */
+    int getDim() const { return dim; }
+
+    /**
+     * @brief 获取索引中的向量数量，训练之前为缓冲区中的向量数量
+     * @return 向量数量
+     */
+    size_t getVectorCount() const;
+
+private:
+    /**
+     * @brief 按余弦相似度搜索时，返回归一化后的向量
+     * @param data 向量数据（多个向量按维度依次拼接）
+     * @param buffer 存放归一化结果的缓冲区
+     * @return 不是余弦相似度索引时返回data本身，否则返回buffer
+     */
+    const std::vector<float> &prepareVectors(const std::vector<float> &data, std::vector<float> *buffer) const;
+
+    int dim;                       ///< 向量维度
+    faiss::MetricType metricType;  ///< faiss 的距离度量，余弦相似度为内积
+    bool cosine;                   ///< 是否为余弦相似度索引
+    size_t nlist;                  ///< 倒排列表数量，加载已训练的索引时以文件为准
+
+    faiss::IndexIVFFlat *index = nullptr;  ///< 训练完成的IVF索引，训练之前为空
+    std::unique_ptr<FaissIndex> buffer;    ///< 训练之前写入的向量，训练完成后为空
+
+    mutable std::shared_mutex mutex;  ///< 读写锁：搜索持有共享锁，写入倒排列表、删除、切换和加载持有独占锁
+};
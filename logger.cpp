@@ -5,7 +5,10 @@
  */
 
 #include "logger.h"
+#include "constants.h"
+#include <atomic>
 #include <iostream>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/basic_file_sink.h>
@@ -15,10 +18,12 @@ std::shared_ptr<spdlog::logger> globalLogger;
 
 void initGlobalLogger() {
     try {
-        // 创建支持彩色输出的控制台日志记录器
+        // 创建支持彩色输出的异步控制台日志记录器
         // 参数"amongvdb"是日志记录器的名称
-        // stdout_color_mt表示创建一个线程安全的、支持彩色输出的日志记录器
-        globalLogger = spdlog::stdout_color_mt("amongvdb");
+        // 日志消息先进入有界队列，由一个后台线程输出到控制台；
+        // 队列满时覆盖最旧的消息，请求线程永远不会因为写日志而阻塞
+        spdlog::init_thread_pool(LOG_ASYNC_QUEUE_SIZE, 1);
+        globalLogger = spdlog::create_async_nb<spdlog::sinks::stdout_color_sink_mt>("amongvdb");
         
         // 设置日志输出格式
         // %Y-%m-%d %H:%M:%S.%e: 时间戳，精确到毫秒
@@ -27,9 +32,12 @@ void initGlobalLogger() {
         // %v: 实际的日志消息
         globalLogger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%t] %v");
         
-        // 设置默认日志级别为debug
+        // 设置默认日志级别为info
         // 需要更改时再手动设置
-        globalLogger->set_level(spdlog::level::debug);
+        globalLogger->set_level(spdlog::level::info);
+
+        // 错误日志立即刷新，避免进程异常退出时丢失
+        globalLogger->flush_on(spdlog::level::err);
         
         // 输出初始化成功信息
         globalLogger->info("日志系统初始化成功");
@@ -61,4 +69,24 @@ void setLogLevel(spdlog::level::level_enum level) {
         // 输出日志级别变更信息
         globalLogger->info("日志级别已设置为: {}", spdlog::level::to_string_view(level));
     }
-}
\ No newline at end of file
+}
+
+void logRequestBody(const char *endpoint, std::string_view body) {
+    if (!globalLogger || !globalLogger->should_log(spdlog::level::info)) {
+        return;
+    }
+
+    // 按固定间隔采样
+    static std::atomic<uint64_t> requestCount{0};
+    if (requestCount.fetch_add(1) % REQUEST_LOG_SAMPLE_RATE != 0) {
+        return;
+    }
+
+    // 超过上限的请求体只记录开头部分
+    if (body.size() > REQUEST_LOG_MAX_BYTES) {
+        globalLogger->info("{} request parameters ({} bytes, truncated): {}",
+                           endpoint, body.size(), body.substr(0, REQUEST_LOG_MAX_BYTES));
+    } else {
+        globalLogger->info("{} request parameters: {}", endpoint, body);
+    }
+}
@@ -6,7 +6,14 @@
 
 #pragma once
 
+// 编译期日志级别：低于该级别的 LOG_TRACE/LOG_DEBUG 调用在编译时整体移除（参数也不会求值）。
+// 默认只保留info及以上，调试构建可通过 make LOG_LEVEL=SPDLOG_LEVEL_DEBUG 打开
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#endif
+
 #include "spdlog/spdlog.h"
+#include <string_view>
 
 /**
  * @brief 全局日志记录器指针
@@ -15,13 +22,31 @@
  */
 extern std::shared_ptr<spdlog::logger> globalLogger;
 
+/**
+ * @brief 热路径上使用的日志宏
+ * @details 级别低于 SPDLOG_ACTIVE_LEVEL 时展开为空语句，没有任何运行时开销
+ */
+#define LOG_TRACE(...) SPDLOG_LOGGER_TRACE(globalLogger, __VA_ARGS__)
+#define LOG_DEBUG(...) SPDLOG_LOGGER_DEBUG(globalLogger, __VA_ARGS__)
+
 /**
  * @brief 初始化全局日志记录器
- * @details 创建并配置全局日志记录器，设置输出格式和默认日志级别
+ * @details 创建并配置全局日志记录器，设置输出格式和默认日志级别。
+ *          日志记录器是异步的：格式化后的消息进入有界队列，由后台线程写出，
+ *          队列满时丢弃最旧的消息而不是阻塞请求线程
  * @note 应该在程序启动时调用此函数
  */
 void initGlobalLogger();
 
+/**
+ * @brief 以info级别记录请求体
+ * @param endpoint 接口名称
+ * @param body 请求体
+ * @details 每 REQUEST_LOG_SAMPLE_RATE 个请求只记录一个，且最多记录 REQUEST_LOG_MAX_BYTES 字节，
+ *          避免大请求体或高QPS时日志格式化和输出占用请求处理时间
+ */
+void logRequestBody(const char *endpoint, std::string_view body);
+
 /**
  * @brief 设置日志级别
  * @param level 要设置的日志级别
@@ -0,0 +1,258 @@
+/**
+ * @file metrics.cpp
+ * @brief 运行指标实现文件
+ */
+
+#include "metrics.h"
+#include "spdlog/fmt/fmt.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /**
+     * @brief 获取当前线程使用的分片下标
+     * @return 分片下标
+     *
+     * 线程第一次更新指标时按顺序分配分片，之后一直使用同一个分片
+     */
+    size_t currentShard()
+    {
+        static std::atomic<size_t> nextShard{0};
+        thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+        return shard;
+    }
+
+    /**
+     * @brief 把微秒转换为以秒为单位的文本
+     * @param micros 微秒数
+     * @return 文本
+     */
+    std::string formatSeconds(uint64_t micros)
+    {
+        return fmt::format("{}", static_cast<double>(micros) / 1e6);
+    }
+}
+
+/**
+ * @brief 增加计数
+ * @param n 增加的数量
+ */
+void ShardedCounter::add(uint64_t n)
+{
+    shards[currentShard()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 合并所有分片，获取当前计数
+ * @return 计数值
+ */
+uint64_t ShardedCounter::value() const
+{
+    uint64_t total = 0;
+    for (const Shard &shard : shards)
+    {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * @brief 获取样本值对应的桶下标
+ * @param micros 样本值（微秒）
+ * @return 桶下标
+ *
+ * 小于8的值直接作为下标；否则设最高位为第e位，取最高位之后的两位作为区间内的子桶
+ */
+size_t LatencyHistogram::bucketIndex(uint64_t micros)
+{
+    if (micros < 8)
+    {
+        return static_cast<size_t>(micros);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(micros));
+    size_t sub = static_cast<size_t>(micros >> (exponent - 2)) & 3;
+    return std::min(4 * (exponent - 1) + sub, NUM_BUCKETS - 1);
+}
+
+/**
+ * @brief 获取桶的上界
+ * @param index 桶下标
+ * @return 桶中样本的最大值（微秒，包含）
+ */
+uint64_t LatencyHistogram::bucketUpperMicros(size_t index)
+{
+    if (index < 8)
+    {
+        return index;
+    }
+    uint64_t sub = index % 4;
+    uint64_t shift = index / 4 - 1;
+    return ((4 + sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief 记录一个样本
+ * @param micros 样本值（微秒）
+ */
+void LatencyHistogram::record(uint64_t micros)
+{
+    Shard &shard = shards[currentShard()];
+    shard.buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sumMicros.fetch_add(micros, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 合并所有分片
+ * @return 直方图快照
+ */
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot result;
+    result.buckets.assign(NUM_BUCKETS, 0);
+    for (const Shard &shard : shards)
+    {
+        for (size_t i = 0; i < NUM_BUCKETS; i++)
+        {
+            result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        result.sumMicros += shard.sumMicros.load(std::memory_order_relaxed);
+    }
+    // 样本总数由桶计数求和得到，保证与桶计数一致
+    for (uint64_t bucket : result.buckets)
+    {
+        result.count += bucket;
+    }
+    return result;
+}
+
+/**
+ * @brief 估算分位数
+ * @param q 分位点
+ * @return 分位数所在桶的上界（微秒）
+ */
+uint64_t HistogramSnapshot::quantileMicros(double q) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            return LatencyHistogram::bucketUpperMicros(i);
+        }
+    }
+    return LatencyHistogram::bucketUpperMicros(buckets.size() - 1);
+}
+
+/**
+ * @brief 在指标第一次出现时写入 HELP/TYPE 行
+ * @param name 指标名
+ * @param help 指标说明
+ * @param type 指标类型
+ */
+void PrometheusWriter::declare(const std::string &name, const std::string &help, const char *type)
+{
+    if (!declared.insert(name).second)
+    {
+        return;
+    }
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+/**
+ * @brief 写入一行样本
+ * @param name 样本名
+ * @param labels 标签
+ * @param extraLabel 额外的标签
+ * @param value 样本值
+ */
+void PrometheusWriter::sample(const std::string &name, const std::string &labels,
+                              const std::string &extraLabel, const std::string &value)
+{
+    out += name;
+    if (!labels.empty() || !extraLabel.empty())
+    {
+        out += "{";
+        out += labels;
+        if (!labels.empty() && !extraLabel.empty())
+        {
+            out += ",";
+        }
+        out += extraLabel;
+        out += "}";
+    }
+    out += " ";
+    out += value;
+    out += "\n";
+}
+
+/**
+ * @brief 写入一个计数器
+ */
+void PrometheusWriter::counter(const std::string &name, const std::string &help,
+                               const std::string &labels, uint64_t value)
+{
+    declare(name, help, "counter");
+    sample(name, labels, "", std::to_string(value));
+}
+
+/**
+ * @brief 写入一个仪表值
+ */
+void PrometheusWriter::gauge(const std::string &name, const std::string &help,
+                             const std::string &labels, double value)
+{
+    declare(name, help, "gauge");
+    sample(name, labels, "", fmt::format("{}", value));
+}
+
+/**
+ * @brief 写入一个延迟直方图
+ *
+ * 只输出每个2的幂区间的最后一个桶作为le边界（累积计数在任意边界上都是精确的），
+ * 使每个直方图的输出保持在三十行以内
+ */
+void PrometheusWriter::histogram(const std::string &name, const std::string &help,
+                                 const std::string &labels, const HistogramSnapshot &snapshot)
+{
+    declare(name, help, "histogram");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < snapshot.buckets.size(); i++)
+    {
+        cumulative += snapshot.buckets[i];
+        if (i % 4 == 3 && i + 1 < snapshot.buckets.size())
+        {
+            sample(name + "_bucket", labels,
+                   "le=\"" + formatSeconds(LatencyHistogram::bucketUpperMicros(i)) + "\"",
+                   std::to_string(cumulative));
+        }
+    }
+    sample(name + "_bucket", labels, "le=\"+Inf\"", std::to_string(snapshot.count));
+    sample(name + "_sum", labels, "", formatSeconds(snapshot.sumMicros));
+    sample(name + "_count", labels, "", std::to_string(snapshot.count));
+}
+
+/**
+ * @brief 写入延迟分位数
+ */
+void PrometheusWriter::quantiles(const std::string &name, const std::string &help,
+                                 const std::string &labels, const HistogramSnapshot &snapshot)
+{
+    declare(name, help, "summary");
+    for (const char *quantile : {"0.5", "0.99", "0.999"})
+    {
+        sample(name, labels, std::string("quantile=\"") + quantile + "\"",
+               formatSeconds(snapshot.quantileMicros(std::stod(quantile))));
+    }
+    sample(name + "_sum", labels, "", formatSeconds(snapshot.sumMicros));
+    sample(name + "_count", labels, "", std::to_string(snapshot.count));
+}
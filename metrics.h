@@ -0,0 +1,199 @@
+/**
+ * @file metrics.h
+ * @brief 运行指标头文件
+ * @details 提供无锁的计数器和延迟直方图，以及 Prometheus 文本格式的输出。
+ *          计数器按线程分片：每个线程只更新自己所在分片（独占一个缓存行）的原子变量，
+ *          抓取指标时再把所有分片合并，因此统计本身不会成为多线程争用的来源。
+ */
+
+#pragma once
+
+#include "constants.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @class ShardedCounter
+ * @brief 按线程分片的单调递增计数器
+ */
+class ShardedCounter
+{
+public:
+    /**
+     * @brief 增加计数
+     * @param n 增加的数量
+     */
+    void add(uint64_t n = 1);
+
+    /**
+     * @brief 合并所有分片，获取当前计数
+     * @return 计数值
+     */
+    uint64_t value() const;
+
+private:
+    /**
+     * @struct Shard
+     * @brief 独占一个缓存行的分片，避免不同线程的分片之间伪共享
+     */
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<Shard, METRICS_SHARDS> shards; ///< 分片
+};
+
+/**
+ * @struct HistogramSnapshot
+ * @brief 延迟直方图在某一时刻的合并结果
+ */
+struct HistogramSnapshot
+{
+    std::vector<uint64_t> buckets; ///< 每个桶的计数（非累积）
+    uint64_t count = 0;            ///< 样本总数
+    uint64_t sumMicros = 0;        ///< 样本总和（微秒）
+
+    /**
+     * @brief 估算分位数
+     * @param q 分位点，取值范围 (0, 1]
+     * @return 分位数所在桶的上界（微秒），没有样本时返回0
+     */
+    uint64_t quantileMicros(double q) const;
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief 按线程分片、对数分桶的延迟直方图
+ *
+ * 以微秒为单位记录样本。0~7微秒每个值一个桶，之后每个2的幂区间等分为4个桶，
+ * 因此任意样本所在桶的相对误差不超过25%；超过约134秒的样本计入最后一个桶。
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t NUM_BUCKETS = 104; ///< 桶的数量
+
+    /**
+     * @brief 记录一个样本
+     * @param micros 样本值（微秒）
+     */
+    void record(uint64_t micros);
+
+    /**
+     * @brief 合并所有分片
+     * @return 直方图快照
+     */
+    HistogramSnapshot snapshot() const;
+
+    /**
+     * @brief 获取样本值对应的桶下标
+     * @param micros 样本值（微秒）
+     * @return 桶下标
+     */
+    static size_t bucketIndex(uint64_t micros);
+
+    /**
+     * @brief 获取桶的上界
+     * @param index 桶下标
+     * @return 桶中样本的最大值（微秒，包含）
+     */
+    static uint64_t bucketUpperMicros(size_t index);
+
+private:
+    /**
+     * @struct Shard
+     * @brief 一个线程分片的全部计数，按缓存行对齐
+     */
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{}; ///< 各桶计数
+        std::atomic<uint64_t> count{0};                           ///< 样本总数
+        std::atomic<uint64_t> sumMicros{0};                       ///< 样本总和
+    };
+
+    std::array<Shard, METRICS_SHARDS> shards; ///< 分片
+};
+
+/**
+ * @class PrometheusWriter
+ * @brief Prometheus 文本格式（0.0.4）的输出器
+ *
+ * 同名指标的 HELP/TYPE 行只在第一次出现时输出，调用方应把同名指标连续写出。
+ */
+class PrometheusWriter
+{
+public:
+    /**
+     * @brief 写入一个计数器
+     * @param name 指标名
+     * @param help 指标说明
+     * @param labels 标签（形如 endpoint="/search"，可为空）
+     * @param value 计数值
+     */
+    void counter(const std::string &name, const std::string &help,
+                 const std::string &labels, uint64_t value);
+
+    /**
+     * @brief 写入一个仪表值
+     * @param name 指标名
+     * @param help 指标说明
+     * @param labels 标签（可为空）
+     * @param value 当前值
+     */
+    void gauge(const std::string &name, const std::string &help,
+               const std::string &labels, double value);
+
+    /**
+     * @brief 写入一个延迟直方图（单位转换为秒）
+     * @param name 指标名
+     * @param help 指标说明
+     * @param labels 标签（可为空）
+     * @param snapshot 直方图快照
+     */
+    void histogram(const std::string &name, const std::string &help,
+                   const std::string &labels, const HistogramSnapshot &snapshot);
+
+    /**
+     * @brief 写入延迟分位数（summary类型：p50、p99、p999，单位为秒）
+     * @param name 指标名
+     * @param help 指标说明
+     * @param labels 标签（可为空）
+     * @param snapshot 直方图快照
+     */
+    void quantiles(const std::string &name, const std::string &help,
+                   const std::string &labels, const HistogramSnapshot &snapshot);
+
+    /**
+     * @brief 获取输出的文本
+     * @return 文本
+     */
+    const std::string &str() const { return out; }
+
+private:
+    /**
+     * @brief 在指标第一次出现时写入 HELP/TYPE 行
+     * @param name 指标名
+     * @param help 指标说明
+     * @param type 指标类型
+     */
+    void declare(const std::string &name, const std::string &help, const char *type);
+
+    /**
+     * @brief 写入一行样本
+     * @param name 样本名
+     * @param labels 标签（可为空）
+     * @param extraLabel 额外的标签（如 le="0.001"，可为空）
+     * @param value 样本值
+     */
+    void sample(const std::string &name, const std::string &labels,
+                const std::string &extraLabel, const std::string &value);
+
+    std::string out;                ///< 输出的文本
+    std::set<std::string> declared; ///< 已输出 HELP/TYPE 的指标名
+};
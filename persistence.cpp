@@ -11,6 +11,7 @@
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -73,14 +74,12 @@ void Persistence::init(const std::string &localPath)
 /**
  * @brief 递增并获取下一个日志ID的实现
  * @return uint64_t 返回递增后的新日志ID
- * @details 该函数是线程不安全的，在多线程环境下需要额外的同步机制
- *          每次调用都会使内部计数器递增1，并返回新的值
+ * @details 每次调用都会使内部计数器原子地递增1，并返回新的值
  *          返回的ID用于唯一标识每个WAL日志条目
  */
 uint64_t Persistence::increaseID()
 {
-    currentID++;      // 递增内部计数器
-    return currentID; // 返回新的日志ID
+    return currentID.fetch_add(1) + 1; // 递增内部计数器并返回新的日志ID
 }
 
 /**
@@ -112,16 +111,33 @@ void Persistence::writeWALLog(const std::string &operationType,
                               const rapidjson::Document &jsonData,
                               const std::string &version)
 {
-    // 生成新的日志ID
-    uint64_t logID = increaseID();
-
     // 将JSON文档序列化为字符串
     rapidjson::StringBuffer buffer;                            // 创建字符串缓冲区
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // 创建JSON写入器
     jsonData.Accept(writer);                                   // 将JSON文档写入缓冲区
 
+    writeWALLog(operationType, std::string(buffer.GetString(), buffer.GetSize()), version);
+}
+
+/**
+ * @brief 写入已序列化的WAL日志条目的实现
+ * @param operationType 操作类型字符串（如"upsert"、"bulk_upsert"）
+ * @param jsonDataStr 已序列化的JSON数据字符串
+ * @param version 数据版本号字符串
+ * @details 批量写入时一个批次只生成一条日志、只刷新一次磁盘。
+ *          多个写入线程共享同一个文件流，整条日志的写入持有 walMutex，避免行内容交错
+ */
+void Persistence::writeWALLog(const std::string &operationType,
+                              const std::string &jsonDataStr,
+                              const std::string &version)
+{
+    std::lock_guard<std::mutex> lock(walMutex);
+
+    // 生成新的日志ID，在锁内生成使文件中的日志ID按行递增
+    uint64_t logID = increaseID();
+
     // 按照WAL日志格式写入文件：logID|version|operationType|jsonDataString
-    walLogFile << logID << "|" << version << "|" << operationType << "|" << buffer.GetString() << std::endl;
+    walLogFile << logID << "|" << version << "|" << operationType << "|" << jsonDataStr << std::endl;
 
     // 检查写入操作是否成功
     if (walLogFile.fail())
@@ -133,11 +149,17 @@ void Persistence::writeWALLog(const std::string &operationType,
     else
     {
         // 记录成功写入的调试信息
-        globalLogger->debug("Successfully wrote WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
-                            logID, version, operationType, buffer.GetString());
+        LOG_DEBUG("Successfully wrote WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
+                  logID, version, operationType, jsonDataStr);
 
         // 强制将缓冲区中的数据刷新到磁盘，确保数据持久化
         walLogFile.flush();
+
+        // 统计上次快照之后的日志量：3个分隔符和1个换行符
+        walBytesSinceSnapshot.fetch_add(std::to_string(logID).size() + version.size() + operationType.size() +
+                                            jsonDataStr.size() + 4,
+                                        std::memory_order_relaxed);
+        walEntriesSinceSnapshot.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
@@ -158,7 +180,7 @@ void Persistence::writeWALLog(const std::string &operationType,
 void Persistence::readNextWALLog(std::string *operationType,
                                  rapidjson::Document *jsonData)
 {
-    globalLogger->debug("Reading next WAL log entry");
+    LOG_DEBUG("Reading next WAL log entry");
 
     std::string line;
 
@@ -173,7 +195,7 @@ void Persistence::readNextWALLog(std::string *operationType,
         std::getline(iss, logIDStr, '|');       // 提取日志ID字符串
         std::getline(iss, version, '|');        // 提取版本号
         std::getline(iss, *operationType, '|'); // 提取操作类型（通过指针返回）
-        std::getline(iss, jsonDataStr, '|');    // 提取JSON数据字符串
+        std::getline(iss, jsonDataStr);         // 提取JSON数据字符串（行内剩余部分，JSON中可能含有'|'）
 
         // 将日志ID字符串转换为uint64_t类型
         uint64_t logID = std::stoull(logIDStr);
@@ -186,15 +208,19 @@ void Persistence::readNextWALLog(std::string *operationType,
 
         if (logID > lastSnapshotID)
         {
+            // 重放的日志同样在下次快照之前需要保留
+            walBytesSinceSnapshot.fetch_add(line.size() + 1, std::memory_order_relaxed);
+            walEntriesSinceSnapshot.fetch_add(1, std::memory_order_relaxed);
+
             jsonData->Parse(jsonDataStr.c_str());
-            globalLogger->debug("Read WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
-                                logID, version, *operationType, jsonDataStr);
+            LOG_DEBUG("Read WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
+                      logID, version, *operationType, jsonDataStr);
             return;
         }
         else
         {
-            globalLogger->debug("Skip read WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
-                                logID, version, *operationType, jsonDataStr);
+            LOG_DEBUG("Skip read WAL log entry: logID={}, version={}, operationType={}, jsonDataStr={}",
+                      logID, version, *operationType, jsonDataStr);
         }
     }
 
@@ -203,17 +229,20 @@ void Persistence::readNextWALLog(std::string *operationType,
     walLogFile.clear();
 
     // 记录调试信息
-    globalLogger->debug("No more WAL log entries to read");
+    LOG_DEBUG("No more WAL log entries to read");
 }
 
 /**
  * @brief 执行快照操作，保存当前所有索引和最后ID
  * @param scalarStorage 用于保存Scalar索引
+ * @param collectionIndexes 命名集合的索引工厂
  */
-void Persistence::takeSnapshot(ScalarStorage &scalarStorage)
+void Persistence::takeSnapshot(ScalarStorage &scalarStorage,
+                               const std::map<std::string, IndexFactory *> &collectionIndexes)
 {
     // 记录日志
-    globalLogger->debug("Taking snapshot");
+    LOG_DEBUG("Taking snapshot");
+    auto startTime = std::chrono::steady_clock::now();
 
     // 更新最后快照ID为当前ID
     lastSnapshotID = currentID;
@@ -225,19 +254,32 @@ void Persistence::takeSnapshot(ScalarStorage &scalarStorage)
     IndexFactory *indexFactory = getGlobalIndexFactory();
     // 调用索引工厂保存所有索引
     indexFactory->saveIndex(snapshotFolderPath, scalarStorage);
+    // 命名集合保存在快照目录下的子目录中，必须在保存最后快照ID之前完成
+    for (const auto &entry : collectionIndexes)
+    {
+        entry.second->saveIndex(snapshotFolderPath + "/" + entry.first, scalarStorage);
+    }
 
     // 保存最后快照ID到文件
     saveLastSnapshotID();
+
+    // 快照之前的日志不再需要重放
+    walBytesSinceSnapshot.store(0, std::memory_order_relaxed);
+    walEntriesSinceSnapshot.store(0, std::memory_order_relaxed);
+    snapshotDuration.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count()));
 }
 
 /**
  * @brief 从快照文件加载索引
  * @param scalarStorage 用于加载Scalar索引
+ * @param collectionIndexes 命名集合的索引工厂
  */
-void Persistence::loadSnapshot(ScalarStorage &scalarStorage)
+void Persistence::loadSnapshot(ScalarStorage &scalarStorage,
+                               const std::map<std::string, IndexFactory *> &collectionIndexes)
 {
     // 记录日志
-    globalLogger->debug("Loading snapshot");
+    LOG_DEBUG("Loading snapshot");
 
     // 定义快照文件夹路径
     std::string snapshotFolderPath = "snapshots";
@@ -246,6 +288,10 @@ void Persistence::loadSnapshot(ScalarStorage &scalarStorage)
     IndexFactory *indexFactory = getGlobalIndexFactory();
     // 调用索引工厂加载所有索引
     indexFactory->loadIndex(snapshotFolderPath, scalarStorage);
+    for (const auto &entry : collectionIndexes)
+    {
+        entry.second->loadIndex(snapshotFolderPath + "/" + entry.first, scalarStorage);
+    }
 }
 
 /**
@@ -270,7 +316,7 @@ void Persistence::saveLastSnapshotID()
         globalLogger->error("Failed to open file lastSnapshotID for writing");
     }
     // 记录日志
-    globalLogger->debug("Last snapshot ID saved: {}", lastSnapshotID);
+    LOG_DEBUG("Last snapshot ID saved: {}", lastSnapshotID);
 }
 
 /**
@@ -295,5 +341,5 @@ void Persistence::loadLastSnapshotID()
         globalLogger->error("Failed to open file lastSnapshotID for reading");
     }
     // 记录日志
-    globalLogger->debug("Last snapshot ID loaded: {}", lastSnapshotID);
+    LOG_DEBUG("Last snapshot ID loaded: {}", lastSnapshotID);
 }
\ No newline at end of file
@@ -7,12 +7,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <cstdint> // 包含 <cstdint> 以使用 uint64_t 类型
 #include "rapidjson/document.h"
+#include "metrics.h"
 #include "scalar_storage.h"
 
+class IndexFactory;
+
 /**
  * @class Persistence
  * @brief 持久化管理类
@@ -56,8 +62,8 @@ public:
     /**
      * @brief 递增并获取下一个日志ID
      * @return uint64_t 返回递增后的新日志ID
-     * @details 该函数用于生成唯一的日志标识符，每次调用都会使内部计数器递增
-     *          返回的ID用于标识WAL日志条目的顺序
+     * @details 该函数用于生成唯一的日志标识符，每次调用都会使内部计数器原子地递增，
+     *          并发调用得到的ID互不相同。返回的ID用于标识WAL日志条目的顺序
      */
     uint64_t increaseID();
 
@@ -75,13 +81,24 @@ public:
      * @param version 数据版本号字符串
      * @details 将一个完整的操作记录写入WAL日志文件
      *          日志格式：logID|version|operationType|jsonDataString
-     *          写入后会强制刷新到磁盘以确保持久性
+     *          写入后会强制刷新到磁盘以确保持久性。可以被多个线程并发调用
      * @throws std::runtime_error 当写入失败时抛出异常
      */
     void writeWALLog(const std::string &operationType,
                      const rapidjson::Document &jsonData,
                      const std::string &version);
 
+    /**
+     * @brief 写入已序列化的WAL日志条目
+     * @param operationType 操作类型（如"upsert"、"bulk_upsert"）
+     * @param jsonDataStr 已序列化的JSON数据字符串
+     * @param version 数据版本号字符串
+     * @details 供批量写入等调用方直接传入序列化结果，避免再构造一次JSON文档
+     */
+    void writeWALLog(const std::string &operationType,
+                     const std::string &jsonDataStr,
+                     const std::string &version);
+
     /**
      * @brief 读取下一条WAL日志条目
      * @param operationType 输出参数，用于返回操作类型
@@ -99,16 +116,20 @@ public:
     /**
      * @brief 创建快照
      * @param scalarStorage rocksdb对象
+     * @param collectionIndexes 命名集合的索引工厂（集合名到索引工厂），保存在 snapshots/集合名 目录下
      * @details 将当前的数据快照存储到rocksdb中
      */
-    void takeSnapshot(ScalarStorage &scalarStorage);
+    void takeSnapshot(ScalarStorage &scalarStorage,
+                      const std::map<std::string, IndexFactory *> &collectionIndexes = {});
 
     /**
      * @brief 加载快照
      * @param scalarStorage rocksdb对象
+     * @param collectionIndexes 命名集合的索引工厂，从 snapshots/集合名 目录加载
      * @details 从rocksdb中加载数据快照
      */
-    void loadSnapshot(ScalarStorage &scalarStorage);
+    void loadSnapshot(ScalarStorage &scalarStorage,
+                      const std::map<std::string, IndexFactory *> &collectionIndexes = {});
 
     /**
      * @brief 保存最后一条快照ID
@@ -122,8 +143,30 @@ public:
      */
     void loadLastSnapshotID();
 
+    /**
+     * @brief 获取上次快照之后写入的WAL日志字节数
+     * @return 字节数（包含启动时重放的日志）
+     */
+    uint64_t getWALBytesSinceSnapshot() const { return walBytesSinceSnapshot.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 获取上次快照之后写入的WAL日志条数
+     * @return 日志条数（包含启动时重放的日志）
+     */
+    uint64_t getWALEntriesSinceSnapshot() const { return walEntriesSinceSnapshot.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 获取快照耗时的直方图
+     * @return 快照耗时直方图
+     */
+    const LatencyHistogram &getSnapshotDuration() const { return snapshotDuration; }
+
 private:
-    uint64_t currentID;        ///< 当前日志ID计数器，用于生成唯一的日志标识符
+    std::atomic<uint64_t> currentID; ///< 当前日志ID计数器，用于生成唯一的日志标识符
     uint64_t lastSnapshotID;   ///< Snapshot中最后一条日志ID，用于标明WAL日志的恢复起点
     std::fstream walLogFile;   ///< WAL日志文件流对象，支持读写操作
+    std::mutex walMutex;       ///< 保护日志文件的追加写入：生成日志ID和写入同一行在一次加锁内完成，文件中的ID保持递增
+    std::atomic<uint64_t> walBytesSinceSnapshot{0};   ///< 上次快照之后的WAL日志字节数，重启时需要重放的数据量
+    std::atomic<uint64_t> walEntriesSinceSnapshot{0}; ///< 上次快照之后的WAL日志条数
+    LatencyHistogram snapshotDuration;                ///< 快照耗时
 };
@@ -0,0 +1,636 @@
+/**
+ * @file request.cpp
+ * @brief 类型化请求实现文件
+ */
+
+#include "request.h"
+#include "constants.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "search_response.h"
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace
+{
+    /**
+     * @struct ParseContext
+     * @brief 每个线程独享的JSON解析上下文
+     *
+     * 值分配器和解析栈分配器都以一块预先分配的内存作为首块，
+     * 每次解析前调用 Clear 只会释放额外申请的内存块，首块在请求之间复用。
+     */
+    struct ParseContext
+    {
+        std::unique_ptr<char[]> valueBuffer;               ///< 值分配器的首块内存
+        std::unique_ptr<char[]> stackBuffer;               ///< 解析栈分配器的首块内存
+        rapidjson::MemoryPoolAllocator<> valueAllocator;   ///< 文档值使用的分配器
+        rapidjson::MemoryPoolAllocator<> stackAllocator;   ///< 解析栈使用的分配器
+        RequestDocument document;                          ///< 复用的文档对象
+        std::vector<char> text;                            ///< 原位解析使用的请求体拷贝
+
+        ParseContext()
+            : valueBuffer(new char[REQUEST_PARSE_BUFFER_SIZE]),
+              stackBuffer(new char[REQUEST_PARSE_STACK_SIZE]),
+              valueAllocator(valueBuffer.get(), REQUEST_PARSE_BUFFER_SIZE),
+              stackAllocator(stackBuffer.get(), REQUEST_PARSE_STACK_SIZE),
+              document(&valueAllocator, REQUEST_PARSE_STACK_SIZE / 2, &stackAllocator)
+        {
+        }
+    };
+
+    /**
+     * @brief 获取当前线程的解析上下文
+     * @return 解析上下文
+     */
+    ParseContext &parseContext()
+    {
+        thread_local ParseContext context;
+        return context;
+    }
+
+    /**
+     * @brief 解码一组维度相同的向量
+     * @param json 形如 [[0.1, 0.2], [0.3, 0.4]] 的JSON数组
+     * @param vectors 输出参数，按维度依次拼接的向量
+     * @param count 输出参数，向量数量
+     * @return 不是非空的二维数值数组或各向量维度不一致时返回false
+     */
+    bool decodeVectorList(const rapidjson::Value &json, std::vector<float> *vectors, size_t *count)
+    {
+        if (!json.IsArray() || json.Empty() || !json[0].IsArray())
+        {
+            return false;
+        }
+        rapidjson::SizeType dim = json[0].Size();
+        vectors->reserve(static_cast<size_t>(dim) * json.Size());
+        for (const auto &vector : json.GetArray())
+        {
+            if (dim == 0 || !vector.IsArray() || vector.Size() != dim)
+            {
+                return false;
+            }
+            for (const auto &v : vector.GetArray())
+            {
+                if (!v.IsNumber())
+                {
+                    return false;
+                }
+                vectors->push_back(v.GetFloat());
+            }
+        }
+        *count = json.Size();
+        return true;
+    }
+
+    /**
+     * @brief 把JSON值序列化为记录文本
+     * @param jsonRequest JSON请求对象
+     * @param vector 需要作为vectors字段补进记录的向量，为nullptr时原样序列化
+     * @param record 输出参数，序列化后的记录文本
+     */
+    void serializeRecord(const rapidjson::Value &jsonRequest, const std::vector<float> *vector,
+                         std::string *record)
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        if (vector == nullptr)
+        {
+            jsonRequest.Accept(writer);
+        }
+        else
+        {
+            writer.StartObject();
+            for (auto it = jsonRequest.MemberBegin(); it != jsonRequest.MemberEnd(); ++it)
+            {
+                // 以传入的向量为准，忽略记录中可能存在的vectors字段
+                if (std::strcmp(it->name.GetString(), REQUEST_VECTORS) == 0)
+                {
+                    continue;
+                }
+                writer.Key(it->name.GetString(), it->name.GetStringLength());
+                it->value.Accept(writer);
+            }
+            writer.Key(REQUEST_VECTORS);
+            writer.StartArray();
+            // 按float精度写入最短表示，与JSON写入的记录保持一致，也避免记录文本膨胀
+            for (float v : *vector)
+            {
+                writeShortestFloat(writer, v);
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+        record->assign(buffer.GetString(), buffer.GetSize());
+    }
+}
+
+/**
+ * @brief 从请求中获取索引类型
+ * @param jsonRequest JSON请求对象
+ * @return IndexFactory::IndexType 解析出的索引类型，缺失或未知时返回UNKNOWN
+ */
+IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Value &jsonRequest)
+{
+    // 如果请求中包含 indexType 字段
+    if (jsonRequest.HasMember(REQUEST_INDEX_TYPE) && jsonRequest[REQUEST_INDEX_TYPE].IsString())
+    {
+        // 获取索引类型字符串
+        const char *indexTypeStr = jsonRequest[REQUEST_INDEX_TYPE].GetString();
+        // 根据字符串值返回对应的索引类型
+        if (std::strcmp(indexTypeStr, INDEX_TYPE_FLAT) == 0)
+        {
+            return IndexFactory::IndexType::FLAT;
+        }
+        else if (std::strcmp(indexTypeStr, INDEX_TYPE_HNSW) == 0)
+        {
+            return IndexFactory::IndexType::HNSW;
+        }
+        else if (std::strcmp(indexTypeStr, INDEX_TYPE_IVF) == 0)
+        {
+            return IndexFactory::IndexType::IVF;
+        }
+        // TODO: 支持其他索引类型
+    }
+    // 如果请求中不包含 indexType 字段或类型未知，返回 UNKNOWN
+    return IndexFactory::IndexType::UNKNOWN;
+}
+
+/**
+ * @brief 使用线程局部的缓冲区和分配器原位解析JSON请求体
+ * @param body 请求体
+ * @return RequestDocument& 解析结果
+ */
+RequestDocument &parseRequestJson(std::string_view body)
+{
+    ParseContext &context = parseContext();
+
+    // 先丢弃上一次的解析结果，再重置分配器，避免文档引用已回收的内存
+    context.document.SetNull();
+    context.valueAllocator.Clear();
+    context.stackAllocator.Clear();
+
+    // 原位解析会改写输入，因此在线程局部缓冲区中保留一份以'\0'结尾的拷贝
+    context.text.assign(body.begin(), body.end());
+    context.text.push_back('\0');
+    context.document.ParseInsitu(context.text.data());
+    return context.document;
+}
+
+/**
+ * @brief 原位解析调用方持有的请求体，不再拷贝到线程局部缓冲区
+ * @param body 请求体，解析时会被改写
+ * @return RequestDocument& 解析结果
+ */
+RequestDocument &parseRequestJsonInsitu(std::string *body)
+{
+    ParseContext &context = parseContext();
+
+    context.document.SetNull();
+    context.valueAllocator.Clear();
+    context.stackAllocator.Clear();
+
+    // std::string 的数据保证以'\0'结尾，可以直接原位解析
+    context.document.ParseInsitu(&(*body)[0]);
+    return context.document;
+}
+
+/**
+ * @brief 释放当前线程解析上一个请求时额外占用的内存
+ */
+void releaseRequestJson()
+{
+    ParseContext &context = parseContext();
+
+    context.document.SetNull();
+    context.valueAllocator.Clear();
+    context.stackAllocator.Clear();
+    if (context.text.capacity() > REQUEST_PARSE_RETAIN_TEXT_BYTES)
+    {
+        std::vector<char>().swap(context.text);
+    }
+}
+
+/**
+ * @brief 解码JSON搜索请求
+ * @param jsonRequest JSON请求对象
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * vectors 合法的形状有两种：
+ * 1. 单个向量：[0.1, 0.2, ...]
+ * 2. 多个等长向量：[[0.1, 0.2, ...], [0.3, 0.4, ...]]
+ */
+bool decodeSearchRequest(const rapidjson::Value &jsonRequest, SearchRequest *request,
+                         std::string *errorMsg)
+{
+    if (!jsonRequest.IsObject())
+    {
+        *errorMsg = "Invalid JSON request";
+        return false;
+    }
+    if (!jsonRequest.HasMember(REQUEST_VECTORS) || !jsonRequest.HasMember(REQUEST_K))
+    {
+        *errorMsg = "Missing vectors or k parameters in the request";
+        return false;
+    }
+
+    const rapidjson::Value &vectors = jsonRequest[REQUEST_VECTORS];
+    request->vectors.clear();
+    request->numQueries = 0;
+    request->isBatch = false;
+    if (!vectors.IsArray() || vectors.Empty())
+    {
+        *errorMsg = "Invalid vectors parameter in the request";
+        return false;
+    }
+
+    if (!vectors[0].IsArray())
+    {
+        // 第一个元素不是数组，则视为单个向量
+        request->vectors.reserve(vectors.Size());
+        for (const auto &v : vectors.GetArray())
+        {
+            if (!v.IsNumber())
+            {
+                *errorMsg = "Invalid vectors parameter in the request";
+                return false;
+            }
+            request->vectors.push_back(v.GetFloat());
+        }
+        request->numQueries = 1;
+    }
+    else
+    {
+        // 多个向量：每个向量都必须是非空且等长的数值数组
+        rapidjson::SizeType dim = vectors[0].Size();
+        request->vectors.reserve(static_cast<size_t>(dim) * vectors.Size());
+        for (const auto &q : vectors.GetArray())
+        {
+            if (dim == 0 || !q.IsArray() || q.Size() != dim)
+            {
+                *errorMsg = "Invalid vectors parameter in the request";
+                return false;
+            }
+            for (const auto &v : q.GetArray())
+            {
+                if (!v.IsNumber())
+                {
+                    *errorMsg = "Invalid vectors parameter in the request";
+                    return false;
+                }
+                request->vectors.push_back(v.GetFloat());
+            }
+        }
+        request->numQueries = vectors.Size();
+        request->isBatch = true;
+    }
+
+    return decodeSearchOptions(jsonRequest, request, errorMsg);
+}
+
+/**
+ * @brief 解码搜索请求中除vectors以外的参数（k、indexType、filter、maxStalenessMs、timeoutMs、
+ *        ef、nprobe、explain、includeFields、includeVector、collection）
+ * @param jsonRequest JSON请求对象（二进制请求时为元数据JSON）
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ */
+bool decodeSearchOptions(const rapidjson::Value &jsonRequest, SearchRequest *request,
+                         std::string *errorMsg)
+{
+    if (!jsonRequest.IsObject() || !jsonRequest.HasMember(REQUEST_K))
+    {
+        *errorMsg = "Missing k parameter in the request";
+        return false;
+    }
+
+    // k必须是正整数
+    const rapidjson::Value &k = jsonRequest[REQUEST_K];
+    if (!k.IsInt() || k.GetInt() <= 0)
+    {
+        *errorMsg = "Invalid k parameter in the request";
+        return false;
+    }
+    request->k = k.GetInt();
+
+    // 索引类型必须是已知类型
+    request->indexType = getIndexTypeFromRequest(jsonRequest);
+    if (request->indexType == IndexFactory::IndexType::UNKNOWN)
+    {
+        *errorMsg = "Invalid indexType parameter in the request";
+        return false;
+    }
+
+    // 过滤条件：{"fieldName": "...", "op": "=" 或 "!=", "value": 整数}
+    request->hasFilter = false;
+    if (jsonRequest.HasMember(INDEX_TYPE_FILTER))
+    {
+        const rapidjson::Value &filter = jsonRequest[INDEX_TYPE_FILTER];
+        if (!filter.IsObject() ||
+            !filter.HasMember(REQUEST_FILTER_FIELD_NAME) || !filter[REQUEST_FILTER_FIELD_NAME].IsString() ||
+            !filter.HasMember(REQUEST_FILTER_OP) || !filter[REQUEST_FILTER_OP].IsString() ||
+            !filter.HasMember(REQUEST_FILTER_VALUE) || !filter[REQUEST_FILTER_VALUE].IsInt64())
+        {
+            *errorMsg = "Invalid filter parameter in the request";
+            return false;
+        }
+
+        const char *op = filter[REQUEST_FILTER_OP].GetString();
+        if (std::strcmp(op, "=") == 0)
+        {
+            request->filter.op = FilterIndex::Operation::EQUAL;
+        }
+        else if (std::strcmp(op, "!=") == 0)
+        {
+            request->filter.op = FilterIndex::Operation::NOT_EQUAL;
+        }
+        else
+        {
+            *errorMsg = "Invalid filter op in the request";
+            return false;
+        }
+        request->filter.fieldName.assign(filter[REQUEST_FILTER_FIELD_NAME].GetString(),
+                                         filter[REQUEST_FILTER_FIELD_NAME].GetStringLength());
+        request->filter.value = filter[REQUEST_FILTER_VALUE].GetInt64();
+        request->hasFilter = true;
+    }
+
+    // 可选参数：允许返回的缓存结果最多陈旧多少毫秒
+    request->maxStalenessMillis = 0;
+    if (jsonRequest.HasMember(REQUEST_MAX_STALENESS_MS))
+    {
+        const rapidjson::Value &maxStaleness = jsonRequest[REQUEST_MAX_STALENESS_MS];
+        if (!maxStaleness.IsUint64())
+        {
+            *errorMsg = "Invalid maxStalenessMs parameter in the request";
+            return false;
+        }
+        request->maxStalenessMillis = maxStaleness.GetUint64();
+    }
+
+    // 可选参数：搜索的时间预算（毫秒）
+    request->timeoutMillis = 0;
+    if (jsonRequest.HasMember(REQUEST_TIMEOUT_MS))
+    {
+        const rapidjson::Value &timeout = jsonRequest[REQUEST_TIMEOUT_MS];
+        if (!timeout.IsUint64())
+        {
+            *errorMsg = "Invalid timeoutMs parameter in the request";
+            return false;
+        }
+        request->timeoutMillis = timeout.GetUint64();
+    }
+
+    // 可选参数：HNSW搜索的候选数量，FLAT索引忽略该参数
+    request->ef = 0;
+    if (jsonRequest.HasMember(REQUEST_EF))
+    {
+        const rapidjson::Value &ef = jsonRequest[REQUEST_EF];
+        if (!ef.IsInt() || ef.GetInt() <= 0 || ef.GetInt() > HNSW_MAX_EF_SEARCH)
+        {
+            *errorMsg = "Invalid ef parameter in the request";
+            return false;
+        }
+        request->ef = ef.GetInt();
+    }
+
+    // 可选参数：IVF搜索探测的倒排列表数量，其他索引忽略该参数
+    request->nprobe = 0;
+    if (jsonRequest.HasMember(REQUEST_NPROBE))
+    {
+        const rapidjson::Value &nprobe = jsonRequest[REQUEST_NPROBE];
+        if (!nprobe.IsInt() || nprobe.GetInt() <= 0 || nprobe.GetInt() > IVF_MAX_NPROBE)
+        {
+            *errorMsg = "Invalid nprobe parameter in the request";
+            return false;
+        }
+        request->nprobe = nprobe.GetInt();
+    }
+
+    // 可选参数：是否返回执行计划
+    request->explain = false;
+    if (jsonRequest.HasMember(REQUEST_EXPLAIN))
+    {
+        const rapidjson::Value &explain = jsonRequest[REQUEST_EXPLAIN];
+        if (!explain.IsBool())
+        {
+            *errorMsg = "Invalid explain parameter in the request";
+            return false;
+        }
+        request->explain = explain.GetBool();
+    }
+
+    // 可选参数：随结果返回的记录字段（字符串数组）
+    request->includeFields.clear();
+    if (jsonRequest.HasMember(REQUEST_INCLUDE_FIELDS))
+    {
+        const rapidjson::Value &fields = jsonRequest[REQUEST_INCLUDE_FIELDS];
+        if (!fields.IsArray())
+        {
+            *errorMsg = "Invalid includeFields parameter in the request";
+            return false;
+        }
+        for (const auto &field : fields.GetArray())
+        {
+            if (!field.IsString())
+            {
+                *errorMsg = "Invalid includeFields parameter in the request";
+                return false;
+            }
+            request->includeFields.emplace_back(field.GetString(), field.GetStringLength());
+        }
+    }
+
+    // 可选参数：是否随结果返回命中向量
+    request->includeVector = false;
+    if (jsonRequest.HasMember(REQUEST_INCLUDE_VECTOR))
+    {
+        const rapidjson::Value &includeVector = jsonRequest[REQUEST_INCLUDE_VECTOR];
+        if (!includeVector.IsBool())
+        {
+            *errorMsg = "Invalid includeVector parameter in the request";
+            return false;
+        }
+        request->includeVector = includeVector.GetBool();
+    }
+
+    // 可选参数：搜索的集合
+    return decodeCollectionName(jsonRequest, &request->collection, errorMsg);
+}
+
+/**
+ * @brief 从请求中获取集合名
+ * @param jsonRequest JSON请求对象
+ * @param collection 输出参数，集合名
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * 这里只检查字段类型，集合是否存在由调用方检查
+ */
+bool decodeCollectionName(const rapidjson::Value &jsonRequest, std::string *collection,
+                          std::string *errorMsg)
+{
+    collection->clear();
+    if (!jsonRequest.HasMember(REQUEST_COLLECTION))
+    {
+        return true;
+    }
+    const rapidjson::Value &name = jsonRequest[REQUEST_COLLECTION];
+    if (!name.IsString())
+    {
+        *errorMsg = "Invalid collection parameter in the request";
+        return false;
+    }
+    collection->assign(name.GetString(), name.GetStringLength());
+    return true;
+}
+
+/**
+ * @brief 解码JSON插入或更新请求
+ * @param jsonRequest JSON请求对象
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @param rawText jsonRequest 对应的原始JSON文本
+ * @return 解码成功返回true
+ *
+ * indexType 缺失时保持为UNKNOWN，此时只写入标量存储（与原有 /upsert 行为一致），
+ * 是否接受由调用方决定。带int字段的记录ID必须小于2^32（过滤索引使用32位位图）
+ */
+bool decodeUpsertRequest(const rapidjson::Value &jsonRequest, UpsertRequest *request,
+                         std::string *errorMsg, std::string_view rawText)
+{
+    if (!jsonRequest.IsObject())
+    {
+        *errorMsg = "Invalid JSON request";
+        return false;
+    }
+    if (!jsonRequest.HasMember(REQUEST_ID) || !jsonRequest[REQUEST_ID].IsUint64())
+    {
+        *errorMsg = "Missing vectors or id parameters in the request";
+        return false;
+    }
+    request->id = jsonRequest[REQUEST_ID].GetUint64();
+    request->indexType = getIndexTypeFromRequest(jsonRequest);
+    // 集合名保留在记录文本中，WAL重放时据此写回原来的集合
+    if (!decodeCollectionName(jsonRequest, &request->collection, errorMsg))
+    {
+        return false;
+    }
+
+    // 二进制请求的向量已经由调用方填入，其余请求从vectors字段中读取
+    bool vectorFromJson = request->vector.empty();
+    if (vectorFromJson)
+    {
+        if (!jsonRequest.HasMember(REQUEST_VECTORS) || !jsonRequest[REQUEST_VECTORS].IsArray() ||
+            jsonRequest[REQUEST_VECTORS].Empty())
+        {
+            *errorMsg = "Missing vectors or id parameters in the request";
+            return false;
+        }
+        const rapidjson::Value &vectors = jsonRequest[REQUEST_VECTORS];
+        request->vector.reserve(vectors.Size());
+        for (const auto &v : vectors.GetArray())
+        {
+            if (!v.IsNumber())
+            {
+                *errorMsg = "Invalid vectors parameter in the request";
+                request->vector.clear();
+                return false;
+            }
+            request->vector.push_back(v.GetFloat());
+        }
+    }
+
+    // 收集需要写入过滤索引的int字段
+    request->intFields.clear();
+    for (auto it = jsonRequest.MemberBegin(); it != jsonRequest.MemberEnd(); ++it)
+    {
+        if (it->value.IsInt() && std::strcmp(it->name.GetString(), REQUEST_ID) != 0)
+        {
+            request->intFields.emplace_back(
+                std::string(it->name.GetString(), it->name.GetStringLength()),
+                it->value.GetInt64());
+        }
+    }
+    // 过滤索引的位图只能保存32位ID，带int字段的记录ID不能超出该范围，否则会被截断成其他记录的ID
+    if (!request->intFields.empty() && request->id > std::numeric_limits<uint32_t>::max())
+    {
+        *errorMsg = "Records with int fields require an id below 2^32";
+        return false;
+    }
+
+    // 记录文本：原始文本可直接使用时不再序列化；WAL日志按行分隔，因此不能包含换行符
+    if (vectorFromJson && !rawText.empty() &&
+        rawText.find_first_of("\r\n") == std::string_view::npos)
+    {
+        request->record.assign(rawText.data(), rawText.size());
+    }
+    else
+    {
+        serializeRecord(jsonRequest, vectorFromJson ? nullptr : &request->vector, &request->record);
+    }
+    return true;
+}
+
+/**
+ * @brief 解码JSON训练请求
+ * @param jsonRequest JSON请求对象
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ */
+bool decodeTrainRequest(const rapidjson::Value &jsonRequest, TrainRequest *request,
+                        std::string *errorMsg)
+{
+    if (!jsonRequest.IsObject())
+    {
+        *errorMsg = "Invalid JSON request";
+        return false;
+    }
+
+    // 可选参数：上传的训练向量
+    request->vectors.clear();
+    request->numVectors = 0;
+    if (jsonRequest.HasMember(REQUEST_VECTORS) &&
+        !decodeVectorList(jsonRequest[REQUEST_VECTORS], &request->vectors, &request->numVectors))
+    {
+        *errorMsg = "Invalid vectors parameter in the request";
+        return false;
+    }
+
+    // 可选参数：已训练的聚类中心
+    request->centroids.clear();
+    request->numCentroids = 0;
+    if (jsonRequest.HasMember(REQUEST_CENTROIDS))
+    {
+        if (!decodeVectorList(jsonRequest[REQUEST_CENTROIDS], &request->centroids, &request->numCentroids))
+        {
+            *errorMsg = "Invalid centroids parameter in the request";
+            return false;
+        }
+        if (request->numVectors > 0)
+        {
+            *errorMsg = "Training vectors and centroids cannot be given together";
+            return false;
+        }
+    }
+
+    // 可选参数：从标量存储中抽样的最大向量数
+    request->sampleSize = 0;
+    if (jsonRequest.HasMember(REQUEST_SAMPLE_SIZE))
+    {
+        const rapidjson::Value &sampleSize = jsonRequest[REQUEST_SAMPLE_SIZE];
+        if (!sampleSize.IsUint64() || sampleSize.GetUint64() == 0)
+        {
+            *errorMsg = "Invalid sampleSize parameter in the request";
+            return false;
+        }
+        request->sampleSize = static_cast<size_t>(sampleSize.GetUint64());
+    }
+
+    return decodeCollectionName(jsonRequest, &request->collection, errorMsg);
+}
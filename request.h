@@ -0,0 +1,204 @@
+/**
+ * @file request.h
+ * @brief 类型化请求头文件
+ * @details 定义 /search、/upsert、/admin/train 请求解码后的结构体，以及从JSON解码这些结构体的函数。
+ *          HTTP层只解码一次请求，数据库层直接使用解码结果，不再重复读取JSON；
+ *          非HTTP调用方（如WAL重放、测试）也可以直接构造这些结构体。
+ */
+
+#pragma once
+
+#include "index_factory.h"
+#include "filter_index.h"
+#include "rapidjson/document.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct FilterCondition
+ * @brief 搜索请求中的标量过滤条件
+ */
+struct FilterCondition
+{
+    std::string fieldName;                                          ///< 过滤字段名
+    FilterIndex::Operation op = FilterIndex::Operation::EQUAL;      ///< 过滤操作符
+    int64_t value = 0;                                              ///< 过滤值
+};
+
+/**
+ * @struct SearchRequest
+ * @brief 解码后的搜索请求
+ */
+struct SearchRequest
+{
+    std::vector<float> vectors;     ///< 所有查询向量，按维度依次拼接
+    size_t numQueries = 0;          ///< 查询向量的数量
+    bool isBatch = false;           ///< 请求中的vectors是否为多个向量组成的数组
+    int k = 0;                      ///< 每个查询返回的最近邻数量
+    IndexFactory::IndexType indexType = IndexFactory::IndexType::UNKNOWN; ///< 索引类型
+    bool hasFilter = false;         ///< 是否带有过滤条件
+    FilterCondition filter;         ///< 过滤条件，hasFilter为true时有效
+    uint64_t maxStalenessMillis = 0; ///< 可接受的缓存结果陈旧时间（毫秒），0表示只接受最新结果
+    std::vector<std::string> includeFields; ///< 需要随结果返回的记录字段
+    bool includeVector = false;     ///< 是否随结果返回命中向量
+    uint64_t timeoutMillis = 0;     ///< 搜索的时间预算（毫秒），超时后返回已找到的部分结果，0表示不限制
+    int ef = 0;                     ///< HNSW搜索的候选数量，0表示按过滤条件的选择率自动选择
+    int nprobe = 0;                 ///< IVF搜索探测的倒排列表数量，0表示自动选择（见 planIvfSearch）
+    bool explain = false;           ///< 是否随结果返回执行计划（见 search_planner.h）
+    std::string collection;         ///< 搜索的集合名，为空时使用默认集合
+};
+
+/**
+ * @struct UpsertRequest
+ * @brief 解码后的插入或更新请求
+ */
+struct UpsertRequest
+{
+    uint64_t id = 0;                ///< 记录ID
+    IndexFactory::IndexType indexType = IndexFactory::IndexType::UNKNOWN; ///< 索引类型
+    std::vector<float> vector;      ///< 记录的向量
+    std::vector<std::pair<std::string, int64_t>> intFields; ///< 需要写入过滤索引的int字段（id除外）
+    std::string record;             ///< 完整记录的JSON文本，原样写入标量存储和WAL日志
+    std::string collection;         ///< 写入的集合名，为空时使用默认集合
+};
+
+/**
+ * @struct TrainRequest
+ * @brief 解码后的IVF训练请求
+ */
+struct TrainRequest
+{
+    std::vector<float> vectors;     ///< 上传的训练向量，按维度依次拼接，为空时从标量存储中抽样
+    size_t numVectors = 0;          ///< 上传的训练向量数量
+    size_t sampleSize = 0;          ///< 从标量存储中抽样的最大向量数，0表示按 nlist 自动选择
+    std::vector<float> centroids;   ///< 已训练的聚类中心，按维度依次拼接，不为空时不再训练（见 VectorDatabase::trainIvf）
+    size_t numCentroids = 0;        ///< 聚类中心数量
+    std::string collection;         ///< 训练的集合名，为空时使用默认集合
+};
+
+/**
+ * @brief 请求解析使用的文档类型
+ *
+ * 与 rapidjson::Document 的区别仅在于解析栈也使用内存池分配器，
+ * 这样解析栈的内存同样可以在请求之间复用；其中的值类型与 rapidjson::Value 相同。
+ */
+using RequestDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>,
+                                                   rapidjson::MemoryPoolAllocator<>>;
+
+/**
+ * @brief 从请求中获取索引类型
+ * @param jsonRequest JSON请求对象
+ * @return IndexFactory::IndexType 解析出的索引类型，缺失或未知时返回UNKNOWN
+ */
+IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Value &jsonRequest);
+
+/**
+ * @brief 使用线程局部的缓冲区和分配器原位解析JSON请求体
+ * @param body 请求体
+ * @return RequestDocument& 解析结果（调用方需检查 HasParseError 或类型）
+ *
+ * 请求体被拷贝到线程局部缓冲区后原位解析，字符串值直接引用缓冲区而不再单独分配；
+ * 分配器的首块内存在同一线程的请求之间复用。
+ * 返回的文档在同一线程下一次调用本函数或 releaseRequestJson 前有效，因此应先解码为类型化请求再做后续处理。
+ */
+RequestDocument &parseRequestJson(std::string_view body);
+
+/**
+ * @brief 原位解析调用方持有的请求体
+ * @param body 请求体，解析时会被改写，在返回的文档使用期间必须保持有效
+ * @return RequestDocument& 解析结果（调用方需检查 HasParseError 或类型）
+ *
+ * 与 parseRequestJson 相同，但不拷贝请求体，适合调用方已经持有可修改副本的大请求体
+ */
+RequestDocument &parseRequestJsonInsitu(std::string *body);
+
+/**
+ * @brief 释放当前线程解析请求时额外占用的内存
+ *
+ * 丢弃上一次的解析结果，分配器只保留首块内存；请求体拷贝的容量超过
+ * REQUEST_PARSE_RETAIN_TEXT_BYTES 时一并释放，避免一次大请求长期占用工作线程的内存。
+ * 调用后之前返回的文档不再有效。
+ */
+void releaseRequestJson();
+
+/**
+ * @class ScopedRequestJson
+ * @brief 作用域结束时调用 releaseRequestJson，在解析请求的处理函数开头声明
+ */
+class ScopedRequestJson
+{
+public:
+    ScopedRequestJson() = default;
+
+    /**
+     * @brief 析构函数，释放解析占用的额外内存
+     */
+    ~ScopedRequestJson() { releaseRequestJson(); }
+
+    ScopedRequestJson(const ScopedRequestJson &) = delete;
+    ScopedRequestJson &operator=(const ScopedRequestJson &) = delete;
+};
+
+/**
+ * @brief 解码JSON搜索请求
+ * @param jsonRequest JSON请求对象
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ */
+bool decodeSearchRequest(const rapidjson::Value &jsonRequest, SearchRequest *request,
+                         std::string *errorMsg);
+
+/**
+ * @brief 解码搜索请求中除vectors以外的参数（k、indexType、filter、maxStalenessMs、timeoutMs、
+ *        ef、nprobe、explain、includeFields、includeVector、collection）
+ * @param jsonRequest JSON请求对象（二进制请求时为元数据JSON）
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * 二进制请求的查询向量直接从请求体中拷贝，只需要用该函数解码其余参数
+ */
+bool decodeSearchOptions(const rapidjson::Value &jsonRequest, SearchRequest *request,
+                         std::string *errorMsg);
+
+/**
+ * @brief 从请求中获取集合名
+ * @param jsonRequest JSON请求对象
+ * @param collection 输出参数，集合名，请求中没有collection字段时为空
+ * @param errorMsg 输出参数，collection字段不是字符串时的错误信息
+ * @return 解码成功返回true
+ */
+bool decodeCollectionName(const rapidjson::Value &jsonRequest, std::string *collection,
+                          std::string *errorMsg);
+
+/**
+ * @brief 解码JSON插入或更新请求
+ * @param jsonRequest JSON请求对象
+ * @param request 输出参数，解码后的请求；若调用前 vector 已填充（二进制请求），
+ *                则不再从JSON中读取vectors，而是把该向量补进记录文本中
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @param rawText jsonRequest 对应的原始JSON文本，非空且不含换行符时直接作为记录文本，
+ *                省去一次序列化
+ * @return 解码成功返回true
+ */
+bool decodeUpsertRequest(const rapidjson::Value &jsonRequest, UpsertRequest *request,
+                         std::string *errorMsg, std::string_view rawText = {});
+
+/**
+ * @brief 解码JSON训练请求
+ * @param jsonRequest JSON请求对象，形如 {"collection": "docs", "vectors": [[...], [...]]}
+ *                    或 {"collection": "docs", "sampleSize": 100000}
+ *                    或 {"collection": "docs", "centroids": [[...], [...]]}
+ * @param request 输出参数，解码后的请求
+ * @param errorMsg 输出参数，解码失败时的错误信息
+ * @return 解码成功返回true
+ *
+ * vectors 和 centroids 必须是非空且等长的数值数组组成的数组，两者不能同时出现；
+ * 维度是否与集合一致由调用方检查
+ */
+bool decodeTrainRequest(const rapidjson::Value &jsonRequest, TrainRequest *request,
+                        std::string *errorMsg);
@@ -0,0 +1,98 @@
+/**
+ * @file request_timing.cpp
+ * @brief 请求分阶段计时实现文件
+ */
+
+#include "request_timing.h"
+#include "logger.h"
+#include "spdlog/fmt/fmt.h"
+
+thread_local RequestTiming *RequestTiming::currentTiming = nullptr;
+
+namespace
+{
+    /**
+     * @brief 各阶段在 Server-Timing 头和慢请求日志中的名称，与 TimingStage 一一对应
+     */
+    const char *const STAGE_NAMES[] = {
+        "parse", "cache", "batch", "filter", "search", "fetch", "serialize", "storage", "index", "wal"};
+
+    static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<size_t>(TimingStage::COUNT),
+                  "STAGE_NAMES must match TimingStage");
+}
+
+/**
+ * @brief 构造函数
+ * @param endpoint 接口名
+ * @param withHeader 是否需要返回 Server-Timing 头
+ * @param slowThresholdMicros 慢请求阈值（微秒）
+ * @param queueWaitMicros 在任务队列中的等待时间（微秒）
+ */
+RequestTiming::RequestTiming(const char *endpoint, bool withHeader, uint64_t slowThresholdMicros,
+                             uint64_t queueWaitMicros)
+    : endpoint(endpoint), withHeader(withHeader), slowThresholdMicros(slowThresholdMicros),
+      enabled(withHeader || slowThresholdMicros > 0), queueWaitMicros(queueWaitMicros),
+      previous(currentTiming)
+{
+    if (enabled)
+    {
+        startTime = std::chrono::steady_clock::now();
+        currentTiming = this;
+    }
+}
+
+/**
+ * @brief 析构函数
+ *
+ * 卸载计时对象；总耗时超过阈值时输出一条包含各阶段耗时的警告日志
+ */
+RequestTiming::~RequestTiming()
+{
+    if (!enabled)
+    {
+        return;
+    }
+    currentTiming = previous;
+
+    if (slowThresholdMicros > 0 && elapsedNanos() / 1000 >= slowThresholdMicros)
+    {
+        std::string stages;
+        for (size_t i = 0; i < stageNanos.size(); i++)
+        {
+            if (stageNanos[i] > 0)
+            {
+                stages += fmt::format(" {}={}us", STAGE_NAMES[i], stageNanos[i] / 1000);
+            }
+        }
+        globalLogger->warn("Slow {} request: total={}us queue={}us{}",
+                           endpoint, elapsedNanos() / 1000, queueWaitMicros, stages);
+    }
+}
+
+/**
+ * @brief 生成 Server-Timing 头的值
+ * @return 各阶段耗时的文本（毫秒），没有经过的阶段不输出
+ */
+std::string RequestTiming::toServerTiming() const
+{
+    std::string value = fmt::format("queue;dur={:.3f}", static_cast<double>(queueWaitMicros) / 1e3);
+    for (size_t i = 0; i < stageNanos.size(); i++)
+    {
+        if (stageNanos[i] > 0)
+        {
+            value += fmt::format(", {};dur={:.3f}", STAGE_NAMES[i], static_cast<double>(stageNanos[i]) / 1e6);
+        }
+    }
+    value += fmt::format(", total;dur={:.3f}", static_cast<double>(elapsedNanos()) / 1e6);
+    return value;
+}
+
+/**
+ * @brief 获取从构造开始经过的时间
+ * @return 耗时（纳秒）
+ */
+uint64_t RequestTiming::elapsedNanos() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
@@ -0,0 +1,151 @@
+/**
+ * @file request_timing.h
+ * @brief 请求分阶段计时头文件
+ * @details 在请求处理的各个阶段（解析、过滤、索引搜索、序列化等）放置作用域计时器，
+ *          用于定位慢请求的耗时来源。计时结果可以通过 Server-Timing 响应头返回给客户端，
+ *          总耗时超过阈值时输出慢请求日志。
+ *
+ *          计时只在当前线程安装了 RequestTiming 时进行；未安装时每个计时器只读取一次
+ *          线程局部指针，不读取时钟，开销可以忽略。
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @enum TimingStage
+ * @brief 请求处理的阶段
+ */
+enum class TimingStage
+{
+    PARSE,     ///< 解析和解码请求体
+    CACHE,     ///< 查询和写入搜索结果缓存
+    BATCH,     ///< 等待合批并执行合并后的搜索（包含其中的过滤和搜索阶段）
+    FILTER,    ///< 构建过滤位图
+    SEARCH,    ///< 索引搜索
+    FETCH,     ///< 读取命中记录的字段和向量
+    SERIALIZE, ///< 序列化响应
+    STORAGE,   ///< 读写标量存储
+    INDEX,     ///< 写入向量索引和过滤索引
+    WAL,       ///< 写入WAL日志
+    COUNT      ///< 阶段数量
+};
+
+/**
+ * @class RequestTiming
+ * @brief 一个请求的分阶段耗时
+ *
+ * 在处理函数开始时构造；开启时安装为当前线程的计时对象，析构时卸载，
+ * 并在总耗时超过慢请求阈值时输出一条包含各阶段耗时的警告日志。
+ */
+class RequestTiming
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param endpoint 接口名，用于慢请求日志
+     * @param withHeader 是否需要在响应中返回 Server-Timing 头
+     * @param slowThresholdMicros 慢请求阈值（微秒），为0时不输出慢请求日志
+     * @param queueWaitMicros 请求开始处理前在任务队列中的等待时间（微秒），单独列出，不计入总耗时
+     *
+     * withHeader 为false且阈值为0时不开启计时
+     */
+    RequestTiming(const char *endpoint, bool withHeader, uint64_t slowThresholdMicros,
+                  uint64_t queueWaitMicros = 0);
+
+    /**
+     * @brief 析构函数，卸载计时对象并按需输出慢请求日志
+     */
+    ~RequestTiming();
+
+    RequestTiming(const RequestTiming &) = delete;
+    RequestTiming &operator=(const RequestTiming &) = delete;
+
+    /**
+     * @brief 获取当前线程的计时对象
+     * @return 未开启计时时返回nullptr
+     */
+    static RequestTiming *current() { return currentTiming; }
+
+    /**
+     * @brief 累加一个阶段的耗时
+     * @param stage 阶段
+     * @param nanos 耗时（纳秒）
+     */
+    void add(TimingStage stage, uint64_t nanos) { stageNanos[static_cast<size_t>(stage)] += nanos; }
+
+    /**
+     * @brief 是否需要在响应中返回 Server-Timing 头
+     * @return 需要时返回true
+     */
+    bool isHeaderRequested() const { return withHeader; }
+
+    /**
+     * @brief 生成 Server-Timing 头的值
+     * @return 形如 "queue;dur=0.020, parse;dur=0.011, search;dur=1.200, total;dur=1.500" 的文本，单位为毫秒
+     */
+    std::string toServerTiming() const;
+
+private:
+    /**
+     * @brief 获取从构造开始经过的时间
+     * @return 耗时（纳秒）
+     */
+    uint64_t elapsedNanos() const;
+
+    static thread_local RequestTiming *currentTiming; ///< 当前线程的计时对象
+
+    const char *endpoint;                                                  ///< 接口名
+    bool withHeader;                                                       ///< 是否返回 Server-Timing 头
+    uint64_t slowThresholdMicros;                                          ///< 慢请求阈值（微秒）
+    bool enabled;                                                          ///< 是否开启计时
+    uint64_t queueWaitMicros;                                              ///< 连接在任务队列中的等待时间
+    std::chrono::steady_clock::time_point startTime;                       ///< 开始处理的时间
+    std::array<uint64_t, static_cast<size_t>(TimingStage::COUNT)> stageNanos{}; ///< 各阶段的累计耗时（纳秒）
+    RequestTiming *previous;                                               ///< 安装前的计时对象
+};
+
+/**
+ * @class ScopedStageTimer
+ * @brief 作用域计时器，析构时把作用域内的耗时累加到当前请求的对应阶段
+ */
+class ScopedStageTimer
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param stage 阶段
+     */
+    explicit ScopedStageTimer(TimingStage stage)
+        : timing(RequestTiming::current()), stage(stage)
+    {
+        if (timing)
+        {
+            startTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    /**
+     * @brief 析构函数，累加耗时
+     */
+    ~ScopedStageTimer()
+    {
+        if (timing)
+        {
+            timing->add(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - startTime).count()));
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer &) = delete;
+    ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+private:
+    RequestTiming *timing;                           ///< 当前请求的计时对象，未开启时为nullptr
+    TimingStage stage;                               ///< 阶段
+    std::chrono::steady_clock::time_point startTime; ///< 进入作用域的时间
+};
@@ -7,9 +7,10 @@
 #include "scalar_storage.h"
 #include "logger.h"
 #include "rocksdb/db.h"
+#include "rocksdb/write_batch.h"
 #include <rapidjson/document.h>
-#include <rapidjson/stringbuffer.h>
-#include <rapidjson/writer.h>
+#include <map>
+#include <memory>
 #include <vector>
 
 /**
@@ -43,56 +44,176 @@ ScalarStorage::~ScalarStorage()
 /**
  * @brief 插入标量数据
  * @param id 数据ID
- * @param data 要存储的JSON数据
- * @details 将JSON数据序列化后存储到RocksDB中
+ * @param record 已序列化的JSON记录
+ * @param keyPrefix 键前缀
+ * @details 将JSON记录文本存储到RocksDB中
  */
-void ScalarStorage::insertScalar(uint64_t id, const rapidjson::Document &data)
+void ScalarStorage::insertScalar(uint64_t id, const std::string &record, const std::string &keyPrefix)
 {
-    // 将JSON数据序列化为字符串
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    data.Accept(writer);
-    std::string value = buffer.GetString();
-
     // 将数据写入RocksDB
-    rocksdb::Status status = db->Put(rocksdb::WriteOptions(), std::to_string(id), value);
+    rocksdb::Status status = db->Put(rocksdb::WriteOptions(), keyPrefix + std::to_string(id), record);
     if (!status.ok())
     {
         globalLogger->error("Failed to insert scalar: {}", status.ToString());
     }
 }
 
+/**
+ * @brief 批量插入标量数据
+ * @param ids 数据ID列表
+ * @param records 与ids一一对应的已序列化JSON记录
+ * @param keyPrefix 键前缀
+ * @details 所有数据放入同一个 WriteBatch，只产生一次RocksDB写入
+ */
+void ScalarStorage::insertScalars(const std::vector<uint64_t> &ids,
+                                  const std::vector<const std::string *> &records,
+                                  const std::string &keyPrefix)
+{
+    rocksdb::WriteBatch batch;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        batch.Put(keyPrefix + std::to_string(ids[i]), *records[i]);
+    }
+
+    // 将整个批次写入RocksDB
+    rocksdb::Status status = db->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok())
+    {
+        globalLogger->error("Failed to insert scalars in batch: {}", status.ToString());
+    }
+}
+
+/**
+ * @brief 删除标量数据
+ * @param id 数据ID
+ * @param keyPrefix 键前缀
+ */
+void ScalarStorage::removeScalar(uint64_t id, const std::string &keyPrefix)
+{
+    rocksdb::Status status = db->Delete(rocksdb::WriteOptions(), keyPrefix + std::to_string(id));
+    if (!status.ok())
+    {
+        globalLogger->error("Failed to remove scalar: {}", status.ToString());
+    }
+}
+
+/**
+ * @brief 按键的顺序遍历一个集合的所有记录
+ * @param keyPrefix 键前缀
+ * @param visitor 对每条记录调用一次，返回false时停止遍历
+ * @details 使用RocksDB迭代器从键前缀处开始顺序读取，键不再以该前缀开头时结束
+ */
+void ScalarStorage::scanScalars(const std::string &keyPrefix,
+                                const std::function<bool(uint64_t, std::string_view)> &visitor)
+{
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions()));
+    rocksdb::Slice prefix(keyPrefix);
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
+    {
+        rocksdb::Slice key = it->key();
+        key.remove_prefix(prefix.size());
+        // 前缀之后必须全部是数字
+        if (key.size() == 0 || key.size() > 20)
+        {
+            continue;
+        }
+        uint64_t id = 0;
+        bool numeric = true;
+        for (size_t i = 0; i < key.size() && numeric; i++)
+        {
+            char c = key.data()[i];
+            numeric = c >= '0' && c <= '9';
+            id = id * 10 + static_cast<uint64_t>(c - '0');
+        }
+        if (!numeric)
+        {
+            continue;
+        }
+        rocksdb::Slice value = it->value();
+        if (!visitor(id, std::string_view(value.data(), value.size())))
+        {
+            break;
+        }
+    }
+    if (!it->status().ok())
+    {
+        globalLogger->error("Failed to scan scalars: {}", it->status().ToString());
+    }
+}
+
 /**
  * @brief 获取标量数据
  * @param id 数据ID
+ * @param keyPrefix 键前缀
  * @return rapidjson::Document 返回解析后的JSON数据
  * @details 从RocksDB中读取数据并解析为JSON格式
  */
-rapidjson::Document ScalarStorage::getScalar(uint64_t id)
+rapidjson::Document ScalarStorage::getScalar(uint64_t id, const std::string &keyPrefix)
 {
     std::string value;
     // 从RocksDB中读取数据
-    rocksdb::Status status = db->Get(rocksdb::ReadOptions(), std::to_string(id), &value);
+    rocksdb::Status status = db->Get(rocksdb::ReadOptions(), keyPrefix + std::to_string(id), &value);
     if (!status.ok())
     {
         globalLogger->error("Failed to get scalar: {}", status.ToString());
         return rapidjson::Document();  // 返回空文档
     }
 
+    // 记录调试信息（直接输出原始文本，不再为日志重新序列化）
+    LOG_DEBUG("Data retrieved from ScalarStorage: {}", value);
+
     // 解析JSON数据
     rapidjson::Document data;
-    data.Parse(value.c_str());
-
-    // 记录调试信息
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    data.Accept(writer);
-    globalLogger->debug("Data retrieved from ScalarStorage: {}, RocksDB status: {}",
-                        buffer.GetString(), status.ToString());
+    data.Parse(value.c_str(), value.size());
 
     return data;
 }
 
+/**
+ * @brief 批量获取记录文本
+ * @param ids 数据ID列表
+ * @param keyPrefix 键前缀
+ * @return 与ids一一对应的JSON记录文本，不存在或读取失败的ID对应空字符串
+ */
+std::vector<std::string> ScalarStorage::getScalarRecords(const std::vector<uint64_t> &ids,
+                                                         const std::string &keyPrefix)
+{
+    size_t count = ids.size();
+    std::vector<std::string> records(count);
+    if (count == 0)
+    {
+        return records;
+    }
+
+    // 键的字符串必须在 MultiGet 期间保持有效
+    std::vector<std::string> keys(count);
+    std::vector<rocksdb::Slice> keySlices(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = keyPrefix + std::to_string(ids[i]);
+        keySlices[i] = rocksdb::Slice(keys[i]);
+    }
+
+    // 使用批量接口一次读取所有键
+    std::vector<rocksdb::PinnableSlice> values(count);
+    std::vector<rocksdb::Status> statuses(count);
+    db->MultiGet(rocksdb::ReadOptions(), db->DefaultColumnFamily(), count,
+                 keySlices.data(), values.data(), statuses.data());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (statuses[i].ok())
+        {
+            records[i].assign(values[i].data(), values[i].size());
+        }
+        else if (!statuses[i].IsNotFound())
+        {
+            globalLogger->error("Failed to get scalar {}: {}", ids[i], statuses[i].ToString());
+        }
+    }
+    return records;
+}
+
 /**
  * @brief 存储键值对
  * @param key 键
@@ -131,4 +252,35 @@ std::string ScalarStorage::get(const std::string &key)
         globalLogger->error("Failed to get value for key {}: {}", key, status.ToString());
     }
     return value; // 返回获取到的值 (失败时返回空字符串)
-}
\ No newline at end of file
+}
+/**
+ * @brief 获取RocksDB的内部统计
+ * @return 属性名到属性值的映射
+ *
+ * 逐个读取RocksDB的整数属性，读取属性只访问内存中的统计，不会产生磁盘IO。
+ */
+std::map<std::string, uint64_t> ScalarStorage::getStats() const
+{
+    static const char *const properties[] = {
+        "rocksdb.estimate-num-keys",
+        "rocksdb.estimate-live-data-size",
+        "rocksdb.total-sst-files-size",
+        "rocksdb.cur-size-all-mem-tables",
+        "rocksdb.block-cache-usage",
+        "rocksdb.num-running-compactions",
+        "rocksdb.num-running-flushes",
+        "rocksdb.estimate-pending-compaction-bytes",
+    };
+
+    std::map<std::string, uint64_t> stats;
+    for (const char *property : properties)
+    {
+        uint64_t value = 0;
+        // 没有配置块缓存等情况下属性不可用，跳过即可
+        if (db->GetIntProperty(property, &value))
+        {
+            stats[property] = value;
+        }
+    }
+    return stats;
+}
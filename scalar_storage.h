@@ -7,7 +7,10 @@
 #pragma once
 
 #include "rocksdb/db.h"
+#include <functional>
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "rapidjson/document.h"
 
@@ -36,19 +39,60 @@ public:
     /**
      * @brief 插入数据
      * @param id 数据ID，用于唯一标识存储的数据
-     * @param data 要存储的JSON数据
-     * @details 将JSON数据序列化后存储到RocksDB中
+     * @param record 已序列化的JSON记录
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
+     * @details 记录文本由请求解码时生成，这里直接写入RocksDB，不再重复序列化
      */
-    void insertScalar(uint64_t id, const rapidjson::Document &data);
+    void insertScalar(uint64_t id, const std::string &record, const std::string &keyPrefix = "");
+
+    /**
+     * @brief 批量插入数据
+     * @param ids 数据ID列表
+     * @param records 与ids一一对应的已序列化JSON记录
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
+     * @details 所有数据放入同一个 rocksdb::WriteBatch，一次写入RocksDB
+     */
+    void insertScalars(const std::vector<uint64_t> &ids,
+                       const std::vector<const std::string *> &records,
+                       const std::string &keyPrefix = "");
+
+    /**
+     * @brief 删除数据
+     * @param id 数据ID
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
+     */
+    void removeScalar(uint64_t id, const std::string &keyPrefix = "");
 
     /**
      * @brief 获取数据
      * @param id 数据ID
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
      * @return rapidjson::Document 返回解析后的JSON数据
      * @details 从RocksDB中读取数据并解析为JSON格式
      *          如果数据不存在或读取失败，返回空文档
      */
-    rapidjson::Document getScalar(uint64_t id);
+    rapidjson::Document getScalar(uint64_t id, const std::string &keyPrefix = "");
+
+    /**
+     * @brief 批量获取记录文本
+     * @param ids 数据ID列表
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
+     * @return 与ids一一对应的JSON记录文本，不存在或读取失败的ID对应空字符串
+     * @details 通过一次 rocksdb::DB::MultiGet 读取所有键，RocksDB 会合并块缓存查找并并行读取，
+     *          记录文本原样返回，不做JSON解析
+     */
+    std::vector<std::string> getScalarRecords(const std::vector<uint64_t> &ids,
+                                              const std::string &keyPrefix = "");
+
+    /**
+     * @brief 按键的顺序遍历一个集合的所有记录
+     * @param keyPrefix 键前缀（所属集合），默认集合为空
+     * @param visitor 对每条记录调用一次，参数为ID和记录文本，返回false时停止遍历
+     * @details 只访问 键前缀 + 十进制ID 形式的键；默认集合会跳过其他集合的记录和集合配置等元数据键。
+     *          记录文本只在本次调用内有效
+     */
+    void scanScalars(const std::string &keyPrefix,
+                     const std::function<bool(uint64_t, std::string_view)> &visitor);
 
     /**
      * @brief 获取标量数据
@@ -65,6 +109,13 @@ public:
      * @details 将值存储到RocksDB中
      */
     void put(const std::string &key, const std::string &value);
+
+    /**
+     * @brief 获取RocksDB的内部统计
+     * @return 属性名到属性值的映射，读取失败的属性不包含在内
+     * @details 包括估算的键数量、块缓存占用、memtable大小、SST文件大小和正在进行的压缩数等
+     */
+    std::map<std::string, uint64_t> getStats() const;
     
 private:
     rocksdb::DB *db;  ///< RocksDB数据库实例指针
@@ -0,0 +1,180 @@
+/**
+ * @file search_batcher.cpp
+ * @brief 搜索请求合批器实现文件
+ */
+
+#include "search_batcher.h"
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief 构造函数
+ * @param windowMicros 合批窗口（微秒）
+ * @param maxQueries 一个批次最多包含的查询数
+ */
+SearchBatcher::SearchBatcher(uint64_t windowMicros, size_t maxQueries)
+    : windowMicros(windowMicros), maxQueries(std::max<size_t>(maxQueries, 1))
+{
+}
+
+/**
+ * @brief 计算请求的批次键
+ * @param request 搜索请求
+ * @return 批次键
+ */
+SearchBatcher::BatchKey SearchBatcher::makeKey(const SearchRequest &request)
+{
+    size_t dim = request.numQueries > 0 ? request.vectors.size() / request.numQueries : 0;
+    if (!request.hasFilter)
+    {
+        return BatchKey(request.collection, request.k, request.indexType, false, std::string(),
+                        FilterIndex::Operation::EQUAL, 0, dim);
+    }
+    return BatchKey(request.collection, request.k, request.indexType, true, request.filter.fieldName,
+                    request.filter.op, request.filter.value, dim);
+}
+
+/**
+ * @brief 执行搜索，与其他并发的相同参数请求合并执行
+ * @param request 搜索请求
+ * @param runner 执行合并后请求的函数
+ * @return 该请求自己的搜索结果
+ */
+SearchBatcher::Results SearchBatcher::search(const SearchRequest &request, const BatchRunner &runner)
+{
+    // 本身已经达到批次上限的请求无需合批
+    if (request.numQueries >= maxQueries)
+    {
+        return runner(request);
+    }
+
+    // 统计并发执行的搜索数，决定领导者是否值得等待
+    struct InFlightGuard
+    {
+        std::atomic<size_t> &counter;
+        explicit InFlightGuard(std::atomic<size_t> &counter) : counter(counter) { counter++; }
+        ~InFlightGuard() { counter--; }
+    } inFlightGuard(inFlight);
+
+    Member self;
+    self.request = &request;
+    BatchKey key = makeKey(request);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = openBatches.find(key);
+    if (it != openBatches.end() && it->second->numQueries + request.numQueries <= maxQueries)
+    {
+        // 跟随者：加入已有批次，等待领导者分发结果
+        std::shared_ptr<Batch> batch = it->second;
+        batch->members.push_back(&self);
+        batch->numQueries += request.numQueries;
+        if (batch->numQueries >= maxQueries)
+        {
+            // 批次已满，关闭批次并唤醒领导者立即执行
+            openBatches.erase(it);
+            batch->cond.notify_all();
+        }
+        batch->cond.wait(lock, [&]
+                         { return self.done; });
+        if (batch->error)
+        {
+            std::rethrow_exception(batch->error);
+        }
+        return std::move(self.results);
+    }
+
+    // 领导者：创建新批次（同键的旧批次已容纳不下，新批次取代它继续接受请求）
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->members.push_back(&self);
+    batch->numQueries = request.numQueries;
+    openBatches[key] = batch;
+
+    // 只有存在其他并发搜索时才等待合批窗口，低负载下直接执行
+    if (inFlight.load() > 1)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(windowMicros);
+        batch->cond.wait_until(lock, deadline, [&]
+                               { return batch->numQueries >= maxQueries; });
+    }
+
+    // 关闭批次：之后到达的请求会创建新批次
+    auto current = openBatches.find(key);
+    if (current != openBatches.end() && current->second == batch)
+    {
+        openBatches.erase(current);
+    }
+    lock.unlock();
+
+    runBatch(*batch, runner);
+    if (batch->error)
+    {
+        std::rethrow_exception(batch->error);
+    }
+    return std::move(self.results);
+}
+
+/**
+ * @brief 以领导者身份执行批次并分发结果
+ * @param batch 批次（已关闭，不会再有新成员加入）
+ * @param runner 执行合并后请求的函数
+ */
+void SearchBatcher::runBatch(Batch &batch, const BatchRunner &runner)
+{
+    const SearchRequest &first = *batch.members.front()->request;
+    try
+    {
+        if (batch.members.size() == 1)
+        {
+            batch.members.front()->results = runner(first);
+        }
+        else
+        {
+            // 把所有成员的查询向量拼接成一个批量请求
+            SearchRequest merged;
+            merged.collection = first.collection;
+            merged.k = first.k;
+            merged.indexType = first.indexType;
+            merged.hasFilter = first.hasFilter;
+            merged.filter = first.filter;
+            merged.numQueries = batch.numQueries;
+            merged.isBatch = true;
+            merged.vectors.reserve(first.vectors.size() / first.numQueries * batch.numQueries);
+            for (const Member *member : batch.members)
+            {
+                merged.vectors.insert(merged.vectors.end(), member->request->vectors.begin(),
+                                      member->request->vectors.end());
+            }
+
+            Results all = runner(merged);
+
+            // 每个查询占k个位置，按成员顺序拆分结果
+            size_t offset = 0;
+            for (Member *member : batch.members)
+            {
+                size_t slots = member->request->numQueries * static_cast<size_t>(first.k);
+                size_t begin = std::min(offset, all.first.size());
+                size_t end = std::min(offset + slots, all.first.size());
+                member->results.first.assign(all.first.begin() + begin, all.first.begin() + end);
+                member->results.second.assign(all.second.begin() + begin, all.second.begin() + end);
+                offset += slots;
+            }
+        }
+    }
+    catch (...)
+    {
+        batch.error = std::current_exception();
+    }
+
+    batches++;
+    batchedQueries += batch.numQueries;
+
+    // 通知所有跟随者结果已就绪
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (Member *member : batch.members)
+        {
+            member->done = true;
+        }
+    }
+    batch.cond.notify_all();
+}
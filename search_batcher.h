@@ -0,0 +1,124 @@
+/**
+ * @file search_batcher.h
+ * @brief 搜索请求合批器头文件
+ * @details 把并发到达、参数相同的FLAT搜索合并成一次 nq > 1 的 faiss 搜索，
+ *          再把结果拆分回各个请求。faiss 的暴力搜索在批量查询时使用BLAS矩阵乘法，
+ *          单个查询的平均耗时明显低于逐个查询。
+ */
+
+#pragma once
+
+#include "request.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * @class SearchBatcher
+ * @brief 搜索请求合批器
+ *
+ * 采用"领导者-跟随者"方式合批：
+ * 1. 第一个到达某个批次键（k、索引类型、过滤条件、向量维度）的请求成为领导者，
+ *    在合批窗口内等待其他请求加入，或等到批次中的查询数达到上限
+ * 2. 之后到达的相同批次键的请求作为跟随者加入批次并阻塞等待
+ * 3. 领导者把所有查询向量拼接后执行一次搜索，再把结果按查询拆分给每个请求
+ *
+ * 没有其他搜索并发执行时，领导者不等待，直接执行，避免低负载下增加延迟。
+ */
+class SearchBatcher
+{
+public:
+    using Results = std::pair<std::vector<long>, std::vector<float>>;
+
+    /**
+     * @brief 执行一个合并后的搜索请求的函数
+     */
+    using BatchRunner = std::function<Results(const SearchRequest &batchRequest)>;
+
+    /**
+     * @brief 构造函数
+     * @param windowMicros 合批窗口（微秒）
+     * @param maxQueries 一个批次最多包含的查询数
+     */
+    SearchBatcher(uint64_t windowMicros, size_t maxQueries);
+
+    /**
+     * @brief 执行搜索，与其他并发的相同参数请求合并执行
+     * @param request 搜索请求
+     * @param runner 执行合并后请求的函数
+     * @return 该请求自己的搜索结果，布局与单独执行时相同
+     */
+    Results search(const SearchRequest &request, const BatchRunner &runner);
+
+    /**
+     * @brief 获取已执行的批次数
+     * @return 批次数
+     */
+    uint64_t getBatches() const { return batches.load(); }
+
+    /**
+     * @brief 获取通过合批执行的查询总数
+     * @return 查询总数
+     */
+    uint64_t getBatchedQueries() const { return batchedQueries.load(); }
+
+private:
+    /**
+     * @brief 批次键：只有这些参数都相同的请求才能合并
+     */
+    using BatchKey = std::tuple<std::string, int, IndexFactory::IndexType, bool, std::string,
+                                FilterIndex::Operation, int64_t, size_t>;
+
+    /**
+     * @struct Member
+     * @brief 批次中的一个请求
+     */
+    struct Member
+    {
+        const SearchRequest *request;  ///< 请求
+        Results results;               ///< 拆分后的结果
+        bool done = false;             ///< 结果是否已就绪
+    };
+
+    /**
+     * @struct Batch
+     * @brief 正在收集请求的批次
+     */
+    struct Batch
+    {
+        std::vector<Member *> members;     ///< 批次中的请求，第一个为领导者
+        size_t numQueries = 0;             ///< 批次中的查询总数
+        std::exception_ptr error;          ///< 执行搜索时抛出的异常
+        std::condition_variable cond;      ///< 批次已满或结果就绪的通知
+    };
+
+    /**
+     * @brief 计算请求的批次键
+     * @param request 搜索请求
+     * @return 批次键
+     */
+    static BatchKey makeKey(const SearchRequest &request);
+
+    /**
+     * @brief 以领导者身份执行批次并分发结果
+     * @param batch 批次
+     * @param runner 执行合并后请求的函数
+     */
+    void runBatch(Batch &batch, const BatchRunner &runner);
+
+    uint64_t windowMicros;                              ///< 合批窗口（微秒）
+    size_t maxQueries;                                  ///< 一个批次最多包含的查询数
+    std::mutex mutex;                                   ///< 保护 openBatches 和批次状态
+    std::map<BatchKey, std::shared_ptr<Batch>> openBatches; ///< 仍在接受新请求的批次
+    std::atomic<size_t> inFlight{0};                    ///< 正在执行的搜索数
+    std::atomic<uint64_t> batches{0};                   ///< 已执行的批次数
+    std::atomic<uint64_t> batchedQueries{0};            ///< 通过合批执行的查询总数
+};
@@ -0,0 +1,227 @@
+/**
+ * @file search_cache.cpp
+ * @brief 搜索结果缓存实现文件
+ */
+
+#include "search_cache.h"
+#include <cstring>
+
+namespace
+{
+    /**
+     * @brief 把一个定长值的字节追加到缓存键中
+     * @param key 缓存键
+     * @param value 要追加的值
+     */
+    template <typename T>
+    void appendBytes(std::string &key, const T &value)
+    {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    /// 每个条目除键和结果之外的固定开销估算（链表节点、哈希表节点等）
+    const size_t ENTRY_OVERHEAD_BYTES = 128;
+}
+
+/**
+ * @brief 构造函数
+ * @param maxBytes 缓存占用的最大字节数
+ */
+SearchCache::SearchCache(size_t maxBytes) : maxBytes(maxBytes)
+{
+}
+
+/**
+ * @brief 计算请求的缓存键
+ * @param request 搜索请求
+ * @return 缓存键
+ *
+ * 键直接使用参数和向量的原始字节，由哈希表负责哈希，比较时逐字节相等，不会因哈希冲突返回错误结果
+ */
+std::string SearchCache::makeKey(const SearchRequest &request)
+{
+    std::string key;
+    key.reserve(64 + request.collection.size() + request.filter.fieldName.size() +
+                request.vectors.size() * sizeof(float));
+    appendBytes(key, request.collection.size());
+    key.append(request.collection);
+    appendBytes(key, request.k);
+    appendBytes(key, request.indexType);
+    appendBytes(key, request.ef);
+    appendBytes(key, request.nprobe);
+    appendBytes(key, request.numQueries);
+    appendBytes(key, request.hasFilter);
+    if (request.hasFilter)
+    {
+        appendBytes(key, request.filter.op);
+        appendBytes(key, request.filter.value);
+        appendBytes(key, request.filter.fieldName.size());
+        key.append(request.filter.fieldName);
+    }
+    key.append(reinterpret_cast<const char *>(request.vectors.data()),
+               request.vectors.size() * sizeof(float));
+    return key;
+}
+
+/**
+ * @brief 获取索引当前的写入代数
+ * @param indexType 索引类型
+ * @return 写入代数
+ */
+SearchCache::Epochs SearchCache::currentEpochs(IndexFactory::IndexType indexType)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Epochs epochs;
+    epochs.index = indexEpochs[indexType];
+    epochs.filter = filterEpoch;
+    return epochs;
+}
+
+/**
+ * @brief 判断条目的写入代数是否仍为最新
+ * @param entry 缓存条目
+ * @return 最新返回true
+ */
+bool SearchCache::isFresh(const Entry &entry) const
+{
+    auto it = indexEpochs.find(entry.indexType);
+    uint64_t indexEpoch = it != indexEpochs.end() ? it->second : 0;
+    if (entry.epochs.index != indexEpoch)
+    {
+        return false;
+    }
+    // 不带过滤条件的结果与过滤索引无关
+    return !entry.hasFilter || entry.epochs.filter == filterEpoch;
+}
+
+/**
+ * @brief 查找缓存的搜索结果
+ * @param request 搜索请求
+ * @param results 输出参数，命中时为缓存的结果
+ * @return 命中返回true
+ */
+bool SearchCache::lookup(const SearchRequest &request, Results *results)
+{
+    std::string key = makeKey(request);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto pos = positions.find(key);
+    if (pos == positions.end())
+    {
+        misses++;
+        return false;
+    }
+
+    auto it = pos->second;
+    bool fresh = isFresh(*it);
+    if (!fresh)
+    {
+        // 已过期的条目只对接受陈旧结果且条目足够新的请求有效
+        auto age = std::chrono::steady_clock::now() - it->createdAt;
+        if (request.maxStalenessMillis == 0 ||
+            age > std::chrono::milliseconds(request.maxStalenessMillis))
+        {
+            erase(it);
+            misses++;
+            return false;
+        }
+        staleHits++;
+    }
+
+    // 移到LRU链表表头
+    entries.splice(entries.begin(), entries, it);
+    *results = it->results;
+    hits++;
+    return true;
+}
+
+/**
+ * @brief 写入搜索结果
+ * @param request 搜索请求
+ * @param epochs 执行搜索之前获取的写入代数
+ * @param results 搜索结果
+ */
+void SearchCache::insert(const SearchRequest &request, const Epochs &epochs, const Results &results)
+{
+    Entry entry;
+    entry.key = makeKey(request);
+    entry.bytes = ENTRY_OVERHEAD_BYTES + entry.key.size() * 2 +
+                  results.first.size() * (sizeof(long) + sizeof(float));
+    // 单个结果过大（如大批量查询）时不缓存，避免一次写入淘汰大量热门条目
+    if (entry.bytes > maxBytes / 16)
+    {
+        return;
+    }
+    entry.results = results;
+    entry.indexType = request.indexType;
+    entry.hasFilter = request.hasFilter;
+    entry.epochs = epochs;
+    entry.createdAt = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto pos = positions.find(entry.key);
+    if (pos != positions.end())
+    {
+        erase(pos->second);
+    }
+
+    bytes += entry.bytes;
+    entries.push_front(std::move(entry));
+    positions[entries.front().key] = entries.begin();
+
+    // 淘汰最久未使用的条目直到不超过容量
+    while (bytes > maxBytes && !entries.empty())
+    {
+        erase(std::prev(entries.end()));
+        evictions++;
+    }
+}
+
+/**
+ * @brief 使索引上缓存的结果失效
+ * @param indexType 被写入的索引类型
+ * @param filterChanged 过滤索引是否也被修改
+ *
+ * 只递增写入代数，过期条目在查找到时或被LRU淘汰时删除
+ */
+void SearchCache::invalidate(IndexFactory::IndexType indexType, bool filterChanged)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    indexEpochs[indexType]++;
+    if (filterChanged)
+    {
+        filterEpoch++;
+    }
+}
+
+/**
+ * @brief 删除一个条目
+ * @param it 条目在LRU链表中的位置
+ */
+void SearchCache::erase(std::list<Entry>::iterator it)
+{
+    bytes -= it->bytes;
+    positions.erase(it->key);
+    entries.erase(it);
+}
+
+/**
+ * @brief 获取当前缓存的条目数
+ * @return 条目数
+ */
+size_t SearchCache::getEntries() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+/**
+ * @brief 获取当前缓存占用的字节数
+ * @return 字节数
+ */
+size_t SearchCache::getBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file search_cache.h
+ * @brief 搜索结果缓存头文件
+ * @details 在 VectorDatabase::search 之前缓存热门查询的结果。
+ *          缓存键由查询向量的字节、k、索引类型和过滤条件组成；
+ *          失效采用粗粒度的写入代数：每次写入索引都会使该索引上缓存的结果失效。
+ */
+
+#pragma once
+
+#include "request.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class SearchCache
+ * @brief 按字节数限制大小的LRU搜索结果缓存
+ *
+ * 每个索引类型有一个写入代数，过滤索引另有一个代数。缓存条目记录写入时的代数，
+ * 查找时代数不一致即视为过期。搜索开始前读取代数、搜索结束后用该代数写入缓存，
+ * 这样与写入并发执行的搜索结果不会被当作最新结果。
+ *
+ * 请求可以通过 maxStalenessMs 接受有限的陈旧结果：条目已过期但存在时间不超过该值时仍然命中。
+ */
+class SearchCache
+{
+public:
+    using Results = std::pair<std::vector<long>, std::vector<float>>;
+
+    /**
+     * @struct Epochs
+     * @brief 搜索开始时的写入代数
+     */
+    struct Epochs
+    {
+        uint64_t index = 0;   ///< 索引的写入代数
+        uint64_t filter = 0;  ///< 过滤索引的写入代数
+    };
+
+    /**
+     * @brief 构造函数
+     * @param maxBytes 缓存占用的最大字节数（按键和结果的大小估算）
+     */
+    explicit SearchCache(size_t maxBytes);
+
+    /**
+     * @brief 获取索引当前的写入代数，应在执行搜索之前调用
+     * @param indexType 索引类型
+     * @return 写入代数
+     */
+    Epochs currentEpochs(IndexFactory::IndexType indexType);
+
+    /**
+     * @brief 查找缓存的搜索结果
+     * @param request 搜索请求
+     * @param results 输出参数，命中时为缓存的结果
+     * @return 命中返回true
+     */
+    bool lookup(const SearchRequest &request, Results *results);
+
+    /**
+     * @brief 写入搜索结果
+     * @param request 搜索请求
+     * @param epochs 执行搜索之前通过 currentEpochs 获取的写入代数
+     * @param results 搜索结果
+     */
+    void insert(const SearchRequest &request, const Epochs &epochs, const Results &results);
+
+    /**
+     * @brief 使索引上缓存的结果失效
+     * @param indexType 被写入的索引类型
+     * @param filterChanged 过滤索引是否也被修改
+     */
+    void invalidate(IndexFactory::IndexType indexType, bool filterChanged);
+
+    uint64_t getHits() const { return hits.load(); }
+    uint64_t getStaleHits() const { return staleHits.load(); }
+    uint64_t getMisses() const { return misses.load(); }
+    uint64_t getEvictions() const { return evictions.load(); }
+    size_t getEntries() const;
+    size_t getBytes() const;
+    size_t getMaxBytes() const { return maxBytes; }
+
+private:
+    /**
+     * @struct Entry
+     * @brief 缓存条目
+     */
+    struct Entry
+    {
+        std::string key;                                  ///< 缓存键
+        Results results;                                  ///< 搜索结果
+        IndexFactory::IndexType indexType;                ///< 索引类型
+        bool hasFilter;                                   ///< 是否带有过滤条件
+        Epochs epochs;                                    ///< 搜索开始时的写入代数
+        std::chrono::steady_clock::time_point createdAt;  ///< 写入时间
+        size_t bytes;                                     ///< 估算的占用字节数
+    };
+
+    /**
+     * @brief 计算请求的缓存键
+     * @param request 搜索请求
+     * @return 缓存键（各参数与查询向量的原始字节拼接）
+     */
+    static std::string makeKey(const SearchRequest &request);
+
+    /**
+     * @brief 判断条目的写入代数是否仍为最新
+     * @param entry 缓存条目
+     * @return 最新返回true
+     */
+    bool isFresh(const Entry &entry) const;
+
+    /**
+     * @brief 删除一个条目
+     * @param it 条目在LRU链表中的位置
+     */
+    void erase(std::list<Entry>::iterator it);
+
+    size_t maxBytes;                                                       ///< 最大字节数
+    size_t bytes = 0;                                                      ///< 当前占用字节数
+    mutable std::mutex mutex;                                              ///< 保护所有成员
+    std::list<Entry> entries;                                              ///< LRU链表，表头为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> positions; ///< 键到链表位置的映射
+    std::map<IndexFactory::IndexType, uint64_t> indexEpochs;               ///< 各索引的写入代数
+    uint64_t filterEpoch = 0;                                              ///< 过滤索引的写入代数
+    std::atomic<uint64_t> hits{0};                                         ///< 命中次数
+    std::atomic<uint64_t> staleHits{0};                                    ///< 其中按 maxStalenessMs 命中陈旧条目的次数
+    std::atomic<uint64_t> misses{0};                                       ///< 未命中次数
+    std::atomic<uint64_t> evictions{0};                                    ///< 因容量不足被淘汰的条目数
+};
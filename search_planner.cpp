@@ -0,0 +1,199 @@
+/**
+ * @file search_planner.cpp
+ * @brief 过滤搜索计划实现文件
+ */
+
+#include "search_planner.h"
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 获取执行方式的名称
+ * @param strategy 执行方式
+ * @return 名称
+ */
+const char *searchStrategyName(SearchStrategy strategy)
+{
+    switch (strategy)
+    {
+    case SearchStrategy::FLAT_SCAN:
+        return "flat_scan";
+    case SearchStrategy::GRAPH:
+        return "graph";
+    case SearchStrategy::EXACT:
+        return "exact";
+    case SearchStrategy::POST_FILTER:
+        return "post_filter";
+    case SearchStrategy::FILTERED_GRAPH:
+        return "filtered_graph";
+    case SearchStrategy::TWO_HOP_GRAPH:
+        return "two_hop_graph";
+    case SearchStrategy::IVF_PROBE:
+        return "ivf_probe";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief 按过滤条件的选择率放大HNSW搜索的候选数量
+ * @param k 返回的最近邻数量
+ * @param vectors 存活向量数
+ * @param matches 满足过滤条件的向量数
+ * @return 候选数量
+ */
+size_t scaleEfForFilter(int k, size_t vectors, size_t matches)
+{
+    size_t ef = std::max<size_t>(k, HNSW_DEFAULT_EF_SEARCH);
+    // 位图中可能有不在本索引中的ID（如写入其他索引类型的记录），匹配数不会超过存活向量数
+    matches = std::min(matches, vectors);
+    if (matches == 0 || matches == vectors)
+    {
+        return ef;
+    }
+    double scaled = static_cast<double>(ef) * vectors / matches;
+    size_t limit = std::max<size_t>(k, HNSW_MAX_EF_SEARCH);
+    return scaled >= limit ? limit : static_cast<size_t>(scaled);
+}
+
+/**
+ * @brief 计算两跳过滤图搜索中每个节点最多经过的桥梁数量
+ * @param vectors 存活向量数
+ * @param matches 满足过滤条件的向量数
+ * @return 桥梁数量
+ */
+size_t twoHopBridgeBudget(size_t vectors, size_t matches)
+{
+    if (matches == 0)
+    {
+        return 0;
+    }
+    return HNSW_TWO_HOP_NEIGHBOR_FACTOR * ((vectors + matches - 1) / matches);
+}
+
+/**
+ * @brief 为HNSW搜索选择执行方式
+ * @param k 返回的最近邻数量
+ * @param vectors 存活向量数
+ * @param hasFilter 是否带有过滤条件
+ * @param matches 满足过滤条件的向量数
+ * @param maxNeighbors 底层每个节点的最大近邻数
+ * @param requestEf 请求指定的候选数量，为0时自动选择
+ * @return 选定的执行计划
+ *
+ * 代价以每个查询的距离计算次数估算：图搜索约为 ef * maxNeighbors，精确扫描为匹配数。
+ * 两跳过滤图搜索的候选数量不放大，每扩展一个节点最多计算 HNSW_TWO_HOP_NEIGHBOR_FACTOR * maxNeighbors 次距离，
+ * 另外每个桥梁查询 maxNeighbors 次位图（按 SEARCH_PLAN_MEMBERSHIP_COST 折算），
+ * 只在选择率不超过 SEARCH_PLAN_TWO_HOP_MAX_SELECTIVITY 时考虑。
+ * 后过滤可能因候选中满足条件的不足k个而回退，只有明显更便宜时才选择（见 SEARCH_PLAN_POST_FILTER_PENALTY）
+ */
+SearchPlan planHnswSearch(int k, size_t vectors, bool hasFilter, size_t matches,
+                          size_t maxNeighbors, int requestEf)
+{
+    SearchPlan plan;
+    plan.vectors = vectors;
+    plan.matches = hasFilter ? std::min(matches, vectors) : vectors;
+    size_t baseEf = requestEf > 0 ? static_cast<size_t>(requestEf) : HNSW_DEFAULT_EF_SEARCH;
+    baseEf = std::max<size_t>(baseEf, k);
+
+    if (!hasFilter)
+    {
+        plan.strategy = SearchStrategy::GRAPH;
+        plan.ef = baseEf;
+        plan.estimatedCost = static_cast<double>(plan.ef) * maxNeighbors;
+        return plan;
+    }
+
+    // 过滤图搜索：请求未指定ef时按选择率放大
+    size_t filteredEf = requestEf > 0 ? baseEf : scaleEfForFilter(k, vectors, plan.matches);
+    plan.strategy = SearchStrategy::FILTERED_GRAPH;
+    plan.ef = filteredEf;
+    plan.estimatedCost = static_cast<double>(filteredEf) * maxNeighbors;
+
+    // 两跳过滤图搜索：只对满足条件的节点计算距离，候选数量不放大，但要经过更多桥梁查询位图
+    if (plan.matches > 0 && plan.matches <= SEARCH_PLAN_TWO_HOP_MAX_SELECTIVITY * vectors)
+    {
+        double perNode = HNSW_TWO_HOP_NEIGHBOR_FACTOR * static_cast<double>(maxNeighbors) +
+                         static_cast<double>(twoHopBridgeBudget(vectors, plan.matches)) * maxNeighbors *
+                             SEARCH_PLAN_MEMBERSHIP_COST;
+        double twoHopCost = static_cast<double>(baseEf) * perNode;
+        if (twoHopCost < plan.estimatedCost)
+        {
+            plan.strategy = SearchStrategy::TWO_HOP_GRAPH;
+            plan.ef = baseEf;
+            plan.estimatedCost = twoHopCost;
+        }
+    }
+
+    // 精确扫描：每个匹配的ID计算一次距离
+    double exactCost = static_cast<double>(plan.matches);
+    if (exactCost <= plan.estimatedCost)
+    {
+        plan.strategy = SearchStrategy::EXACT;
+        plan.ef = 0;
+        plan.estimatedCost = exactCost;
+    }
+
+    // 后过滤：候选中期望有 k * SEARCH_PLAN_POST_FILTER_OVERSAMPLE 个满足过滤条件，
+    // 候选数量超过 HNSW_MAX_EF_SEARCH 时不考虑
+    if (plan.matches > 0)
+    {
+        double candidates = std::ceil(k * SEARCH_PLAN_POST_FILTER_OVERSAMPLE * vectors / plan.matches);
+        if (candidates <= HNSW_MAX_EF_SEARCH)
+        {
+            size_t candidateK = std::max<size_t>(static_cast<size_t>(candidates), k);
+            size_t postEf = std::max(candidateK, baseEf);
+            double postCost = static_cast<double>(postEf) * maxNeighbors;
+            if (postCost * SEARCH_PLAN_POST_FILTER_PENALTY < plan.estimatedCost)
+            {
+                plan.strategy = SearchStrategy::POST_FILTER;
+                plan.ef = postEf;
+                plan.candidateK = candidateK;
+                plan.estimatedCost = postCost;
+            }
+        }
+    }
+    return plan;
+}
+
+/**
+ * @brief 为IVF搜索选择探测的倒排列表数量
+ * @param k 返回的最近邻数量
+ * @param vectors 索引中的向量数
+ * @param hasFilter 是否带有过滤条件
+ * @param matches 满足过滤条件的向量数
+ * @param nlist 倒排列表数量
+ * @param trained 索引是否已训练
+ * @param requestNprobe 请求指定的探测数量，为0时自动选择
+ * @return 选定的执行计划
+ *
+ * 代价为到 nlist 个聚类中心的距离加上探测的列表中满足过滤条件的向量的距离
+ */
+SearchPlan planIvfSearch(int k, size_t vectors, bool hasFilter, size_t matches, size_t nlist,
+                         bool trained, int requestNprobe)
+{
+    SearchPlan plan;
+    plan.vectors = vectors;
+    plan.matches = hasFilter ? std::min(matches, vectors) : vectors;
+    if (!trained || nlist == 0)
+    {
+        plan.strategy = SearchStrategy::FLAT_SCAN;
+        plan.estimatedCost = static_cast<double>(plan.matches);
+        return plan;
+    }
+
+    size_t nprobe = requestNprobe > 0 ? static_cast<size_t>(requestNprobe) : IVF_DEFAULT_NPROBE;
+    if (requestNprobe <= 0 && hasFilter && plan.matches > 0)
+    {
+        double needed = std::ceil(k * SEARCH_PLAN_POST_FILTER_OVERSAMPLE * nlist / plan.matches);
+        if (needed > nprobe)
+        {
+            nprobe = needed >= nlist ? nlist : static_cast<size_t>(needed);
+        }
+    }
+    plan.strategy = SearchStrategy::IVF_PROBE;
+    plan.nprobe = std::min(nprobe, nlist);
+    plan.estimatedCost = static_cast<double>(nlist) +
+                         static_cast<double>(plan.nprobe) * plan.matches / nlist;
+    return plan;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file search_planner.h
+ * @brief 过滤搜索计划头文件
+ * @details 带过滤条件的HNSW搜索有四种执行方式，代价随过滤结果的数量（匹配数）变化很大：
+ *          - 精确扫描：只对位图中的ID逐个计算距离，代价与匹配数成正比，结果精确
+ *          - 后过滤：不带过滤条件搜索放大后的k个候选，再丢弃不满足过滤条件的结果
+ *          - 过滤图搜索：图搜索时跳过不满足过滤条件的节点，但这些节点仍会被扩展
+ *          - 两跳过滤图搜索：只在满足过滤条件的节点之间遍历，不满足的节点只作为桥梁
+ *          计划器按匹配数、存活向量数和索引参数估算每种方式的距离计算次数，选择代价最小的一种。
+ *          匹配数很少时精确扫描最便宜；过滤条件几乎不排除结果时过滤图搜索与不过滤相当；
+ *          两者之间后过滤只需搜索 k / 选择率 个候选，通常比按选择率放大ef的过滤图搜索便宜；
+ *          选择率很低时两跳过滤图搜索不需要放大ef，代价与不过滤的图搜索相当。
+ *          后过滤和两跳过滤图搜索结果不足k个时改用过滤图搜索。
+ *
+ *          IVF索引只有一种执行方式，计划器负责选择探测的倒排列表数量（见 planIvfSearch）。
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @enum SearchStrategy
+ * @brief 搜索的执行方式
+ */
+enum class SearchStrategy
+{
+    FLAT_SCAN,      ///< FLAT索引的暴力搜索
+    GRAPH,          ///< 不带过滤条件的HNSW图搜索
+    EXACT,          ///< 只对过滤位图中的ID计算距离
+    POST_FILTER,    ///< 放大k做不带过滤的图搜索，再按过滤条件筛选
+    FILTERED_GRAPH, ///< 带过滤条件的HNSW图搜索
+    TWO_HOP_GRAPH,  ///< 只在满足过滤条件的节点之间遍历的HNSW图搜索
+    IVF_PROBE       ///< 扫描IVF索引中离查询最近的 nprobe 个倒排列表
+};
+
+/**
+ * @struct SearchPlan
+ * @brief 一次搜索选定的执行方式及其估算代价
+ */
+struct SearchPlan
+{
+    SearchStrategy strategy = SearchStrategy::FLAT_SCAN; ///< 执行方式
+    size_t vectors = 0;         ///< 索引中的存活向量数
+    size_t matches = 0;         ///< 满足过滤条件的向量数，不过滤时等于vectors
+    size_t ef = 0;              ///< 图搜索的候选数量，不使用图搜索时为0
+    size_t candidateK = 0;      ///< 后过滤时搜索的候选数量，其他方式为0
+    size_t nprobe = 0;          ///< IVF搜索探测的倒排列表数量，其他方式为0
+    double estimatedCost = 0;   ///< 估算的每个查询的距离计算次数
+    bool fallback = false;      ///< 后过滤或两跳过滤图搜索结果不足k个，已改用过滤图搜索
+};
+
+/**
+ * @brief 获取执行方式的名称
+ * @param strategy 执行方式
+ * @return 名称，用于 explain 输出和日志
+ */
+const char *searchStrategyName(SearchStrategy strategy);
+
+/**
+ * @brief 按过滤条件的选择率放大HNSW搜索的候选数量
+ * @param k 返回的最近邻数量
+ * @param vectors 存活向量数
+ * @param matches 满足过滤条件的向量数
+ * @return 候选数量，在 [max(k, HNSW_DEFAULT_EF_SEARCH), max(k, HNSW_MAX_EF_SEARCH)] 之间
+ *
+ * 图搜索访问到的候选中大约只有 matches / vectors 能通过过滤，为了仍然找到k个结果，
+ * 候选数量按选择率的倒数放大
+ */
+size_t scaleEfForFilter(int k, size_t vectors, size_t matches);
+
+/**
+ * @brief 计算两跳过滤图搜索中每个节点最多经过的桥梁数量
+ * @param vectors 存活向量数
+ * @param matches 满足过滤条件的向量数
+ * @return 桥梁数量，matches为0时为0
+ *
+ * 每个桥梁的近邻中期望有 maxNeighbors * matches / vectors 个满足过滤条件，
+ * 经过 vectors / matches 个桥梁可以收集到与底层近邻数相当的满足条件的近邻，
+ * 再乘以 HNSW_TWO_HOP_NEIGHBOR_FACTOR 与收集数量的上限对应
+ */
+size_t twoHopBridgeBudget(size_t vectors, size_t matches);
+
+/**
+ * @brief 为HNSW搜索选择执行方式
+ * @param k 返回的最近邻数量
+ * @param vectors 存活向量数
+ * @param hasFilter 是否带有过滤条件
+ * @param matches 满足过滤条件的向量数，hasFilter为false时忽略
+ * @param maxNeighbors 底层每个节点的最大近邻数（2 * M），扩展一个节点最多计算这么多次距离
+ * @param requestEf 请求指定的候选数量，为0时自动选择
+ * @return 选定的执行计划
+ */
+SearchPlan planHnswSearch(int k, size_t vectors, bool hasFilter, size_t matches,
+                          size_t maxNeighbors, int requestEf);
+
+/**
+ * @brief 为IVF搜索选择探测的倒排列表数量
+ * @param k 返回的最近邻数量
+ * @param vectors 索引中的向量数
+ * @param hasFilter 是否带有过滤条件
+ * @param matches 满足过滤条件的向量数，hasFilter为false时忽略
+ * @param nlist 倒排列表数量
+ * @param trained 索引是否已训练，未训练时对缓冲区暴力扫描（FLAT_SCAN）
+ * @param requestNprobe 请求指定的探测数量，为0时自动选择
+ * @return 选定的执行计划
+ *
+ * 每个倒排列表平均有 vectors / nlist 个向量，其中约 matches / nlist 个满足过滤条件。
+ * 请求未指定探测数量时使用 IVF_DEFAULT_NPROBE，带过滤条件时放大到期望扫描到
+ * k * SEARCH_PLAN_POST_FILTER_OVERSAMPLE 个满足条件的向量，不超过 nlist
+ */
+SearchPlan planIvfSearch(int k, size_t vectors, bool hasFilter, size_t matches, size_t nlist,
+                         bool trained, int requestNprobe);
@@ -0,0 +1,303 @@
+/**
+ * @file search_response.cpp
+ * @brief 搜索响应序列化实现文件
+ */
+
+#include "search_response.h"
+#include "constants.h"
+#include "spdlog/fmt/fmt.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 以最短且可无损还原的形式写入一个float
+ * @param writer JSON写入器
+ * @param value 要写入的值
+ */
+void writeShortestFloat(rapidjson::Writer<rapidjson::StringBuffer> &writer, float value)
+{
+    if (!std::isfinite(value))
+    {
+        writer.Null();
+        return;
+    }
+    // fmt 对float使用按float精度的最短往返格式，最长不超过十几个字符
+    char text[32];
+    char *end = fmt::format_to(text, "{}", value);
+    writer.RawValue(text, static_cast<size_t>(end - text), rapidjson::kNumberType);
+}
+
+/**
+ * @brief 构造函数
+ * @param results 搜索结果
+ * @param numQueries 查询数量
+ * @param k 每个查询的结果数量
+ * @param isBatch 是否使用批量查询的响应格式
+ * @param buffer 输出缓冲区
+ * @param payload 随结果返回的附加数据
+ */
+SearchResponseWriter::SearchResponseWriter(std::pair<std::vector<long>, std::vector<float>> results,
+                                           size_t numQueries, int k, bool isBatch,
+                                           rapidjson::StringBuffer &buffer,
+                                           SearchHitPayload payload)
+    : results(std::move(results)), numQueries(numQueries), k(static_cast<size_t>(k)),
+      isBatch(isBatch), payload(std::move(payload)), writer(buffer)
+{
+}
+
+/**
+ * @brief 估算完整响应的字节数
+ * @return 估算的字节数
+ *
+ * 每个结果按ID约12字节、距离约14字节估算，另加每个查询的字段名开销；
+ * 附加数据按字段文本的实际长度和每个向量分量约12字节估算
+ */
+size_t SearchResponseWriter::estimateSize() const
+{
+    size_t size = 64 + numQueries * 48 + results.first.size() * 26;
+    for (const std::string &fields : payload.fields)
+    {
+        size += fields.size() + 6;
+    }
+    for (const std::vector<float> &vector : payload.vectors)
+    {
+        size += vector.size() * 12 + 6;
+    }
+    if (hasPlan)
+    {
+        size += 160;
+    }
+    return size;
+}
+
+/**
+ * @brief 获取搜索结果的位置总数
+ * @return 位置总数
+ */
+size_t SearchResponseWriter::resultSlots() const
+{
+    return results.first.size();
+}
+
+/**
+ * @brief 判断指定查询是否有有效结果
+ * @param query 查询下标
+ * @return 有有效结果返回true
+ */
+bool SearchResponseWriter::hasValidResult(size_t query) const
+{
+    size_t begin = std::min(query * k, results.first.size());
+    size_t end = std::min(begin + k, results.first.size());
+    return std::any_of(results.first.begin() + begin, results.first.begin() + end,
+                       [](long id)
+                       { return id != -1; });
+}
+
+/**
+ * @brief 当前数组写完后，开始下一个需要输出的附加数组，没有时结束当前查询
+ * @param next 候选的下一个状态（FIELDS、EMBEDDINGS 或 QUERY_BEGIN）
+ */
+void SearchResponseWriter::beginNextArray(Stage next)
+{
+    // 跳过没有请求的附加数组
+    if (next == Stage::FIELDS && !payload.hasFields)
+    {
+        next = Stage::EMBEDDINGS;
+    }
+    if (next == Stage::EMBEDDINGS && !payload.hasVectors)
+    {
+        next = Stage::QUERY_BEGIN;
+    }
+
+    if (next == Stage::QUERY_BEGIN)
+    {
+        if (isBatch)
+        {
+            writer.EndObject();
+        }
+        query++;
+        stage = Stage::QUERY_BEGIN;
+        return;
+    }
+
+    writer.Key(next == Stage::FIELDS ? RESPONSE_FIELDS : RESPONSE_EMBEDDINGS);
+    writer.StartArray();
+    position = std::min(query * k, results.first.size());
+    stage = next;
+}
+
+/**
+ * @brief 继续写入响应
+ * @param maxValues 本次最多写入的数值个数
+ * @return 整个响应写入完毕返回true
+ */
+bool SearchResponseWriter::write(size_t maxValues)
+{
+    size_t budget = std::max<size_t>(maxValues, 1);
+    while (stage != Stage::DONE)
+    {
+        size_t begin = std::min(query * k, results.first.size());
+        size_t end = std::min(begin + k, results.first.size());
+        switch (stage)
+        {
+        case Stage::BEGIN:
+            writer.StartObject();
+            if (isBatch)
+            {
+                writer.Key(RESPONSE_RESULTS);
+                writer.StartArray();
+            }
+            stage = Stage::QUERY_BEGIN;
+            break;
+        case Stage::QUERY_BEGIN:
+            if (query == numQueries)
+            {
+                // 所有查询写入完毕，补上返回码并结束
+                if (isBatch)
+                {
+                    writer.EndArray();
+                }
+                if (hasPlan)
+                {
+                    writer.Key(RESPONSE_PLAN);
+                    writer.StartObject();
+                    writer.Key("strategy");
+                    writer.String(searchStrategyName(plan.strategy));
+                    writer.Key("estimatedCost");
+                    writer.Double(plan.estimatedCost);
+                    writer.Key("matches");
+                    writer.Uint64(plan.matches);
+                    writer.Key("vectors");
+                    writer.Uint64(plan.vectors);
+                    writer.Key("ef");
+                    writer.Uint64(plan.ef);
+                    writer.Key("candidateK");
+                    writer.Uint64(plan.candidateK);
+                    writer.Key("nprobe");
+                    writer.Uint64(plan.nprobe);
+                    writer.Key("fallback");
+                    writer.Bool(plan.fallback);
+                    writer.EndObject();
+                }
+                if (partial)
+                {
+                    writer.Key(RESPONSE_PARTIAL);
+                    writer.Bool(true);
+                }
+                writer.Key(RESPONSE_RETCODE);
+                writer.Int(RESPONSE_RETCODE_SUCCESS);
+                writer.EndObject();
+                stage = Stage::DONE;
+                break;
+            }
+            // 单个查询没有有效结果时保持原有格式，不输出vectors和distances
+            if (!isBatch && !hasValidResult(query))
+            {
+                query++;
+                break;
+            }
+            if (isBatch)
+            {
+                writer.StartObject();
+            }
+            writer.Key(RESPONSE_VECTORS);
+            writer.StartArray();
+            position = begin;
+            stage = Stage::IDS;
+            break;
+        case Stage::IDS:
+            // 只写入有效结果（ID != -1）
+            for (; position < end && budget > 0; position++)
+            {
+                if (results.first[position] != -1)
+                {
+                    writer.Int64(results.first[position]);
+                    budget--;
+                }
+            }
+            if (position < end)
+            {
+                return false;
+            }
+            writer.EndArray();
+            writer.Key(RESPONSE_DISTANCES);
+            writer.StartArray();
+            position = begin;
+            stage = Stage::DISTANCES;
+            break;
+        case Stage::DISTANCES:
+            for (; position < end && budget > 0; position++)
+            {
+                if (results.first[position] != -1)
+                {
+                    writeShortestFloat(writer, results.second[position]);
+                    budget--;
+                }
+            }
+            if (position < end)
+            {
+                return false;
+            }
+            writer.EndArray();
+            beginNextArray(Stage::FIELDS);
+            break;
+        case Stage::FIELDS:
+            // 字段对象已在组装附加数据时投影为JSON文本，原样写入
+            for (; position < end && budget > 0; position++)
+            {
+                if (results.first[position] != -1)
+                {
+                    const std::string &fields = payload.fields[position];
+                    if (fields.empty())
+                    {
+                        writer.Null();
+                    }
+                    else
+                    {
+                        writer.RawValue(fields.data(), fields.size(), rapidjson::kObjectType);
+                    }
+                    budget--;
+                }
+            }
+            if (position < end)
+            {
+                return false;
+            }
+            writer.EndArray();
+            beginNextArray(Stage::EMBEDDINGS);
+            break;
+        case Stage::EMBEDDINGS:
+            for (; position < end && budget > 0; position++)
+            {
+                if (results.first[position] != -1)
+                {
+                    const std::vector<float> &vector = payload.vectors[position];
+                    if (vector.empty())
+                    {
+                        writer.Null();
+                    }
+                    else
+                    {
+                        writer.StartArray();
+                        for (float value : vector)
+                        {
+                            writeShortestFloat(writer, value);
+                        }
+                        writer.EndArray();
+                    }
+                    budget--;
+                }
+            }
+            if (position < end)
+            {
+                return false;
+            }
+            writer.EndArray();
+            beginNextArray(Stage::QUERY_BEGIN);
+            break;
+        case Stage::DONE:
+            break;
+        }
+    }
+    return true;
+}
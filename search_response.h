@@ -0,0 +1,151 @@
+/**
+ * @file search_response.h
+ * @brief 搜索响应序列化头文件
+ * @details 不经过 rapidjson::Document，直接用 rapidjson::Writer 把搜索结果写成JSON文本。
+ *          支持分段写入，大结果集可以配合 httplib 的分块传输逐段发送。
+ */
+
+#pragma once
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "search_planner.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 以最短且可无损还原的形式写入一个float
+ * @param writer JSON写入器
+ * @param value 要写入的值
+ *
+ * rapidjson 的 Double 会把float扩展为double后输出（如0.1f输出为0.10000000149011612），
+ * 这里按float精度输出最短表示（0.1）；非有限值在JSON中无法表示，写为null
+ */
+void writeShortestFloat(rapidjson::Writer<rapidjson::StringBuffer> &writer, float value);
+
+/**
+ * @struct SearchHitPayload
+ * @brief 随搜索结果返回的附加数据，与结果位置一一对应
+ */
+struct SearchHitPayload
+{
+    bool hasFields = false;                   ///< 是否输出 fields
+    bool hasVectors = false;                  ///< 是否输出 embeddings
+    std::vector<std::string> fields;          ///< 每个位置投影后的字段JSON对象文本，记录不存在时为空
+    std::vector<std::vector<float>> vectors;  ///< 每个位置的命中向量，无法获取时为空
+};
+
+/**
+ * @class SearchResponseWriter
+ * @brief 搜索结果的JSON写入器
+ *
+ * 输出格式与 /search 的原有响应一致：
+ * - 单个查询：{"vectors":[...],"distances":[...],"retcode":0}，没有有效结果时只有retcode
+ * - 批量查询：{"results":[{"vectors":[...],"distances":[...]},...],"retcode":0}
+ *
+ * 带有附加数据时，每个查询在distances之后还会输出与ID一一对应的 fields 和/或 embeddings，
+ * 无法获取的项写为null。搜索超时返回部分结果时，retcode 之前还有 "partial":true；
+ * 请求带有 explain 时，retcode 之前还有执行计划 "plan":{...}。
+ *
+ * write 每次最多写入指定数量的数值，写入器的嵌套状态在两次调用之间保留，
+ * 因此调用方可以在两次调用之间取走并清空缓冲区，实现分段输出。
+ */
+class SearchResponseWriter
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param results 搜索结果，每个查询占k个位置，ID为-1的位置表示无效结果
+     * @param numQueries 查询数量
+     * @param k 每个查询的结果数量
+     * @param isBatch 是否使用批量查询的响应格式
+     * @param buffer 输出缓冲区
+     * @param payload 随结果返回的附加数据
+     */
+    SearchResponseWriter(std::pair<std::vector<long>, std::vector<float>> results,
+                         size_t numQueries, int k, bool isBatch,
+                         rapidjson::StringBuffer &buffer,
+                         SearchHitPayload payload = SearchHitPayload());
+
+    /**
+     * @brief 继续写入响应
+     * @param maxValues 本次最多写入的数值个数（ID、距离、字段对象和命中向量各算一个）
+     * @return 整个响应写入完毕返回true
+     */
+    bool write(size_t maxValues);
+
+    /**
+     * @brief 估算完整响应的字节数，用于预先分配缓冲区
+     * @return 估算的字节数
+     */
+    size_t estimateSize() const;
+
+    /**
+     * @brief 获取搜索结果的位置总数（包括无效位置）
+     * @return 位置总数
+     */
+    size_t resultSlots() const;
+
+    /**
+     * @brief 标记结果是在时间预算内未完成搜索时返回的部分结果
+     * @param isPartial 是否为部分结果
+     *
+     * 为部分结果时在 retcode 之前输出 "partial":true，需在开始写入之前调用
+     */
+    void setPartial(bool isPartial) { partial = isPartial; }
+
+    /**
+     * @brief 设置随结果返回的执行计划
+     * @param searchPlan 执行计划
+     *
+     * 在 retcode 之前输出 "plan":{"strategy":...,"estimatedCost":...}，需在开始写入之前调用
+     */
+    void setPlan(const SearchPlan &searchPlan)
+    {
+        plan = searchPlan;
+        hasPlan = true;
+    }
+
+private:
+    /**
+     * @brief 写入状态
+     */
+    enum class Stage
+    {
+        BEGIN,       ///< 尚未写入任何内容
+        QUERY_BEGIN, ///< 准备写入下一个查询的结果
+        IDS,         ///< 正在写入当前查询的ID数组
+        DISTANCES,   ///< 正在写入当前查询的距离数组
+        FIELDS,      ///< 正在写入当前查询的字段数组
+        EMBEDDINGS,  ///< 正在写入当前查询的命中向量数组
+        DONE         ///< 写入完毕
+    };
+
+    /**
+     * @brief 判断指定查询是否有有效结果
+     * @param query 查询下标
+     * @return 有有效结果返回true
+     */
+    bool hasValidResult(size_t query) const;
+
+    /**
+     * @brief 当前数组写完后，开始下一个需要输出的附加数组，没有时结束当前查询
+     * @param next 候选的下一个状态（FIELDS、EMBEDDINGS 或 QUERY_BEGIN）
+     */
+    void beginNextArray(Stage next);
+
+    std::pair<std::vector<long>, std::vector<float>> results; ///< 搜索结果
+    size_t numQueries;                                        ///< 查询数量
+    size_t k;                                                 ///< 每个查询的结果数量
+    bool isBatch;                                             ///< 是否使用批量查询的响应格式
+    SearchHitPayload payload;                                 ///< 随结果返回的附加数据
+    rapidjson::Writer<rapidjson::StringBuffer> writer;        ///< JSON写入器
+    Stage stage = Stage::BEGIN;                               ///< 当前写入状态
+    size_t query = 0;                                         ///< 当前查询下标
+    size_t position = 0;                                      ///< 当前查询中下一个待写入的位置
+    bool partial = false;                                     ///< 是否为超时返回的部分结果
+    bool hasPlan = false;                                     ///< 是否输出执行计划
+    SearchPlan plan;                                          ///< 执行计划
+};
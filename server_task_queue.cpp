@@ -0,0 +1,226 @@
+/**
+ * @file server_task_queue.cpp
+ * @brief HTTP服务器任务队列实现文件
+ */
+
+#include "server_task_queue.h"
+#include <algorithm>
+
+namespace
+{
+    thread_local bool tlsShedding = false;         ///< 当前线程是否为降载线程
+    thread_local uint64_t tlsQueueWaitMicros = 0;  ///< 当前连接在队列中的等待时间
+}
+
+/**
+ * @brief 构造函数
+ * @param numThreads 工作线程数量
+ * @param maxQueued 最多允许排队的连接数
+ * @param numShedThreads 降载线程数量
+ * @param maxShedQueued 最多允许等待降载线程的连接数
+ * @param stats 运行统计
+ */
+BoundedTaskQueue::BoundedTaskQueue(size_t numThreads, size_t maxQueued, size_t numShedThreads,
+                                   size_t maxShedQueued, TaskQueueStats *stats)
+    : maxQueued(maxQueued), maxShedQueued(std::max<size_t>(maxShedQueued, 1)), stopping(false), stats(stats)
+{
+    for (size_t i = 0; i < std::max<size_t>(numThreads, 1); ++i)
+    {
+        workers.emplace_back([this]
+                             { workerLoop(); });
+    }
+    for (size_t i = 0; i < std::max<size_t>(numShedThreads, 1); ++i)
+    {
+        shedWorkers.emplace_back([this]
+                                 { shedLoop(); });
+    }
+}
+
+/**
+ * @brief 投递一个连接处理任务
+ * @param fn 任务
+ *
+ * 排队的连接数达到上限时，任务改为交给降载线程；降载队列也已满时在这里等待空位。
+ * 任务持有已接受的连接，不能丢弃，等待期间 httplib 不再接受新连接
+ */
+void BoundedTaskQueue::enqueue(std::function<void()> fn)
+{
+    bool shed = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (tasks.size() >= maxQueued)
+        {
+            if (shedTasks.size() >= maxShedQueued)
+            {
+                stats->shedBlocked++;
+                shedSpaceCond.wait(lock, [this]
+                                   { return stopping || shedTasks.size() < maxShedQueued; });
+            }
+            shedTasks.push_back(std::move(fn));
+            stats->shedQueued.store(shedTasks.size());
+            shed = true;
+        }
+        else
+        {
+            tasks.push_back(Task{std::move(fn), std::chrono::steady_clock::now()});
+            stats->queued.store(tasks.size());
+        }
+    }
+
+    if (shed)
+    {
+        stats->shed++;
+        shedCond.notify_one();
+    }
+    else
+    {
+        cond.notify_one();
+    }
+}
+
+/**
+ * @brief 停止所有线程，等待已投递的任务执行完毕
+ */
+void BoundedTaskQueue::shutdown()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    shedCond.notify_all();
+    shedSpaceCond.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    for (auto &worker : shedWorkers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * @brief 工作线程主循环
+ * @details 取出任务时记录其排队时间，供统计和请求处理函数使用
+ */
+void BoundedTaskQueue::workerLoop()
+{
+    for (;;)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]
+                      { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+            {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            stats->queued.store(tasks.size());
+        }
+
+        // 记录排队时间
+        uint64_t waitMicros = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - task.enqueueTime)
+                .count());
+        tlsQueueWaitMicros = waitMicros;
+        stats->executed++;
+        stats->totalWaitMicros += waitMicros;
+        stats->waitLatency.record(waitMicros);
+        uint64_t maxWait = stats->maxWaitMicros.load();
+        while (waitMicros > maxWait &&
+               !stats->maxWaitMicros.compare_exchange_weak(maxWait, waitMicros))
+        {
+        }
+
+        stats->active++;
+        task.fn();
+        stats->active--;
+    }
+}
+
+/**
+ * @brief 降载线程主循环
+ * @details 降载线程上处理的请求会被前置路由处理器直接拒绝，因此这里只需依次执行任务
+ */
+void BoundedTaskQueue::shedLoop()
+{
+    tlsShedding = true;
+    for (;;)
+    {
+        std::function<void()> fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            shedCond.wait(lock, [this]
+                          { return stopping || !shedTasks.empty(); });
+            if (stopping && shedTasks.empty())
+            {
+                return;
+            }
+            fn = std::move(shedTasks.front());
+            shedTasks.pop_front();
+            stats->shedQueued.store(shedTasks.size());
+        }
+        shedSpaceCond.notify_one();
+        fn();
+    }
+}
+
+/**
+ * @brief 当前线程是否为降载线程
+ * @return 在降载线程上调用时返回true
+ */
+bool BoundedTaskQueue::isShedding()
+{
+    return tlsShedding;
+}
+
+/**
+ * @brief 取出当前线程正在处理的连接在队列中的等待时间
+ * @return 等待时间（微秒），同一连接上的后续请求返回0
+ */
+uint64_t BoundedTaskQueue::takeQueueWaitMicros()
+{
+    uint64_t waitMicros = tlsQueueWaitMicros;
+    tlsQueueWaitMicros = 0;
+    return waitMicros;
+}
+
+/**
+ * @brief 构造函数
+ * @param limit 同时处理的最大请求数
+ */
+ConcurrencyLimiter::ConcurrencyLimiter(size_t limit) : limit(limit)
+{
+}
+
+/**
+ * @brief 尝试占用一个并发名额
+ * @return 成功返回true；已达上限时返回false
+ */
+bool ConcurrencyLimiter::tryAcquire()
+{
+    size_t current = inFlight.load();
+    while (current < limit)
+    {
+        if (inFlight.compare_exchange_weak(current, current + 1))
+        {
+            return true;
+        }
+    }
+    rejected++;
+    return false;
+}
+
+/**
+ * @brief 释放一个并发名额
+ */
+void ConcurrencyLimiter::release()
+{
+    inFlight--;
+}
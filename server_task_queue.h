@@ -0,0 +1,162 @@
+/**
+ * @file server_task_queue.h
+ * @brief HTTP服务器任务队列头文件
+ * @details 替换 httplib 默认的无界线程池：工作线程数量和排队深度可配置，
+ *          队列已满时把新连接交给降载线程快速返回503，降载线程的队列同样有上限，
+ *          并统计每个连接在队列中的等待时间。
+ */
+
+#pragma once
+
+#include "httplib/httplib.h"
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @struct TaskQueueStats
+ * @brief 任务队列的运行统计，所有字段均可无锁读取
+ */
+struct TaskQueueStats
+{
+    std::atomic<uint64_t> executed{0};         ///< 工作线程已开始处理的连接数
+    std::atomic<uint64_t> shed{0};             ///< 因队列已满被降载的连接数
+    std::atomic<uint64_t> totalWaitMicros{0};  ///< 所有连接在队列中等待的总时间（微秒）
+    std::atomic<uint64_t> maxWaitMicros{0};    ///< 单个连接在队列中等待的最长时间（微秒）
+    std::atomic<size_t> queued{0};             ///< 当前排队中的连接数
+    std::atomic<size_t> shedQueued{0};         ///< 当前等待降载线程的连接数
+    std::atomic<uint64_t> shedBlocked{0};      ///< 降载队列已满、接受线程等待的次数
+    std::atomic<size_t> active{0};             ///< 当前正在被工作线程处理的连接数
+    LatencyHistogram waitLatency;              ///< 每个连接在队列中等待时间的分布
+};
+
+/**
+ * @class BoundedTaskQueue
+ * @brief 有界的 httplib 任务队列
+ *
+ * httplib 为每个接受的连接投递一个任务，该任务负责读取请求、调用路由并关闭连接。
+ * 任务不能被丢弃（否则连接永远不会关闭），因此队列已满时任务被交给独立的降载线程执行，
+ * 降载线程上的请求由 HttpServer 的前置路由处理器直接返回503。
+ * 降载队列也有上限：两个队列都满时 enqueue 阻塞 httplib 的接受线程，直到降载线程取走任务，
+ * 此时新连接留在内核的监听队列中（超出 backlog 后被内核拒绝），内存占用不会随过载程度增长。
+ *
+ * 注意 httplib 的一个任务对应一个连接：长连接在其生命周期内一直占用同一个工作线程，
+ * 因此这里的排队深度限制的是等待工作线程的连接数。
+ */
+class BoundedTaskQueue : public httplib::TaskQueue
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param numThreads 工作线程数量
+     * @param maxQueued 最多允许排队的连接数
+     * @param numShedThreads 降载线程数量
+     * @param maxShedQueued 最多允许等待降载线程的连接数
+     * @param stats 运行统计，由调用方持有且生命周期长于队列
+     */
+    BoundedTaskQueue(size_t numThreads, size_t maxQueued, size_t numShedThreads, size_t maxShedQueued,
+                     TaskQueueStats *stats);
+
+    ~BoundedTaskQueue() override = default;
+
+    /**
+     * @brief 投递一个连接处理任务
+     * @param fn 任务
+     */
+    void enqueue(std::function<void()> fn) override;
+
+    /**
+     * @brief 停止所有线程，等待已投递的任务执行完毕
+     */
+    void shutdown() override;
+
+    /**
+     * @brief 当前线程是否为降载线程
+     * @return 在降载线程上调用时返回true
+     */
+    static bool isShedding();
+
+    /**
+     * @brief 取出当前线程正在处理的连接在队列中的等待时间
+     * @return 等待时间（微秒）
+     *
+     * 一个任务处理一个keep-alive连接上的所有请求，只有第一个请求经历了排队，
+     * 因此取出后清零，同一连接上的后续请求返回0
+     */
+    static uint64_t takeQueueWaitMicros();
+
+private:
+    /**
+     * @struct Task
+     * @brief 排队中的任务
+     */
+    struct Task
+    {
+        std::function<void()> fn;                          ///< 任务
+        std::chrono::steady_clock::time_point enqueueTime; ///< 入队时间
+    };
+
+    /**
+     * @brief 工作线程主循环
+     */
+    void workerLoop();
+
+    /**
+     * @brief 降载线程主循环
+     */
+    void shedLoop();
+
+    std::vector<std::thread> workers;                 ///< 工作线程
+    std::vector<std::thread> shedWorkers;             ///< 降载线程
+    std::deque<Task> tasks;                           ///< 等待工作线程的任务
+    std::deque<std::function<void()>> shedTasks;      ///< 等待降载线程的任务
+    std::mutex mutex;                                 ///< 保护两个任务队列的互斥锁
+    std::condition_variable cond;                     ///< 通知工作线程
+    std::condition_variable shedCond;                 ///< 通知降载线程
+    std::condition_variable shedSpaceCond;            ///< 通知等待降载队列空位的接受线程
+    size_t maxQueued;                                 ///< 最多允许排队的连接数
+    size_t maxShedQueued;                             ///< 最多允许等待降载线程的连接数
+    bool stopping;                                    ///< 是否正在退出
+    TaskQueueStats *stats;                            ///< 运行统计
+};
+
+/**
+ * @class ConcurrencyLimiter
+ * @brief 单个接口的并发上限
+ */
+class ConcurrencyLimiter
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param limit 同时处理的最大请求数
+     */
+    explicit ConcurrencyLimiter(size_t limit);
+
+    /**
+     * @brief 尝试占用一个并发名额
+     * @return 成功返回true；已达上限时返回false并计入被拒绝次数
+     */
+    bool tryAcquire();
+
+    /**
+     * @brief 释放一个并发名额
+     */
+    void release();
+
+    size_t getLimit() const { return limit; }
+    size_t getInFlight() const { return inFlight.load(); }
+    uint64_t getRejected() const { return rejected.load(); }
+
+private:
+    size_t limit;                     ///< 并发上限
+    std::atomic<size_t> inFlight{0};  ///< 正在处理的请求数
+    std::atomic<uint64_t> rejected{0}; ///< 因达到上限被拒绝的请求数
+};
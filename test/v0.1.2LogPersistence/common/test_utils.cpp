@@ -183,6 +183,14 @@ rapidjson::Document TestDataGenerator::create_upsert_data(uint64_t id, int dimen
     return create_test_vector_data(id, vectors, "FLAT", id % 5);
 }
 
+UpsertRequest TestDataGenerator::create_upsert_request(uint64_t id, int dimensions) {
+    auto data = create_upsert_data(id, dimensions);
+    UpsertRequest request;
+    std::string errorMsg;
+    decodeUpsertRequest(data, &request, &errorMsg);
+    return request;
+}
+
 rapidjson::Document TestDataGenerator::create_delete_data(uint64_t id, const std::string& index_type) {
     rapidjson::Document doc;
     doc.SetObject();
@@ -96,6 +96,7 @@ public:
     static std::vector<float> generate_random_vector(int dimensions);
     
     static rapidjson::Document create_upsert_data(uint64_t id, int dimensions = 3);
+    static UpsertRequest create_upsert_request(uint64_t id, int dimensions = 3);
     static rapidjson::Document create_delete_data(uint64_t id, const std::string& index_type = "FLAT");
     static rapidjson::Document create_query_data(uint64_t id);
 };
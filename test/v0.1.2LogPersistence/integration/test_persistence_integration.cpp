@@ -29,14 +29,14 @@ void test_complete_persistence_flow() {
         VectorDatabase db(dbPath, walPath);
         
         // 测试数据
-        auto testData1 = TestDataGenerator::create_upsert_data(100, 3);
-        auto testData2 = TestDataGenerator::create_upsert_data(200, 3);
-        auto testData3 = TestDataGenerator::create_upsert_data(300, 3);
+        auto testData1 = TestDataGenerator::create_upsert_request(100, 3);
+        auto testData2 = TestDataGenerator::create_upsert_request(200, 3);
+        auto testData3 = TestDataGenerator::create_upsert_request(300, 3);
         
         // 执行upsert操作
-        db.upsert(100, testData1, IndexFactory::IndexType::FLAT);
-        db.upsert(200, testData2, IndexFactory::IndexType::FLAT);
-        db.upsert(300, testData3, IndexFactory::IndexType::FLAT);
+        db.upsert(testData1);
+        db.upsert(testData2);
+        db.upsert(testData3);
         
         // 验证数据是否正确存储
         auto queryResult1 = db.query(100);
@@ -78,8 +78,8 @@ void test_database_recovery() {
         
         // 写入多条测试数据
         for (int i = 1; i <= 5; i++) {
-            auto data = TestDataGenerator::create_upsert_data(i, 3);
-            db.upsert(i, data, IndexFactory::IndexType::FLAT);
+            auto data = TestDataGenerator::create_upsert_request(i, 3);
+            db.upsert(data);
         }
         
         // 验证数据已正确写入
@@ -142,19 +142,19 @@ void test_mixed_operations_persistence() {
         // 执行混合操作：插入、更新、查询
         
         // 1. 插入数据
-        auto insertData1 = TestDataGenerator::create_upsert_data(100, 3);
-        auto insertData2 = TestDataGenerator::create_upsert_data(200, 3);
+        auto insertData1 = TestDataGenerator::create_upsert_request(100, 3);
+        auto insertData2 = TestDataGenerator::create_upsert_request(200, 3);
         
-        db.upsert(100, insertData1, IndexFactory::IndexType::FLAT);
-        db.upsert(200, insertData2, IndexFactory::IndexType::FLAT);
+        db.upsert(insertData1);
+        db.upsert(insertData2);
         
         // 2. 验证插入
         auto query1 = db.query(100);
         TEST_ASSERT(query1.HasMember("id"), "插入后应该能查询到数据");
         
         // 3. 更新数据
-        auto updateData = TestDataGenerator::create_upsert_data(100, 3);  // 相同ID，不同数据
-        db.upsert(100, updateData, IndexFactory::IndexType::FLAT);
+        auto updateData = TestDataGenerator::create_upsert_request(100, 3);  // 相同ID，不同数据
+        db.upsert(updateData);
         
         // 4. 验证更新
         auto query2 = db.query(100);
@@ -175,7 +175,10 @@ void test_mixed_operations_persistence() {
         searchRequest.AddMember("k", 2, allocator);
         searchRequest.AddMember("indexType", "FLAT", allocator);
         
-        auto searchResults = db.search(searchRequest);
+        SearchRequest request;
+        std::string errorMsg;
+        TEST_ASSERT(decodeSearchRequest(searchRequest, &request, &errorMsg), "搜索请求应该解码成功");
+        auto searchResults = db.search(request);
         TEST_ASSERT(searchResults.first.size() > 0, "搜索应该返回结果");
         
         TEST_ASSERT(true, "混合操作执行成功");
@@ -210,8 +213,8 @@ void test_large_scale_persistence() {
         
         // 批量插入数据
         for (int i = 1; i <= NUM_VECTORS; i++) {
-            auto data = TestDataGenerator::create_upsert_data(i, 128);  // 128维向量
-            db.upsert(i, data, IndexFactory::IndexType::FLAT);
+            auto data = TestDataGenerator::create_upsert_request(i, 128);  // 128维向量
+            db.upsert(data);
             
             // 每100个打印一次进度
             if (i % 100 == 0) {
@@ -266,8 +269,8 @@ void test_concurrent_access_consistency() {
         
         for (int i = 1; i <= NUM_OPERATIONS; i++) {
             // 写入操作
-            auto writeData = TestDataGenerator::create_upsert_data(i, 3);
-            db.upsert(i, writeData, IndexFactory::IndexType::FLAT);
+            auto writeData = TestDataGenerator::create_upsert_request(i, 3);
+            db.upsert(writeData);
             
             // 立即读取验证
             auto readData = db.query(i);
@@ -275,8 +278,8 @@ void test_concurrent_access_consistency() {
             TEST_ASSERT(readData["id"].GetInt() == i, "读取的数据应该与写入的一致");
             
             // 更新操作
-            auto updateData = TestDataGenerator::create_upsert_data(i, 3);
-            db.upsert(i, updateData, IndexFactory::IndexType::FLAT);
+            auto updateData = TestDataGenerator::create_upsert_request(i, 3);
+            db.upsert(updateData);
             
             // 再次读取验证
             auto updatedData = db.query(i);
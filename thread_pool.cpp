@@ -0,0 +1,187 @@
+/**
+ * @file thread_pool.cpp
+ * @brief 线程池实现文件
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+/**
+ * @brief 构造函数
+ * @param numThreads 工作线程数量，为0时使用硬件并发数
+ */
+ThreadPool::ThreadPool(size_t numThreads) : stopping(false)
+{
+    if (numThreads == 0)
+    {
+        // hardware_concurrency 在无法探测时返回0，此时至少保留一个线程
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        workers.emplace_back([this]
+                             { workerLoop(); });
+    }
+}
+
+/**
+ * @brief 析构函数
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * @brief 投递一个异步任务
+ * @param task 待执行的任务
+ */
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    cond.notify_one();
+}
+
+/**
+ * @brief 工作线程主循环
+ * @details 不断从任务队列中取出任务执行，直到线程池退出且队列为空
+ */
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this]
+                      { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+            {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+/**
+ * @brief 并行执行区间[begin, end)内的每个下标
+ * @param begin 起始下标（包含）
+ * @param end 结束下标（不包含）
+ * @param fn 对每个下标执行的函数
+ */
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &fn)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    // 只有一个下标时直接在调用线程执行，避免任务投递的开销
+    size_t total = end - begin;
+    if (total == 1)
+    {
+        fn(begin);
+        return;
+    }
+
+    // 共享状态使用shared_ptr管理：辅助任务可能在调用线程返回后才被调度，
+    // 此时它只会发现没有剩余下标并立即退出，不会访问已经失效的栈内存
+    struct SharedState
+    {
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+        size_t end;
+        std::function<void(size_t)> fn;
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<SharedState>();
+    state->next = begin;
+    state->done = 0;
+    state->end = end;
+    state->fn = fn;
+
+    // 动态领取下标并执行，直到区间耗尽
+    auto runner = [state, total]()
+    {
+        for (;;)
+        {
+            size_t index = state->next.fetch_add(1);
+            if (index >= state->end)
+            {
+                return;
+            }
+            try
+            {
+                state->fn(index);
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                if (!state->error)
+                {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->done.fetch_add(1) + 1 == total)
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->cond.notify_all();
+            }
+        }
+    };
+
+    // 调用线程自己也参与计算，所以最多只需要投递 total-1 个辅助任务
+    size_t helpers = std::min(workers.size(), total - 1);
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        enqueue(runner);
+    }
+    runner();
+
+    // 等待其他线程完成已领取的下标
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cond.wait(lock, [&]
+                         { return state->done.load() == total; });
+    }
+
+    if (state->error)
+    {
+        std::rethrow_exception(state->error);
+    }
+}
+
+/**
+ * @brief 获取工作线程数量
+ * @return 工作线程数量
+ */
+size_t ThreadPool::size() const
+{
+    return workers.size();
+}
+
+ThreadPool *getGlobalThreadPool()
+{
+    // 使用函数内静态变量延迟创建，避免与其他全局对象的初始化顺序产生依赖
+    static ThreadPool globalThreadPool;
+    return &globalThreadPool;
+}
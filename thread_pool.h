@@ -0,0 +1,87 @@
+/**
+ * @file thread_pool.h
+ * @brief 线程池头文件
+ * @details 提供一个固定大小的工作线程池，用于把批量查询、批量插入等
+ *          可并行的计算任务分摊到多个CPU核心上执行
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief 固定大小的线程池
+ *
+ * 该类维护一组常驻的工作线程和一个任务队列，提供以下功能：
+ * 1. enqueue：投递一个异步任务
+ * 2. parallelFor：把一个下标区间拆分到多个线程上并行执行，并等待全部完成
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param numThreads 工作线程数量，为0时使用硬件并发数
+     */
+    explicit ThreadPool(size_t numThreads = 0);
+
+    /**
+     * @brief 析构函数
+     * @details 通知所有工作线程退出并等待其结束
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief 投递一个异步任务
+     * @param task 待执行的任务
+     */
+    void enqueue(std::function<void()> task);
+
+    /**
+     * @brief 并行执行区间[begin, end)内的每个下标
+     * @param begin 起始下标（包含）
+     * @param end 结束下标（不包含）
+     * @param fn 对每个下标执行的函数
+     *
+     * 调用线程本身也会参与计算，下标通过原子计数器动态领取，
+     * 因此即使在工作线程内部嵌套调用也不会死锁。
+     * 任一下标执行时抛出的第一个异常会在调用线程中重新抛出。
+     */
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &fn);
+
+    /**
+     * @brief 获取工作线程数量
+     * @return 工作线程数量
+     */
+    size_t size() const;
+
+private:
+    /**
+     * @brief 工作线程主循环
+     */
+    void workerLoop();
+
+    std::vector<std::thread> workers;         ///< 工作线程
+    std::deque<std::function<void()>> tasks;  ///< 待执行的任务队列
+    std::mutex mutex;                         ///< 保护任务队列的互斥锁
+    std::condition_variable cond;             ///< 任务到达/退出通知
+    bool stopping;                            ///< 线程池是否正在退出
+};
+
+/**
+ * @brief 获取全局唯一的线程池实例
+ * @return 返回全局线程池对象的指针
+ *
+ * 线程池在第一次调用时按硬件并发数创建。
+ */
+ThreadPool *getGlobalThreadPool();
@@ -4,6 +4,7 @@
  * @details 实现向量数据库服务器的启动和初始化流程
  */
 
+#include "constants.h"
 #include "http_server.h"
 #include "index_factory.h"
 #include "logger.h"
@@ -26,13 +27,13 @@
 int main(int argc, char* argv[]) {
     // 初始化全局日志系统
     initGlobalLogger();
-    // 设置日志级别为debug，用于开发调试
-    setLogLevel(spdlog::level::debug);
+    // 设置日志级别为info；调试日志需要同时以 LOG_LEVEL=SPDLOG_LEVEL_DEBUG 编译才会输出
+    setLogLevel(spdlog::level::info);
     globalLogger->info("Global logger initialized");
 
-    // 设置向量维度
+    // 设置默认集合的向量维度；其他维度的嵌入通过 /admin/collections 创建命名集合
     int dim = 1;
-    // 设置hnsw索引能容纳的最大向量数量
+    // 设置hnsw索引的初始容量，写满后按 HNSW_GROWTH_FACTOR 自动扩容
     int numData = 1000;
     
     // 获取全局索引工厂实例
@@ -47,6 +48,8 @@ int main(int argc, char* argv[]) {
     globalIndexFactory->init(IndexFactory::IndexType::FLAT, dim);
     // 初始化HNSW类型的索引
     globalIndexFactory->init(IndexFactory::IndexType::HNSW, dim, numData);
+    // 初始化IVF类型的索引，训练之前写入的向量暂存在缓冲区中
+    globalIndexFactory->init(IndexFactory::IndexType::IVF, dim);
     // 初始化FILTER类型的索引
     globalIndexFactory->init(IndexFactory::IndexType::FILTER);
     globalLogger->info("Global index factory initialized");
@@ -70,8 +73,35 @@ int main(int argc, char* argv[]) {
     vectorDatabase.reloadDatabase();
     globalLogger->info("VectorDatabase initialized");
 
+    // 缓存热门查询的搜索结果，写入索引时自动失效
+    if (SEARCH_CACHE_MAX_BYTES > 0) {
+        vectorDatabase.enableSearchCache(SEARCH_CACHE_MAX_BYTES);
+        globalLogger->info("Search result cache enabled");
+    }
+
+    // 高并发下把同参数的FLAT单查询合并成一次批量搜索
+    if (SEARCH_BATCH_ENABLED) {
+        vectorDatabase.enableSearchBatching(SEARCH_BATCH_WINDOW_MICROS, SEARCH_BATCH_MAX_QUERIES);
+        globalLogger->info("FLAT search batching enabled");
+    }
+
+    // 配置HTTP服务器的并发与降载策略：
+    // 排队的连接超过上限时直接返回503，单个接口并发超过上限时返回429，
+    // 让负载均衡器尽快把流量转到其他副本，而不是在本机无限排队
+    HttpServerOptions serverOptions;
+    serverOptions.workerThreads = HTTP_WORKER_THREADS;
+    serverOptions.maxQueuedConnections = HTTP_MAX_QUEUED_CONNECTIONS;
+    serverOptions.shedThreads = HTTP_SHED_THREADS;
+    serverOptions.maxShedConnections = HTTP_MAX_SHED_CONNECTIONS;
+    serverOptions.endpointConcurrencyLimits["/search"] = 64;
+    serverOptions.endpointConcurrencyLimits["/upsert"] = 32;
+    serverOptions.endpointConcurrencyLimits["/delete"] = 32;
+    serverOptions.endpointConcurrencyLimits["/bulk_upsert"] = 2;
+    // 搜索和更新请求超过阈值时输出各阶段耗时，便于定位慢请求
+    serverOptions.slowRequestThresholdMillis = SLOW_REQUEST_THRESHOLD_MS;
+
     // 创建HTTP服务器实例，监听本地9729端口
-    HttpServer http_server("localhost", 9729, &vectorDatabase);
+    HttpServer http_server("localhost", 9729, &vectorDatabase, serverOptions);
     globalLogger->info("HTTP server created");
     // 启动HTTP服务器
     http_server.start();
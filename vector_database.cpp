@@ -5,8 +5,9 @@
  * 该文件实现了向量数据库的核心功能，包括：
  * 1. 向量的插入和更新（upsert）
  * 2. 向量的查询
- * 3. 支持多种索引类型（FLAT和HNSW）
+ * 3. 支持多种索引类型（FLAT、HNSW和IVF）
  * 4. 与标量存储的集成
+ * 5. 命名集合的创建、恢复和请求路由
  */
 
 #include "constants.h"
@@ -16,234 +17,1105 @@
 #include "faiss_index.h"
 #include "hnswlib_index.h"
 #include "filter_index.h"
+#include "ivf_index.h"
 #include "http_server.h"
+#include "request_timing.h"
+#include "search_response.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+namespace
+{
+    /**
+     * @brief 按过滤位图筛选后过滤搜索的候选
+     * @param candidates 不带过滤条件的搜索结果，每个查询占candidateK个位置
+     * @param numQueries 查询数量
+     * @param candidateK 每个查询的候选数量
+     * @param k 每个查询返回的最近邻数量
+     * @param bitmap 过滤位图
+     * @param minHits 每个查询至少需要的结果数
+     * @param results 输出参数，每个查询占k个位置的结果
+     * @return 所有查询都找到minHits个结果时返回true
+     */
+    bool filterCandidates(const std::pair<std::vector<long>, std::vector<float>> &candidates,
+                          size_t numQueries, size_t candidateK, size_t k,
+                          const roaring_bitmap_t *bitmap, size_t minHits,
+                          std::pair<std::vector<long>, std::vector<float>> *results)
+    {
+        results->first.assign(numQueries * k, -1);
+        results->second.assign(numQueries * k, std::numeric_limits<float>::max());
+        bool enough = true;
+        for (size_t q = 0; q < numQueries; q++)
+        {
+            size_t hits = 0;
+            for (size_t i = q * candidateK; i < (q + 1) * candidateK && hits < k; i++)
+            {
+                long id = candidates.first[i];
+                if (id >= 0 && id <= std::numeric_limits<uint32_t>::max() &&
+                    roaring_bitmap_contains(bitmap, static_cast<uint32_t>(id)))
+                {
+                    results->first[q * k + hits] = id;
+                    results->second[q * k + hits] = candidates.second[i];
+                    hits++;
+                }
+            }
+            enough = enough && hits >= minHits;
+        }
+        return enough;
+    }
+}
+
 /**
  * @brief 构造函数
  * @param dbPath 数据库存储路径
  */
 VectorDatabase::VectorDatabase(const std::string &dbPath, const std::string &walLogPath)
-    : scalarStorage(dbPath)
+    : scalarStorage(dbPath), defaultCollection(DEFAULT_COLLECTION_NAME, getGlobalIndexFactory())
 {
     persistence.init(walLogPath);
+    // 集合必须在加载快照和重放WAL日志之前创建
+    loadCollections();
+}
+
+/**
+ * @brief 创建命名集合
+ * @param config 集合配置
+ * @param errorMsg 输出参数，创建失败时的错误信息
+ * @return 创建成功返回true
+ */
+bool VectorDatabase::createCollection(const CollectionConfig &config, std::string *errorMsg)
+{
+    std::unique_lock<std::shared_mutex> lock(collectionsMutex);
+    if (collections.count(config.name) > 0)
+    {
+        *errorMsg = "Collection already exists: " + config.name;
+        return false;
+    }
+    collections[config.name] = std::make_unique<Collection>(config);
+    saveCollections();
+    return true;
+}
+
+/**
+ * @brief 按名称获取集合
+ * @param name 集合名
+ * @return 集合不存在时返回nullptr
+ */
+Collection *VectorDatabase::getCollection(const std::string &name) const
+{
+    if (name.empty() || name == DEFAULT_COLLECTION_NAME)
+    {
+        return const_cast<Collection *>(&defaultCollection);
+    }
+    std::shared_lock<std::shared_mutex> lock(collectionsMutex);
+    auto it = collections.find(name);
+    return it == collections.end() ? nullptr : it->second.get();
+}
+
+/**
+ * @brief 获取所有集合
+ * @return 默认集合在前，其余按集合名排序
+ */
+std::vector<Collection *> VectorDatabase::getCollections() const
+{
+    std::vector<Collection *> result;
+    result.push_back(const_cast<Collection *>(&defaultCollection));
+    std::shared_lock<std::shared_mutex> lock(collectionsMutex);
+    for (const auto &entry : collections)
+    {
+        result.push_back(entry.second.get());
+    }
+    return result;
+}
+
+/**
+ * @brief 按名称获取集合，集合不存在时抛出异常
+ * @param name 集合名
+ * @return 集合
+ */
+Collection *VectorDatabase::requireCollection(const std::string &name) const
+{
+    Collection *collection = getCollection(name);
+    if (collection == nullptr)
+    {
+        throw std::runtime_error("Collection not found: " + name);
+    }
+    return collection;
+}
+
+/**
+ * @brief 从标量存储中恢复已创建的命名集合
+ *
+ * 所有集合的配置以一个JSON数组保存在 COLLECTIONS_STORAGE_KEY 下
+ */
+void VectorDatabase::loadCollections()
+{
+    rapidjson::Document configs;
+    std::string text = scalarStorage.get(COLLECTIONS_STORAGE_KEY);
+    if (text.empty())
+    {
+        return;
+    }
+    configs.Parse(text.c_str(), text.size());
+    if (!configs.IsArray())
+    {
+        globalLogger->error("Invalid collection configs in scalar storage");
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(collectionsMutex);
+    for (const auto &json : configs.GetArray())
+    {
+        CollectionConfig config;
+        std::string errorMsg;
+        if (!decodeCollectionConfig(json, &config, &errorMsg))
+        {
+            globalLogger->error("Skip invalid collection config: {}", errorMsg);
+            continue;
+        }
+        collections[config.name] = std::make_unique<Collection>(config);
+    }
+    globalLogger->info("Loaded {} collections", collections.size());
+}
+
+/**
+ * @brief 把所有命名集合的配置写入标量存储
+ */
+void VectorDatabase::saveCollections()
+{
+    rapidjson::Document configs;
+    configs.SetArray();
+    for (const auto &entry : collections)
+    {
+        rapidjson::Value json;
+        encodeCollectionConfig(entry.second->getConfig(), &json, configs.GetAllocator());
+        configs.PushBack(json, configs.GetAllocator());
+    }
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    configs.Accept(writer);
+    scalarStorage.put(COLLECTIONS_STORAGE_KEY, std::string(buffer.GetString(), buffer.GetSize()));
+}
+
+/**
+ * @brief 获取命名集合的索引工厂
+ * @return 集合名到索引工厂的映射，不包含默认集合
+ */
+std::map<std::string, IndexFactory *> VectorDatabase::getCollectionIndexes() const
+{
+    std::map<std::string, IndexFactory *> collectionIndexes;
+    std::shared_lock<std::shared_mutex> lock(collectionsMutex);
+    for (const auto &entry : collections)
+    {
+        collectionIndexes[entry.first] = entry.second->getIndexFactory();
+    }
+    return collectionIndexes;
 }
 
 /**
  * @brief 插入或更新向量数据
- * @param id 向量ID
- * @param data 包含向量数据的JSON文档
- * @param indexType 索引类型（FLAT或HNSW）
+ * @param request 解码后的插入或更新请求
+ * @param logToWAL 是否写入WAL日志
  *
  * 该函数执行以下操作：
  * 1. 检查向量是否已存在
- * 2. 如果存在，从索引中删除旧向量
- * 3. 将新向量插入到索引中
- * 4. 更新过滤索引
- * 5. 更新标量存储中的数据
+ * 2. 将新向量写入索引，已存在的向量原地替换
+ * 3. 更新过滤索引
+ * 4. 更新标量存储中的数据
+ * 5. 写入WAL日志
+ * 整个过程持有所属集合的写入锁，使同一集合的写入互斥，同一ID的两次写入在日志中的顺序与生效顺序一致；
+ * 搜索不需要该锁，各索引自身保证并发读写的安全（见 faiss_index.h、filter_index.h）
  */
-void VectorDatabase::upsert(uint64_t id, const rapidjson::Document &data,
-                            IndexFactory::IndexType indexType)
+void VectorDatabase::upsert(const UpsertRequest &request, bool logToWAL)
 {
-    // 打印插入或更新请求的内容
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    data.Accept(writer);
-    globalLogger->info("Upsert data: {}", buffer.GetString());
+    uint64_t id = request.id;
+    IndexFactory::IndexType indexType = request.indexType;
+    Collection *collection = requireCollection(request.collection);
+    IndexFactory *indexFactory = collection->getIndexFactory();
+    std::lock_guard<std::mutex> writeLock(collection->getWriteMutex());
 
     // 检查标量存储中是否存在指定id的向量
     rapidjson::Document existingData;
     try
     {
-        existingData = scalarStorage.getScalar(id);
+        ScopedStageTimer storageTimer(TimingStage::STORAGE);
+        existingData = scalarStorage.getScalar(id, collection->getKeyPrefix());
     }
     catch (const std::runtime_error &e)
     {
         // 如果向量不存在，记录日志，继续执行插入操作
-        globalLogger->info("向量不存在于标量存储中，继续执行插入操作");
+        LOG_DEBUG("向量不存在于标量存储中，继续执行插入操作");
     }
 
-    // 如果向量存在，则从索引中删除它
-    if (existingData.IsObject())
+    // 向量索引和过滤索引的更新计入同一个阶段
+    bool filterChanged = false;
     {
-        // 打印删除旧向量的日志
-        globalLogger->info("try to remove old index");
-        // 从JSON数据中提取vectors字段得到向量
-        std::vector<float> existingVector(existingData["vectors"].Size());
-        for (rapidjson::SizeType i = 0; i < existingData["vectors"].Size(); i++)
-        {
-            existingVector[i] = existingData["vectors"][i].GetFloat();
-        }
+        ScopedStageTimer indexTimer(TimingStage::INDEX);
+
+        // 打印添加新向量的日志
+        LOG_DEBUG("try to add new index");
 
-        // 根据索引类型选择相应的删除操作
-        void *index = getGlobalIndexFactory()->getIndex(indexType);
+        // 根据索引类型选择相应的写入操作，已存在的向量在索引内原地替换，
+        // 并发的搜索不会看到旧向量已删除、新向量尚未写入的中间状态
+        void *index = indexFactory->getIndex(indexType);
         switch (indexType)
         {
         case IndexFactory::IndexType::FLAT:
         {
             FaissIndex *faissIndex = static_cast<FaissIndex *>(index);
-            faissIndex->removeVectors({static_cast<long>(id)});
+            faissIndex->upsertVectors(request.vector, {static_cast<long>(id)});
             break;
         }
         case IndexFactory::IndexType::HNSW:
         {
+            // hnswlib 对已存在的标签会原地更新向量，无需先删除
             HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(index);
-            // hnswIndex->removeVectors({static_cast<long>(id)});
+            hnswIndex->insertVectors(request.vector, id);
+            break;
+        }
+        case IndexFactory::IndexType::IVF:
+        {
+            IVFIndex *ivfIndex = static_cast<IVFIndex *>(index);
+            ivfIndex->upsertVectors(request.vector, {static_cast<long>(id)});
             break;
         }
         default:
             break;
         }
+
+        // 打印添加新过滤器的日志
+        LOG_DEBUG("try to add new filter");
+        std::vector<FilterIndex::IntFieldUpdate> filterUpdates;
+        collectFilterUpdates(request, existingData, &filterUpdates);
+        filterChanged = !filterUpdates.empty();
+        static_cast<FilterIndex *>(indexFactory->getIndex(IndexFactory::IndexType::FILTER))
+            ->updateIntFieldFilters(filterUpdates);
     }
 
-    // 从JSON数据中提取新向量的数据插入索引
-    std::vector<float> newVector(data["vectors"].Size());
-    for (rapidjson::SizeType i = 0; i < data["vectors"].Size(); i++)
+    // 更新标量存储中的向量数据
     {
-        newVector[i] = data["vectors"][i].GetFloat();
+        ScopedStageTimer storageTimer(TimingStage::STORAGE);
+        scalarStorage.insertScalar(id, request.record, collection->getKeyPrefix());
     }
 
-    // 打印添加新向量的日志
-    globalLogger->info("try to add new index");
+    if (logToWAL)
+    {
+        ScopedStageTimer walTimer(TimingStage::WAL);
+        writeWALLog("upsert", request);
+    }
 
-    // 根据索引类型选择相应的插入操作
-    void *index = getGlobalIndexFactory()->getIndex(indexType);
-    switch (indexType)
+    // 索引已修改，使缓存的搜索结果失效；过滤索引实际发生变化时带过滤条件的结果也失效
+    if (searchCache)
     {
-    case IndexFactory::IndexType::FLAT:
+        searchCache->invalidate(indexType, filterChanged);
+    }
+}
+
+/**
+ * @brief 根据新写入的数据收集过滤索引的更新
+ * @param request 新写入的请求
+ * @param existingData 标量存储中已有的旧数据（不存在时为空文档）
+ * @param updates 输出参数，追加该请求对应的过滤条件更新
+ *
+ * 对新数据中每个int类型字段（id除外），把ID从旧值的位图移到新值的位图中；
+ * 旧数据中有而新数据中没有的int字段，把ID从旧值的位图中移除。值没有变化的字段不产生更新，
+ * 因此更新列表为空时过滤索引没有变化
+ */
+void VectorDatabase::collectFilterUpdates(const UpsertRequest &request, const rapidjson::Value &existingData,
+                                          std::vector<FilterIndex::IntFieldUpdate> *updates)
+{
+    // int 类型字段已在解码请求时收集好
+    for (const auto &field : request.intFields)
     {
-        FaissIndex *faissIndex = static_cast<FaissIndex *>(index);
-        faissIndex->insertVectors(newVector, id);
-        break;
+        const std::string &fieldName = field.first;
+        FilterIndex::IntFieldUpdate update{fieldName, false, 0, field.second, request.id};
+        // 如果现有数据中也有该 int 类型字段，则从 FilterIndex 中更新
+        if (existingData.IsObject() && existingData.HasMember(fieldName.c_str()) &&
+            existingData[fieldName.c_str()].IsInt64())
+        {
+            update.hasOldValue = true;
+            update.oldValue = existingData[fieldName.c_str()].GetInt64();
+            if (update.oldValue == update.newValue)
+            {
+                continue;
+            }
+        }
+        updates->push_back(update);
     }
-    case IndexFactory::IndexType::HNSW:
+
+    // 与写入时收集的字段一致：id以外的int字段（见 decodeUpsertRequest）
+    if (!existingData.IsObject())
     {
-        HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(index);
-        hnswIndex->insertVectors(newVector, id);
-        break;
+        return;
     }
-    default:
-        break;
+    for (auto it = existingData.MemberBegin(); it != existingData.MemberEnd(); ++it)
+    {
+        if (!it->value.IsInt() || std::strcmp(it->name.GetString(), REQUEST_ID) == 0)
+        {
+            continue;
+        }
+        std::string fieldName(it->name.GetString(), it->name.GetStringLength());
+        bool kept = std::any_of(request.intFields.begin(), request.intFields.end(),
+                                [&](const std::pair<std::string, int64_t> &field)
+                                { return field.first == fieldName; });
+        if (!kept)
+        {
+            updates->push_back({fieldName, true, it->value.GetInt64(), 0, request.id, false});
+        }
+    }
+}
+
+/**
+ * @brief 批量插入或更新向量数据
+ * @param requests 解码后的插入或更新请求
+ * @param logToWAL 是否把实际写入的记录写入WAL日志
+ * @return 实际写入的记录数量
+ *
+ * 请求先按集合分组，每个集合的记录分别写入（见 bulkUpsertCollection），
+ * 集合不存在的记录被跳过
+ */
+size_t VectorDatabase::bulkUpsert(const std::vector<UpsertRequest> &requests, bool logToWAL)
+{
+    // 按集合分组，组内保持请求的原有顺序
+    std::map<std::string, std::vector<const UpsertRequest *>> groups;
+    for (const UpsertRequest &request : requests)
+    {
+        groups[request.collection.empty() ? DEFAULT_COLLECTION_NAME : request.collection].push_back(&request);
+    }
+
+    size_t applied = 0;
+    for (const auto &group : groups)
+    {
+        Collection *collection = getCollection(group.first);
+        if (collection == nullptr)
+        {
+            globalLogger->error("Bulk upsert skipped {} records: collection {} not found",
+                                group.second.size(), group.first);
+            continue;
+        }
+        applied += bulkUpsertCollection(collection, logToWAL, group.second);
+    }
+
+    LOG_DEBUG("Bulk upsert applied {} of {} records", applied, requests.size());
+    return applied;
+}
+
+/**
+ * @brief 把同一集合的一批请求写入该集合
+ * @param collection 集合
+ * @param logToWAL 是否把实际写入的记录写入WAL日志
+ * @param requests 批次中属于该集合的请求
+ * @return 实际写入的记录数量
+ *
+ * 与逐条调用 upsert 相比，一个批次内：
+ * 1. FLAT 索引的旧向量通过一次 remove_ids 删除，新向量通过一次 add_with_ids 写入
+ * 2. HNSW 索引的新向量分发到线程池并行插入
+ * 3. 标量数据通过一个 RocksDB WriteBatch 写入
+ * 同一批次内重复的ID只保留最后一条记录，整个过程持有集合的写入锁。
+ * 没有向量索引的记录（例如 /upsert 时未指定indexType）与 upsert 一样只写入标量数据和过滤条件，
+ * WAL重放时不会丢失。WAL日志只包含实际写入的记录，重放时不会写入当时被跳过的记录
+ */
+size_t VectorDatabase::bulkUpsertCollection(Collection *collection, bool logToWAL,
+                                            const std::vector<const UpsertRequest *> &requests)
+{
+    IndexFactory *indexFactory = collection->getIndexFactory();
+    const std::string &keyPrefix = collection->getKeyPrefix();
+    std::lock_guard<std::mutex> writeLock(collection->getWriteMutex());
+
+    // 同一ID出现多次时，标量数据和过滤条件只取最后一条；向量按（ID, 索引类型）只取最后一条，
+    // 避免在索引中写入重复向量，同时与逐条 upsert 一样保留写入其他索引类型的向量
+    std::unordered_map<uint64_t, size_t> lastPosition;
+    std::map<std::pair<uint64_t, IndexFactory::IndexType>, size_t> lastVectorPosition;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        lastPosition[requests[i]->id] = i;
+        lastVectorPosition[{requests[i]->id, requests[i]->indexType}] = i;
     }
 
-    // 打印添加新过滤器的日志
-    globalLogger->info("try to add new filter");
+    // 按索引类型分组收集待写入的数据
+    struct IndexBatch
+    {
+        std::vector<long> labels;         ///< 新向量的ID
+        std::vector<float> vectors;       ///< 新向量数据（按维度依次拼接）
+    };
+    std::map<IndexFactory::IndexType, IndexBatch> batches;
+    // 批次中出现过的索引类型，包括没有向量索引的记录，用于使搜索缓存失效
+    std::set<IndexFactory::IndexType> writtenTypes;
 
-    FilterIndex *filterIndex = static_cast<FilterIndex *>(
-        getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::FILTER));
+    std::vector<const UpsertRequest *> accepted;       // 实际写入的记录（写入WAL日志）
+    std::vector<const UpsertRequest *> scalarRequests; // 每个ID最后一条实际写入的记录
+    std::vector<uint64_t> ids;
+    std::vector<const std::string *> records;
+    std::vector<rapidjson::Document> existingRecords;
+    accepted.reserve(lastVectorPosition.size());
+    scalarRequests.reserve(lastPosition.size());
+    ids.reserve(lastPosition.size());
+    records.reserve(lastPosition.size());
+    existingRecords.reserve(lastPosition.size());
 
-    // 检查客户写入的数据中是否有 int 类型的 JSON 字段
-    for (auto it = data.MemberBegin(); it != data.MemberEnd(); ++it)
+    for (size_t i = 0; i < requests.size(); i++)
     {
-        std::string fieldName = it->name.GetString();
-        globalLogger->debug("try to filter member {} {}",
-                            it->value.IsInt(), fieldName);
-        // 如果字段是int类型，则添加到过滤器中
-        if (it->value.IsInt() && fieldName != "id")
+        const UpsertRequest &request = *requests[i];
+        uint64_t id = request.id;
+        IndexFactory::IndexType indexType = request.indexType;
+        bool lastForId = lastPosition[id] == i;
+        bool lastForIndex = lastVectorPosition[{id, indexType}] == i;
+        if (!lastForId && !lastForIndex)
+        {
+            continue;
+        }
+
+        void *index = indexFactory->getIndex(indexType);
+        // 与 upsert 一样，没有向量索引的记录只写入标量数据和过滤条件
+        bool hasVectorIndex = index != nullptr && indexType != IndexFactory::IndexType::FILTER;
+        if (!lastForId && !hasVectorIndex)
         {
-            int64_t fieldValue = it->value.GetInt64();
-            int64_t *oldFieldValuePointer = nullptr;
-            // 如果存在现有向量，则从 FilterIndex 中更新 int 类型字段
-            if (existingData.IsObject())
+            continue;
+        }
+
+        if (hasVectorIndex && lastForIndex)
+        {
+            // 向量维度必须与索引维度一致，否则会破坏批量写入时的数据对齐
+            int dim = 0;
+            switch (indexType)
             {
-                oldFieldValuePointer = (int64_t *)malloc(sizeof(int64_t));
-                *oldFieldValuePointer = existingData[fieldName.c_str()].GetInt64();
+            case IndexFactory::IndexType::FLAT:
+                dim = static_cast<FaissIndex *>(index)->getDim();
+                break;
+            case IndexFactory::IndexType::HNSW:
+                dim = static_cast<HNSWLibIndex *>(index)->getDim();
+                break;
+            case IndexFactory::IndexType::IVF:
+                dim = static_cast<IVFIndex *>(index)->getDim();
+                break;
+            default:
+                break;
             }
-            filterIndex->updateIntFieldFilter(fieldName, oldFieldValuePointer,
-                                              fieldValue, id);
-            if (oldFieldValuePointer)
+            if (request.vector.size() != static_cast<size_t>(dim))
             {
-                free(oldFieldValuePointer);
+                globalLogger->error("Bulk upsert skipped id {}: vector dimension {} != {}",
+                                    id, request.vector.size(), dim);
+                continue;
             }
+
+            IndexBatch &batch = batches[indexType];
+            batch.vectors.insert(batch.vectors.end(), request.vector.begin(), request.vector.end());
+            batch.labels.push_back(static_cast<long>(id));
+        }
+
+        writtenTypes.insert(indexType);
+        accepted.push_back(&request);
+        if (lastForId)
+        {
+            scalarRequests.push_back(&request);
+            ids.push_back(id);
+            records.push_back(&request.record);
         }
     }
 
-    // 更新标量存储中的向量数据
-    scalarStorage.insertScalar(id, data);
+    // 一次批量读取检查标量存储中已存在的记录
+    std::vector<std::string> existingTexts = scalarStorage.getScalarRecords(ids, keyPrefix);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        existingRecords.emplace_back();
+        if (existingTexts[i].empty())
+        {
+            continue;
+        }
+        existingRecords.back().Parse(existingTexts[i].c_str(), existingTexts[i].size());
+    }
+
+    // 每种索引类型只调用一次批量写入，已存在的向量在索引内原地替换
+    for (auto &entry : batches)
+    {
+        IndexBatch &batch = entry.second;
+        void *index = indexFactory->getIndex(entry.first);
+        switch (entry.first)
+        {
+        case IndexFactory::IndexType::FLAT:
+        {
+            FaissIndex *faissIndex = static_cast<FaissIndex *>(index);
+            faissIndex->upsertVectors(batch.vectors, batch.labels);
+            break;
+        }
+        case IndexFactory::IndexType::HNSW:
+        {
+            // hnswlib 对已存在的标签会原地更新向量，无需先删除
+            HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(index);
+            hnswIndex->insertVectors(batch.vectors, batch.labels);
+            break;
+        }
+        case IndexFactory::IndexType::IVF:
+        {
+            IVFIndex *ivfIndex = static_cast<IVFIndex *>(index);
+            ivfIndex->upsertVectors(batch.vectors, batch.labels);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // 整批的过滤条件一起发布，每个受影响的位图只复制一次
+    std::vector<FilterIndex::IntFieldUpdate> filterUpdates;
+    for (size_t i = 0; i < scalarRequests.size(); i++)
+    {
+        collectFilterUpdates(*scalarRequests[i], existingRecords[i], &filterUpdates);
+    }
+    bool filterChanged = !filterUpdates.empty();
+    static_cast<FilterIndex *>(indexFactory->getIndex(IndexFactory::IndexType::FILTER))
+        ->updateIntFieldFilters(filterUpdates);
+
+    // 一个 WriteBatch 写入所有标量数据
+    scalarStorage.insertScalars(ids, records, keyPrefix);
+
+    // 一个批次只写一条日志
+    if (logToWAL && !accepted.empty())
+    {
+        writeWALLog("bulk_upsert", accepted);
+    }
+
+    // 索引已修改，使缓存的搜索结果失效
+    if (searchCache)
+    {
+        for (IndexFactory::IndexType indexType : writtenTypes)
+        {
+            searchCache->invalidate(indexType, filterChanged);
+        }
+    }
+
+    return accepted.size();
+}
+
+/**
+ * @brief 删除数据
+ * @param id 要删除的ID
+ * @param collection 集合名
+ * @param logToWAL 记录存在时是否写入WAL日志
+ * @return 记录存在并被删除时返回true
+ *
+ * 与 upsert 一样持有所属集合的写入锁，WAL日志也在锁内写入。索引类型和过滤字段都取自标量存储中的旧记录
+ */
+bool VectorDatabase::remove(uint64_t id, const std::string &collection, bool logToWAL)
+{
+    Collection *target = requireCollection(collection);
+    IndexFactory *indexFactory = target->getIndexFactory();
+    std::lock_guard<std::mutex> writeLock(target->getWriteMutex());
+
+    rapidjson::Document existingData;
+    try
+    {
+        ScopedStageTimer storageTimer(TimingStage::STORAGE);
+        existingData = scalarStorage.getScalar(id, target->getKeyPrefix());
+    }
+    catch (const std::runtime_error &e)
+    {
+        LOG_DEBUG("向量不存在于标量存储中，无需删除");
+        return false;
+    }
+    if (!existingData.IsObject())
+    {
+        return false;
+    }
+
+    IndexFactory::IndexType indexType = getIndexTypeFromRequest(existingData);
+    bool filterChanged = false;
+    {
+        ScopedStageTimer indexTimer(TimingStage::INDEX);
+        void *index = indexFactory->getIndex(indexType);
+        switch (indexType)
+        {
+        case IndexFactory::IndexType::FLAT:
+            static_cast<FaissIndex *>(index)->removeVectors({static_cast<long>(id)});
+            break;
+        case IndexFactory::IndexType::HNSW:
+            static_cast<HNSWLibIndex *>(index)->removeVectors({static_cast<long>(id)});
+            break;
+        case IndexFactory::IndexType::IVF:
+            static_cast<IVFIndex *>(index)->removeVectors({static_cast<long>(id)});
+            break;
+        default:
+            break;
+        }
+
+        // 与写入时收集的字段一致：id以外的int字段
+        std::vector<FilterIndex::IntFieldUpdate> filterUpdates;
+        for (auto it = existingData.MemberBegin(); it != existingData.MemberEnd(); ++it)
+        {
+            if (it->value.IsInt() && std::strcmp(it->name.GetString(), REQUEST_ID) != 0)
+            {
+                filterUpdates.push_back({it->name.GetString(), true, it->value.GetInt64(), 0, id, false});
+            }
+        }
+        filterChanged = !filterUpdates.empty();
+        static_cast<FilterIndex *>(indexFactory->getIndex(IndexFactory::IndexType::FILTER))
+            ->updateIntFieldFilters(filterUpdates);
+    }
+
+    {
+        ScopedStageTimer storageTimer(TimingStage::STORAGE);
+        scalarStorage.removeScalar(id, target->getKeyPrefix());
+    }
+
+    if (logToWAL)
+    {
+        // 重新生成单行的日志内容，请求体可能包含换行符
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key(REQUEST_ID);
+        writer.Uint64(id);
+        if (!collection.empty())
+        {
+            writer.Key(REQUEST_COLLECTION);
+            writer.String(collection.c_str(), static_cast<rapidjson::SizeType>(collection.size()));
+        }
+        writer.EndObject();
+        writeWALLog("delete", std::string(buffer.GetString(), buffer.GetSize()));
+    }
+
+    if (searchCache)
+    {
+        searchCache->invalidate(indexType, filterChanged);
+    }
+    return true;
 }
 
 /**
  * @brief 查询指定ID的数据
  * @param id 要查询的ID
+ * @param collection 集合名
  * @return 返回包含向量数据的JSON文档
  */
-rapidjson::Document VectorDatabase::query(uint64_t id)
+rapidjson::Document VectorDatabase::query(uint64_t id, const std::string &collection)
+{
+    return scalarStorage.getScalar(id, requireCollection(collection)->getKeyPrefix());
+}
+
+/**
+ * @brief 批量查询数据
+ * @param ids 要查询的ID列表
+ * @param collection 集合名
+ * @return 与ids一一对应的JSON记录文本，不存在的ID对应空字符串
+ */
+std::vector<std::string> VectorDatabase::queryRecords(const std::vector<uint64_t> &ids,
+                                                      const std::string &collection)
 {
-    return scalarStorage.getScalar(id);
+    return scalarStorage.getScalarRecords(ids, requireCollection(collection)->getKeyPrefix());
+}
+
+/**
+ * @brief 从索引中直接读取向量
+ * @param indexType 索引类型
+ * @param ids 要读取的ID列表
+ * @param collection 集合名
+ * @return 与ids一一对应的向量，无法读取的ID对应空向量
+ *
+ * 目前只有HNSW索引保存了可按标签读取的原始向量；FLAT索引（IndexIDMap）不支持按ID重建向量。
+ * 余弦集合的HNSW索引中保存的是归一化后的向量，不读取索引，由调用方从记录中获取写入时的向量
+ */
+std::vector<std::vector<float>> VectorDatabase::getIndexVectors(IndexFactory::IndexType indexType,
+                                                                const std::vector<uint64_t> &ids,
+                                                                const std::string &collection)
+{
+    std::vector<std::vector<float>> vectors(ids.size());
+    if (indexType != IndexFactory::IndexType::HNSW)
+    {
+        return vectors;
+    }
+    Collection *target = requireCollection(collection);
+    if (target->getConfig().metric == IndexFactory::MetricType::COSINE)
+    {
+        return vectors;
+    }
+    HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(target->getIndexFactory()->getIndex(indexType));
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        hnswIndex->getVector(ids[i], &vectors[i]);
+    }
+    return vectors;
 }
 
 /**
  * @brief 搜索数据
- * @param jsonRequest 包含搜索请求的JSON文档
- * @return 返回搜索结果
+ * @param request 解码后的搜索请求
+ * @param partial 可选的输出参数，在时间预算内未完成搜索时置为true
+ * @param plan 可选的输出参数，实际使用的执行计划
+ * @return 返回搜索结果，多个查询的结果依次排列，每个查询占k个位置（无效位置ID为-1）
+ *
+ * 开启缓存后先查找缓存的结果；开启合批后，FLAT索引的搜索交给合批器与其他并发请求合并执行
  */
 std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(
-    const rapidjson::Document &jsonRequest)
+    const SearchRequest &request, bool *partial, SearchPlan *plan)
+{
+    // 需要返回执行计划时直接执行，缓存和合批的结果没有对应本次请求的计划
+    if (request.explain)
+    {
+        auto deadline = request.timeoutMillis > 0
+                            ? std::chrono::steady_clock::now() + std::chrono::milliseconds(request.timeoutMillis)
+                            : std::chrono::steady_clock::time_point::max();
+        return executeSearch(request, deadline, partial, plan);
+    }
+
+    // 先查结果缓存；写入代数必须在执行搜索之前读取
+    std::pair<std::vector<long>, std::vector<float>> results;
+    SearchCache::Epochs epochs;
+    if (searchCache)
+    {
+        ScopedStageTimer cacheTimer(TimingStage::CACHE);
+        if (searchCache->lookup(request, &results))
+        {
+            return results;
+        }
+        epochs = searchCache->currentEpochs(request.indexType);
+    }
+
+    // 时间预算从开始搜索时计算
+    bool expired = false;
+    if (request.timeoutMillis > 0)
+    {
+        // 合批的成员共享一次搜索，无法各自遵守时间预算，因此带时间预算的请求单独执行
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(request.timeoutMillis);
+        results = executeSearch(request, deadline, &expired);
+    }
+    else if (searchBatcher && request.indexType == IndexFactory::IndexType::FLAT)
+    {
+        // 作为领导者执行合批时，其中的过滤和搜索阶段也会记入本请求
+        ScopedStageTimer batchTimer(TimingStage::BATCH);
+        results = searchBatcher->search(request, [this](const SearchRequest &batchRequest)
+                                        { return executeSearch(batchRequest); });
+    }
+    else
+    {
+        results = executeSearch(request);
+    }
+
+    if (expired)
+    {
+        // 部分结果不写入缓存
+        if (partial)
+        {
+            *partial = true;
+        }
+        return results;
+    }
+
+    if (searchCache)
+    {
+        ScopedStageTimer cacheTimer(TimingStage::CACHE);
+        searchCache->insert(request, epochs, results);
+    }
+    return results;
+}
+
+/**
+ * @brief 训练集合的IVF索引
+ * @param request 解码后的训练请求
+ * @param logToWAL 是否写入WAL日志
+ * @return 训练统计
+ */
+IVFTrainStats VectorDatabase::trainIvf(const TrainRequest &request, bool logToWAL)
 {
-    // 从JSON请求中提取搜索参数
-    std::vector<float> searchParams;
-    for (const auto &s : jsonRequest[REQUEST_VECTORS].GetArray())
+    Collection *collection = requireCollection(request.collection);
+    IVFIndex *ivfIndex = static_cast<IVFIndex *>(
+        collection->getIndexFactory()->getIndex(IndexFactory::IndexType::IVF));
+    if (ivfIndex == nullptr)
     {
-        searchParams.push_back(s.GetFloat());
+        throw std::runtime_error("IVF index not found in collection: " + request.collection);
+    }
+    // 抽样要遍历整个集合，已训练时提前返回
+    if (ivfIndex->isTrained())
+    {
+        throw std::runtime_error("IVF index is already trained");
     }
-    int k = jsonRequest[REQUEST_K].GetInt();
 
-    // 从JSON请求中提取索引类型
-    IndexFactory::IndexType indexType = IndexFactory::IndexType::UNKNOWN;
-    if (jsonRequest.HasMember(REQUEST_INDEX_TYPE) &&
-        jsonRequest[REQUEST_INDEX_TYPE].IsString())
+    auto startTime = std::chrono::steady_clock::now();
+    size_t numSamples = 0;
+    std::vector<float> trainedCentroids;
+    const std::vector<float> *centroids = &request.centroids;
+    if (request.centroids.empty())
     {
-        std::string indexTypeStr = jsonRequest[REQUEST_INDEX_TYPE].GetString();
-        if (indexTypeStr == INDEX_TYPE_FLAT)
+        std::vector<float> sampled;
+        const std::vector<float> *samples = &request.vectors;
+        if (request.vectors.empty())
         {
-            indexType = IndexFactory::IndexType::FLAT;
+            size_t sampleSize = request.sampleSize > 0 ? request.sampleSize
+                                                       : ivfIndex->getNlist() * IVF_TRAIN_POINTS_PER_CENTROID;
+            sampleIvfVectors(collection, ivfIndex->getDim(), sampleSize, &sampled);
+            samples = &sampled;
         }
-        else if (indexTypeStr == INDEX_TYPE_HNSW)
+        else if (request.vectors.size() != request.numVectors * static_cast<size_t>(ivfIndex->getDim()))
         {
-            indexType = IndexFactory::IndexType::HNSW;
+            throw std::runtime_error("IVF training vectors do not match index dim " +
+                                     std::to_string(ivfIndex->getDim()));
         }
+        // k-means 耗时较长，不持有集合的写入锁
+        trainedCentroids = ivfIndex->trainCentroids(*samples);
+        numSamples = samples->size() / ivfIndex->getDim();
+        centroids = &trainedCentroids;
     }
 
-    // 从JSON请求中提取过滤索引
-    roaring_bitmap_t *filterBitmap = nullptr;
-    if (jsonRequest.HasMember(INDEX_TYPE_FILTER) &&
-        jsonRequest[INDEX_TYPE_FILTER].IsObject())
+    // 切换索引和写入WAL日志在集合的写入锁内完成：之前的写入进入缓冲区后随切换移入索引，
+    // 之后的写入直接写入索引，重放日志时训练条目与写入条目的先后顺序与此一致
+    IVFTrainStats stats;
     {
-        const auto &filter = jsonRequest[INDEX_TYPE_FILTER];
-        std::string fieldName = filter["fieldName"].GetString();
-        std::string opStr = filter["op"].GetString();
-        int64_t value = filter["value"].GetInt64();
+        std::lock_guard<std::mutex> writeLock(collection->getWriteMutex());
+        stats = ivfIndex->applyCentroids(*centroids);
+
+        if (logToWAL)
+        {
+            // 日志中记录聚类中心而不是训练参数，重放时不重新抽样，恢复出的索引与本次相同
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            if (!request.collection.empty())
+            {
+                writer.Key(REQUEST_COLLECTION);
+                writer.String(request.collection.c_str(), static_cast<rapidjson::SizeType>(request.collection.size()));
+            }
+            writer.Key(REQUEST_CENTROIDS);
+            writer.StartArray();
+            size_t dim = static_cast<size_t>(ivfIndex->getDim());
+            for (size_t offset = 0; offset < centroids->size(); offset += dim)
+            {
+                writer.StartArray();
+                for (size_t i = 0; i < dim; i++)
+                {
+                    writeShortestFloat(writer, (*centroids)[offset + i]);
+                }
+                writer.EndArray();
+            }
+            writer.EndArray();
+            writer.EndObject();
+            writeWALLog("train", std::string(buffer.GetString(), buffer.GetSize()));
+        }
+    }
+    stats.samples = numSamples;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    // 训练之前的结果来自缓冲区的精确搜索，训练之后只探测部分倒排列表，结果可能不同
+    if (searchCache)
+    {
+        searchCache->invalidate(IndexFactory::IndexType::IVF, false);
+    }
+    return stats;
+}
+
+/**
+ * @brief 从标量存储中抽样集合写入IVF索引的向量
+ * @param collection 集合
+ * @param dim 向量维度
+ * @param sampleSize 最大样本数
+ * @param samples 输出参数，样本向量
+ *
+ * 蓄水池抽样：前 sampleSize 条记录直接放入样本，之后第 n 条记录以 sampleSize / n 的概率替换随机的一个样本
+ */
+void VectorDatabase::sampleIvfVectors(const Collection *collection, int dim, size_t sampleSize,
+                                      std::vector<float> *samples)
+{
+    samples->clear();
+    if (sampleSize == 0 || dim <= 0)
+    {
+        return;
+    }
+    std::mt19937_64 random(std::random_device{}());
+    size_t seen = 0;
+    scalarStorage.scanScalars(collection->getKeyPrefix(), [&](uint64_t, std::string_view text)
+    {
+        rapidjson::Document record;
+        record.Parse(text.data(), text.size());
+        if (record.HasParseError() || !record.IsObject() ||
+            getIndexTypeFromRequest(record) != IndexFactory::IndexType::IVF ||
+            !record.HasMember(REQUEST_VECTORS) || !record[REQUEST_VECTORS].IsArray())
+        {
+            return true;
+        }
+        const rapidjson::Value &vector = record[REQUEST_VECTORS];
+        if (vector.Size() != static_cast<rapidjson::SizeType>(dim))
+        {
+            return true;
+        }
+        for (const auto &value : vector.GetArray())
+        {
+            if (!value.IsNumber())
+            {
+                return true;
+            }
+        }
+
+        size_t slot = seen++;
+        if (slot >= sampleSize)
+        {
+            slot = std::uniform_int_distribution<size_t>(0, slot)(random);
+            if (slot >= sampleSize)
+            {
+                return true;
+            }
+        }
+        else
+        {
+            samples->resize(samples->size() + dim);
+        }
+        float *target = samples->data() + slot * dim;
+        for (const auto &value : vector.GetArray())
+        {
+            *target++ = value.GetFloat();
+        }
+        return true;
+    });
+    globalLogger->info("Sampled {} of {} IVF vectors for training", samples->size() / dim, seen);
+}
+
+/**
+ * @brief 开启搜索结果缓存
+ * @param maxBytes 缓存占用的最大字节数
+ */
+void VectorDatabase::enableSearchCache(size_t maxBytes)
+{
+    searchCache.reset(new SearchCache(maxBytes));
+}
+
+/**
+ * @brief 开启FLAT搜索的合批
+ * @param windowMicros 合批窗口（微秒）
+ * @param maxQueries 一个批次最多包含的查询数
+ */
+void VectorDatabase::enableSearchBatching(uint64_t windowMicros, size_t maxQueries)
+{
+    searchBatcher.reset(new SearchBatcher(windowMicros, maxQueries));
+}
+
+/**
+ * @brief 在索引上执行搜索
+ * @param request 解码后的搜索请求
+ * @param deadline 搜索的截止时间
+ * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
+ * @param plan 可选的输出参数，实际使用的执行计划
+ * @return 返回搜索结果
+ */
+std::pair<std::vector<long>, std::vector<float>> VectorDatabase::executeSearch(
+    const SearchRequest &request, std::chrono::steady_clock::time_point deadline, bool *partial,
+    SearchPlan *plan)
+{
+    const std::vector<float> &query = request.vectors;
+    int k = request.k;
+    IndexFactory::IndexType indexType = request.indexType;
+    IndexFactory *indexFactory = requireCollection(request.collection)->getIndexFactory();
 
-        FilterIndex::Operation op = (opStr == "=")
-                                        ? FilterIndex::Operation::EQUAL
-                                        : FilterIndex::Operation::NOT_EQUAL;
+    // 从过滤条件中构建过滤位图
+    roaring_bitmap_t *filterBitmap = nullptr;
+    if (request.hasFilter)
+    {
+        ScopedStageTimer filterTimer(TimingStage::FILTER);
         // 获取FilterIndex
         FilterIndex *filterIndex = static_cast<FilterIndex *>(
-            getGlobalIndexFactory()->getIndex(IndexFactory::IndexType::FILTER));
+            indexFactory->getIndex(IndexFactory::IndexType::FILTER));
         filterBitmap = roaring_bitmap_create();
-        filterIndex->getIntFieldFilterBitmap(fieldName, op, value, filterBitmap);
+        filterIndex->getIntFieldFilterBitmap(request.filter.fieldName, request.filter.op,
+                                             request.filter.value, filterBitmap);
     }
 
-    // 从全局索引工厂获取索引对象
-    void *index = getGlobalIndexFactory()->getIndex(indexType);
+    // 从请求所属集合的索引工厂获取索引对象
+    void *index = indexFactory->getIndex(indexType);
 
     // 根据索引类型初始化相应的索引对象并选择相应的search操作
     std::pair<std::vector<long>, std::vector<float>> results;
+    SearchPlan chosenPlan;
+    size_t matches = filterBitmap ? roaring_bitmap_get_cardinality(filterBitmap) : 0;
+    ScopedStageTimer searchTimer(TimingStage::SEARCH);
     switch (indexType)
     {
     case IndexFactory::IndexType::FLAT:
     {
         FaissIndex *faissIndex = static_cast<FaissIndex *>(index);
-        results = faissIndex->searchVectors(searchParams, k, filterBitmap);
+        chosenPlan.vectors = faissIndex->getVectorCount();
+        chosenPlan.matches = filterBitmap ? std::min(matches, chosenPlan.vectors) : chosenPlan.vectors;
+        // 过滤搜索只计算满足过滤条件的向量的距离
+        chosenPlan.estimatedCost = static_cast<double>(chosenPlan.matches);
+        results = faissIndex->searchVectors(query, k, filterBitmap, deadline, partial);
         break;
     }
     case IndexFactory::IndexType::HNSW:
     {
         HNSWLibIndex *hnswIndex = static_cast<HNSWLibIndex *>(index);
-        results = hnswIndex->searchVectors(searchParams, k, filterBitmap);
+        chosenPlan = planHnswSearch(k, hnswIndex->getLiveCount(), filterBitmap != nullptr, matches,
+                                    hnswIndex->getMaxNeighbors(), request.ef);
+        LOG_DEBUG("HNSW search plan: {}, matches = {}, vectors = {}, estimatedCost = {}",
+                  searchStrategyName(chosenPlan.strategy), chosenPlan.matches, chosenPlan.vectors,
+                  chosenPlan.estimatedCost);
+        if (chosenPlan.strategy == SearchStrategy::EXACT)
+        {
+            results = hnswIndex->searchExact(query, k, filterBitmap);
+            break;
+        }
+        if (chosenPlan.strategy == SearchStrategy::POST_FILTER)
+        {
+            bool expired = false;
+            auto candidates = hnswIndex->searchVectors(query, static_cast<int>(chosenPlan.candidateK), nullptr,
+                                                       static_cast<int>(chosenPlan.ef), deadline, &expired);
+            size_t minHits = std::min<size_t>(k, chosenPlan.matches);
+            if (filterCandidates(candidates, request.numQueries, chosenPlan.candidateK, k, filterBitmap,
+                                 minHits, &results) || expired)
+            {
+                if (expired && partial)
+                {
+                    *partial = true;
+                }
+                break;
+            }
+            // 候选中满足过滤条件的不足k个，改用过滤图搜索
+            chosenPlan.strategy = SearchStrategy::FILTERED_GRAPH;
+            chosenPlan.fallback = true;
+            chosenPlan.candidateK = 0;
+            chosenPlan.ef = request.ef > 0 ? std::max(request.ef, k)
+                                           : scaleEfForFilter(k, chosenPlan.vectors, chosenPlan.matches);
+        }
+        if (chosenPlan.strategy == SearchStrategy::TWO_HOP_GRAPH)
+        {
+            bool expired = false;
+            auto found = hnswIndex->searchTwoHop(query, k, filterBitmap, static_cast<int>(chosenPlan.ef),
+                                                 deadline, &expired);
+            size_t minHits = std::min<size_t>(k, chosenPlan.matches);
+            // 结果都满足过滤条件，这里只检查每个查询是否找到足够的结果
+            if (filterCandidates(found, request.numQueries, k, k, filterBitmap, minHits, &results) ||
+                expired)
+            {
+                if (expired && partial)
+                {
+                    *partial = true;
+                }
+                break;
+            }
+            // 满足条件的节点经桥梁仍不连通，改用按选择率放大ef的过滤图搜索
+            chosenPlan.strategy = SearchStrategy::FILTERED_GRAPH;
+            chosenPlan.fallback = true;
+            chosenPlan.ef = request.ef > 0 ? std::max(request.ef, k)
+                                           : scaleEfForFilter(k, chosenPlan.vectors, chosenPlan.matches);
+        }
+        results = hnswIndex->searchVectors(query, k, filterBitmap, static_cast<int>(chosenPlan.ef),
+                                           deadline, partial);
+        break;
+    }
+    case IndexFactory::IndexType::IVF:
+    {
+        IVFIndex *ivfIndex = static_cast<IVFIndex *>(index);
+        chosenPlan = planIvfSearch(k, ivfIndex->getVectorCount(), filterBitmap != nullptr, matches,
+                                   ivfIndex->getNlist(), ivfIndex->isTrained(), request.nprobe);
+        LOG_DEBUG("IVF search plan: {}, nprobe = {}, matches = {}, vectors = {}",
+                  searchStrategyName(chosenPlan.strategy), chosenPlan.nprobe, chosenPlan.matches,
+                  chosenPlan.vectors);
+        results = ivfIndex->searchVectors(query, k, filterBitmap, chosenPlan.nprobe, deadline, partial);
         break;
     }
     // TODO: 添加其他索引类型的支持
@@ -257,6 +1129,10 @@ std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(
         roaring_bitmap_free(filterBitmap);
     }
 
+    if (plan)
+    {
+        *plan = chosenPlan;
+    }
     return results;
 }
 
@@ -271,10 +1147,35 @@ std::pair<std::vector<long>, std::vector<float>> VectorDatabase::search(
 void VectorDatabase::reloadDatabase(){
     globalLogger->info("Entering VectorDatabase::reloadDatabase()");
 
-    persistence.loadSnapshot(scalarStorage);
+    // 命名集合已在构造时创建，各自从快照目录下的子目录加载
+    persistence.loadSnapshot(scalarStorage, getCollectionIndexes());
 
     std::string operationType;
     rapidjson::Document jsonData;
+
+    // 连续的单条写入合并为一批重放，HNSW索引由多个线程并行构建（见 HNSWLibIndex::buildIndex）；
+    // 遇到其他类型的日志前先写入已合并的记录，保持日志顺序
+    std::vector<UpsertRequest> pendingUpserts;
+    // 每隔一段时间输出一次已重放的记录数和吞吐量
+    auto startTime = std::chrono::steady_clock::now();
+    auto nextReportTime = startTime + std::chrono::milliseconds(HNSW_BUILD_PROGRESS_INTERVAL_MS);
+    size_t replayed = 0;
+    auto flushPendingUpserts = [&]()
+    {
+        if (pendingUpserts.empty())
+        {
+            return;
+        }
+        replayed += bulkUpsert(pendingUpserts);
+        pendingUpserts.clear();
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextReportTime)
+        {
+            double seconds = std::chrono::duration<double>(now - startTime).count();
+            globalLogger->info("WAL replay progress: {} records, {:.0f} records/s", replayed, replayed / seconds);
+            nextReportTime = now + std::chrono::milliseconds(HNSW_BUILD_PROGRESS_INTERVAL_MS);
+        }
+    };
     
     // 第一次读取WAL日志
     persistence.readNextWALLog(&operationType, &jsonData);
@@ -282,25 +1183,96 @@ void VectorDatabase::reloadDatabase(){
     // 循环处理WAL日志，直到operationType为空（没有更多日志）
     while (!operationType.empty()){
         // 在处理前检查jsonData是否有效，防止readNextWALLog读取失败但operationType不为空的情况
-        if (!jsonData.IsObject()){
-            globalLogger->debug("jsonData is not an object after reading, stopping reload.");
+        // 批量写入的日志条目是一个记录数组，其余条目是单个对象
+        if (!jsonData.IsObject() && !jsonData.IsArray()){
+            LOG_DEBUG("jsonData is not an object after reading, stopping reload.");
             break; 
         }
         
-        globalLogger->info("operation type: {}", operationType);
-
-        // 打印读取的一行内容
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        jsonData.Accept(writer);
-        globalLogger->info("Read Line: {}", buffer.GetString());
+        // 日志内容已在读取时记录（见 Persistence::readNextWALLog），这里不再重新序列化
+        LOG_DEBUG("operation type: {}", operationType);
 
         // 根据操作类型执行相应的操作
+        std::string errorMsg;
         if (operationType == "upsert"){
-            uint64_t id = jsonData[REQUEST_ID].GetUint64();
-            IndexFactory::IndexType indexType = getIndexTypeFromRequest(jsonData);
-            // 调用 VectorDatabase::upsert 接口重建数据
-            upsert(id, jsonData, indexType);
+            // 合并到待重放的批次中，批次已满时通过 VectorDatabase::bulkUpsert 接口重建数据
+            UpsertRequest request;
+            if (decodeUpsertRequest(jsonData, &request, &errorMsg) && getCollection(request.collection)){
+                pendingUpserts.push_back(std::move(request));
+                if (pendingUpserts.size() >= WAL_REPLAY_BATCH_SIZE){
+                    flushPendingUpserts();
+                }
+            }
+            else if (errorMsg.empty()){
+                globalLogger->error("Skip upsert WAL entry of unknown collection {}", request.collection);
+            }
+            else{
+                globalLogger->error("Skip invalid upsert WAL entry: {}", errorMsg);
+            }
+        }
+        else if (operationType == "bulk_upsert" && jsonData.IsArray()){
+            flushPendingUpserts();
+            // 一条日志对应写入时的一个批次，按批次重放
+            std::vector<UpsertRequest> requests;
+            requests.reserve(jsonData.Size());
+            for (const auto &record : jsonData.GetArray())
+            {
+                requests.emplace_back();
+                if (!decodeUpsertRequest(record, &requests.back(), &errorMsg))
+                {
+                    globalLogger->error("Skip invalid bulk_upsert WAL record: {}", errorMsg);
+                    requests.pop_back();
+                }
+            }
+            replayed += bulkUpsert(requests);
+        }
+        else if (operationType == "delete"){
+            // 删除之前的写入必须先生效
+            flushPendingUpserts();
+            std::string collection;
+            if (jsonData.IsObject() && jsonData.HasMember(REQUEST_ID) && jsonData[REQUEST_ID].IsUint64() &&
+                decodeCollectionName(jsonData, &collection, &errorMsg) && getCollection(collection)){
+                remove(jsonData[REQUEST_ID].GetUint64(), collection);
+                replayed++;
+            }
+            else{
+                globalLogger->error("Skip invalid delete WAL entry");
+            }
+        }
+        else if (operationType == "train"){
+            // 训练之前的写入必须先进入缓冲区，切换索引时才会移入IVF索引
+            flushPendingUpserts();
+            TrainRequest request;
+            Collection *collection = nullptr;
+            if (decodeTrainRequest(jsonData, &request, &errorMsg) &&
+                (collection = getCollection(request.collection)) != nullptr){
+                IVFIndex *ivfIndex = static_cast<IVFIndex *>(
+                    collection->getIndexFactory()->getIndex(IndexFactory::IndexType::IVF));
+                if (request.centroids.empty()){
+                    // 只记录了训练参数的日志无法重现当时的样本，不重新抽样
+                    globalLogger->error("Failed to replay train WAL entry of collection {}: no centroids recorded",
+                                        request.collection);
+                }
+                else if (ivfIndex != nullptr && ivfIndex->isTrained()){
+                    // 快照中已经是训练完成的索引
+                    LOG_DEBUG("IVF index of collection {} is already trained in the snapshot", request.collection);
+                }
+                else{
+                    try{
+                        trainIvf(request, false);
+                    }
+                    catch (const std::runtime_error &e){
+                        globalLogger->error("Failed to replay train WAL entry of collection {}: {}",
+                                            request.collection, e.what());
+                    }
+                }
+            }
+            else if (errorMsg.empty()){
+                globalLogger->error("Skip train WAL entry of unknown collection {}", request.collection);
+            }
+            else{
+                globalLogger->error("Skip invalid train WAL entry: {}", errorMsg);
+            }
         }
 
         // 清空 jsonData 对象，为下一次读取做准备
@@ -310,56 +1282,77 @@ void VectorDatabase::reloadDatabase(){
         operationType.clear(); // 清空operationType，确保readNextWALLog能正确设置其状态
         persistence.readNextWALLog(&operationType, &jsonData);
     }
-    
+    flushPendingUpserts();
+
     // WAL 重放完毕
+    globalLogger->info("WAL replay finished: {} records, {:.1f} seconds", replayed,
+                       std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
     globalLogger->info("Exiting VectorDatabase::reloadDatabase()");
 }
 
 /**
  * @brief 写入 WAL 日志
  * @param operationType 操作类型
- * @param jsonData 包含向量数据的JSON文档
+ * @param request 解码后的插入或更新请求
  */
 void VectorDatabase::writeWALLog(const std::string &operationType,
-                                 const rapidjson::Document &jsonData){
+                                 const UpsertRequest &request){
     // 自定义版本号
     std::string verison = "1.0";
-    // 将version传递给 persistence 对象的 writeWALLog 方法
-    persistence.writeWALLog(operationType, jsonData, verison);
+    // 记录文本在解码请求时已经生成，直接写入日志
+    persistence.writeWALLog(operationType, request.record, verison);
 }
 
 /**
- * @brief 执行数据库快照
- *
- * 调用持久化模块的takeSnapshot方法，传入scalarStorage以便保存快照。
+ * @brief 写入一条记录文本已知的 WAL 日志
+ * @param operationType 操作类型
+ * @param record 日志内容
  */
-void VectorDatabase::takeSnapshot(){
-    // 调用持久化模块执行快照
-    persistence.takeSnapshot(scalarStorage);
+void VectorDatabase::writeWALLog(const std::string &operationType,
+                                 const std::string &record){
+    std::string verison = "1.0";
+    persistence.writeWALLog(operationType, record, verison);
 }
 
 /**
- * @brief 从请求中获取索引类型(出于模块化考虑，将该函数从 http_server.h 中复制过来)
- * @param jsonRequest JSON请求文档对象
- * @return IndexFactory::IndexType 返回解析出的索引类型
+ * @brief 把一个批次的请求作为一条 WAL 日志写入
+ * @param operationType 操作类型
+ * @param requests 批次中实际写入的请求
+ *
+ * 各请求的记录文本拼接为一个JSON数组，整个批次只写入一行日志、只刷新一次磁盘
  */
-IndexFactory::IndexType VectorDatabase::getIndexTypeFromRequest(const rapidjson::Document &jsonRequest){
-    // 如果请求中包含 indexType 字段
-    if (jsonRequest.HasMember(REQUEST_INDEX_TYPE))
+void VectorDatabase::writeWALLog(const std::string &operationType,
+                                 const std::vector<const UpsertRequest *> &requests){
+    size_t totalSize = 2;
+    for (const UpsertRequest *request : requests)
     {
-        // 获取索引类型字符串
-        std::string indexTypeStr = jsonRequest[REQUEST_INDEX_TYPE].GetString();
-        // 根据字符串值返回对应的索引类型
-        if (indexTypeStr == INDEX_TYPE_FLAT)
-        {
-            return IndexFactory::IndexType::FLAT;
-        }
-        else if (indexTypeStr == INDEX_TYPE_HNSW)
+        totalSize += request->record.size() + 1;
+    }
+
+    std::string jsonData;
+    jsonData.reserve(totalSize);
+    jsonData.push_back('[');
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        if (i > 0)
         {
-            return IndexFactory::IndexType::HNSW;
+            jsonData.push_back(',');
         }
-        // TODO: 支持其他索引类型
+        jsonData.append(requests[i]->record);
     }
-    // 如果请求中不包含 indexType 字段或类型未知，返回 UNKNOWN
-    return IndexFactory::IndexType::UNKNOWN;
-}
\ No newline at end of file
+    jsonData.push_back(']');
+
+    std::string verison = "1.0";
+    persistence.writeWALLog(operationType, jsonData, verison);
+}
+
+/**
+ * @brief 执行数据库快照
+ *
+ * 调用持久化模块的takeSnapshot方法，传入scalarStorage以便保存快照。
+ * 命名集合的索引保存在快照目录下以集合名命名的子目录中。
+ */
+void VectorDatabase::takeSnapshot(){
+    // 调用持久化模块执行快照
+    persistence.takeSnapshot(scalarStorage, getCollectionIndexes());
+}
@@ -3,17 +3,27 @@
  * @brief 向量数据库头文件
  *
  * 该文件定义了向量数据库的接口，提供了向量数据的存储和检索功能。
- * 支持多种索引类型，包括FLAT和HNSW，并集成了标量存储功能。
+ * 支持多种索引类型，包括FLAT、HNSW和IVF，并集成了标量存储功能。
  */
 
 #pragma once
 
 #include "scalar_storage.h"
 #include "index_factory.h"
+#include "collection.h"
+#include "ivf_index.h"
+#include <map>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include "rapidjson/document.h"
 #include "persistence.h"
+#include "request.h"
+#include "search_batcher.h"
+#include "search_cache.h"
+#include "search_planner.h"
+#include <chrono>
+#include <memory>
 
 /**
  * @class VectorDatabase
@@ -23,6 +33,7 @@
  * 1. 向量的插入和更新
  * 2. 向量的查询
  * 3. 与标量存储的集成
+ * 4. 按集合名把请求路由到各集合自己的索引和存储键空间（见 collection.h）
  */
 class VectorDatabase
 {
@@ -31,39 +42,171 @@ public:
      * @brief 构造函数
      * @param dbPath 数据库存储路径
      * @param walLogPath WAL日志存储路径
+     *
+     * 默认集合使用全局索引工厂；已创建的命名集合从标量存储中恢复
      */
     VectorDatabase(const std::string &dbPath, const std::string &walLogPath);
 
+    /**
+     * @brief 创建命名集合
+     * @param config 集合配置
+     * @param errorMsg 输出参数，创建失败时的错误信息
+     * @return 创建成功返回true，集合已存在时返回false
+     *
+     * 集合配置写入标量存储，重启后在重放WAL日志之前重新创建
+     */
+    bool createCollection(const CollectionConfig &config, std::string *errorMsg);
+
+    /**
+     * @brief 按名称获取集合
+     * @param name 集合名，为空或为默认集合名时返回默认集合
+     * @return 集合不存在时返回nullptr
+     */
+    Collection *getCollection(const std::string &name) const;
+
+    /**
+     * @brief 获取所有集合
+     * @return 默认集合在前，其余按集合名排序
+     */
+    std::vector<Collection *> getCollections() const;
+
     /**
      * @brief 插入或更新向量数据
-     * @param id 向量ID
-     * @param data 包含向量数据的JSON文档
-     * @param indexType 索引类型（FLAT或HNSW）
+     * @param request 解码后的插入或更新请求
+     * @param logToWAL 是否写入 upsert WAL日志，重放WAL日志时为false
      *
      * 该函数用于插入新的向量数据或更新已存在的向量数据。
      * 如果向量已存在，会先删除旧数据再插入新数据。
+     * WAL日志在集合的写入锁内写入，同一集合的日志顺序与实际写入顺序一致
      */
-    void upsert(uint64_t id, const rapidjson::Document &data,
-                IndexFactory::IndexType indexType);
+    void upsert(const UpsertRequest &request, bool logToWAL = false);
+
+    /**
+     * @brief 批量插入或更新向量数据
+     * @param requests 解码后的插入或更新请求
+     * @param logToWAL 是否把实际写入的记录写入WAL日志，重放WAL日志时为false
+     * @return 实际写入的记录数量
+     *
+     * 一个批次内每种索引只调用一次批量写入，标量数据通过一个 WriteBatch 写入。
+     * 同一批次内重复的ID只保留最后一条，维度不匹配或索引类型无效的记录会被跳过。
+     * 每个集合实际写入的记录作为一条 bulk_upsert 日志写入，被跳过的记录不进入日志
+     */
+    size_t bulkUpsert(const std::vector<UpsertRequest> &requests, bool logToWAL = false);
+
+    /**
+     * @brief 删除数据
+     * @param id 要删除的ID
+     * @param collection 集合名，为空时使用默认集合
+     * @param logToWAL 记录存在时是否写入 delete WAL日志（内容只包含ID和集合名），重放WAL日志时为false
+     * @return 记录存在并被删除时返回true
+     *
+     * 按记录写入时的索引类型从向量索引中删除向量，并删除过滤索引中的条目和标量存储中的记录。
+     * HNSW索引中被删除的位置会被之后的写入复用，墓碑过多时在后台重建（见 hnswlib_index.h）
+     */
+    bool remove(uint64_t id, const std::string &collection = "", bool logToWAL = false);
 
     /**
      * @brief 查询数据
      * @param id 要查询的ID
+     * @param collection 集合名，为空时使用默认集合
      * @return 返回包含向量数据的JSON文档
      *
      * 该函数用于根据ID查询向量数据，返回JSON格式的向量信息。
      */
-    rapidjson::Document query(uint64_t id);
+    rapidjson::Document query(uint64_t id, const std::string &collection = "");
+
+    /**
+     * @brief 批量查询数据
+     * @param ids 要查询的ID列表
+     * @param collection 集合名，为空时使用默认集合
+     * @return 与ids一一对应的JSON记录文本，不存在的ID对应空字符串
+     *
+     * 所有ID通过标量存储的一次批量读取完成
+     */
+    std::vector<std::string> queryRecords(const std::vector<uint64_t> &ids,
+                                          const std::string &collection = "");
+
+    /**
+     * @brief 从索引中直接读取向量
+     * @param indexType 索引类型
+     * @param ids 要读取的ID列表
+     * @param collection 集合名，为空时使用默认集合
+     * @return 与ids一一对应的向量；索引不支持按ID读取（如FLAT）、余弦集合的索引或ID不存在时对应空向量
+     */
+    std::vector<std::vector<float>> getIndexVectors(IndexFactory::IndexType indexType,
+                                                    const std::vector<uint64_t> &ids,
+                                                    const std::string &collection = "");
 
     /**
      * @brief 搜索数据
-     * @param jsonRequest 包含搜索请求的JSON文档
+     * @param request 解码后的搜索请求
+     * @param partial 可选的输出参数，在请求的时间预算内未完成搜索时置为true
+     * @param plan 可选的输出参数，实际使用的执行计划（见 search_planner.h）
      * @return 返回搜索结果
+     *
+     * 批量查询时所有查询在一次索引调用中完成，结果按查询依次排列，
+     * 每个查询占k个位置，无效位置的ID为-1。
+     * 请求带有时间预算时不参与合批，超时返回的部分结果不写入缓存。
+     * 带有 explain 的请求不读写缓存、不参与合批，以便返回本次实际执行的计划。
+     */
+    std::pair<std::vector<long>, std::vector<float>> search(const SearchRequest &request,
+                                                            bool *partial = nullptr,
+                                                            SearchPlan *plan = nullptr);
+
+    /**
+     * @brief 训练集合的IVF索引
+     * @param request 解码后的训练请求
+     * @param logToWAL 是否写入WAL日志
+     * @return 训练统计
+     * @throws std::runtime_error 集合不存在、索引已训练、样本不足或维度不一致时抛出
+     *
+     * 请求带有聚类中心时直接使用；带有训练向量时用其训练；否则从标量存储中该集合写入IVF索引的记录里
+     * 均匀抽样（蓄水池抽样，见 sampleIvfVectors），样本数默认为 nlist * IVF_TRAIN_POINTS_PER_CENTROID。
+     * 训练之前写入的向量在训练完成后移入IVF索引，IVF索引上缓存的结果随之失效。
+     * 切换索引与写入WAL日志在集合的写入锁内完成，日志中记录的是聚类中心，重放时不重新抽样
+     */
+    IVFTrainStats trainIvf(const TrainRequest &request, bool logToWAL = false);
+
+    /**
+     * @brief 开启FLAT搜索的合批
+     * @param windowMicros 合批窗口（微秒）
+     * @param maxQueries 一个批次最多包含的查询数
+     *
+     * 应在开始处理请求之前调用
+     */
+    void enableSearchBatching(uint64_t windowMicros, size_t maxQueries);
+
+    /**
+     * @brief 开启搜索结果缓存
+     * @param maxBytes 缓存占用的最大字节数
+     *
+     * 应在开始处理请求之前调用。upsert、bulkUpsert 和 remove 会使被写入索引上缓存的结果失效
+     */
+    void enableSearchCache(size_t maxBytes);
+
+    /**
+     * @brief 获取搜索结果缓存
+     * @return 未开启缓存时返回nullptr
      */
-    std::pair<std::vector<long>, std::vector<float>> search(
-        const rapidjson::Document &jsonRequest);
+    const SearchCache *getSearchCache() const { return searchCache.get(); }
 
+    /**
+     * @brief 获取搜索合批器
+     * @return 未开启合批时返回nullptr
+     */
+    const SearchBatcher *getSearchBatcher() const { return searchBatcher.get(); }
 
+    /**
+     * @brief 获取持久化对象，用于读取WAL和快照的运行统计
+     * @return 持久化对象
+     */
+    const Persistence &getPersistence() const { return persistence; }
+
+    /**
+     * @brief 获取标量存储（RocksDB）的内部统计
+     * @return 属性名到属性值的映射
+     */
+    std::map<std::string, uint64_t> getStorageStats() const { return scalarStorage.getStats(); }
 
     /**
      * @brief 重新加载数据库中的数据
@@ -73,10 +216,24 @@ public:
     /**
      * @brief 写入WAL日志
      * @param operationType 操作类型
-     * @param jsonData 包含向量数据的JSON文档
+     * @param request 解码后的插入或更新请求，日志内容为其记录文本
+     */
+    void writeWALLog(const std::string &operationType, const UpsertRequest &request);
+
+    /**
+     * @brief 写入一条记录文本已知的WAL日志
+     * @param operationType 操作类型
+     * @param record 日志内容（JSON文本，不能包含换行符）
+     */
+    void writeWALLog(const std::string &operationType, const std::string &record);
+
+    /**
+     * @brief 把一个批次的请求作为一条WAL日志写入
+     * @param operationType 操作类型
+     * @param requests 批次中实际写入的请求
      */
     void writeWALLog(const std::string &operationType,
-                     const rapidjson::Document &jsonData);
+                     const std::vector<const UpsertRequest *> &requests);
 
     /**
      * @brief 执行数据库快照
@@ -85,14 +242,84 @@ public:
      */
     void takeSnapshot();
 
+private:
+    /**
+     * @brief 按名称获取集合，集合不存在时抛出异常
+     * @param name 集合名
+     * @return 集合
+     * @throws std::runtime_error 集合不存在时抛出
+     */
+    Collection *requireCollection(const std::string &name) const;
+
     /**
-     * @brief 从请求中获取索引类型(出于模块化考虑，将该函数从 http_server.h 中复制过来)
-     * @param jsonRequest JSON请求文档对象
-     * @return IndexFactory::IndexType 返回解析出的索引类型
+     * @brief 从标量存储中恢复已创建的命名集合
      */
-    IndexFactory::IndexType getIndexTypeFromRequest(const rapidjson::Document &jsonRequest);
+    void loadCollections();
+
+    /**
+     * @brief 把所有命名集合的配置写入标量存储
+     *
+     * 调用方需持有集合表的写锁
+     */
+    void saveCollections();
+
+    /**
+     * @brief 获取命名集合的索引工厂，用于保存和加载快照
+     * @return 集合名到索引工厂的映射，不包含默认集合
+     */
+    std::map<std::string, IndexFactory *> getCollectionIndexes() const;
+
+    /**
+     * @brief 把同一集合的一批请求写入该集合
+     * @param collection 集合
+     * @param requests 批次中属于该集合的请求
+     * @param logToWAL 是否把实际写入的记录写入WAL日志
+     * @return 实际写入的记录数量
+     */
+    size_t bulkUpsertCollection(Collection *collection, bool logToWAL,
+                                const std::vector<const UpsertRequest *> &requests);
+
+    /**
+     * @brief 根据新写入的数据收集过滤索引的更新
+     * @param request 新写入的请求
+     * @param existingData 标量存储中已有的旧数据（不存在时为空文档）
+     * @param updates 输出参数，追加该请求对应的过滤条件更新，包括旧数据中有而新数据中没有的字段
+     */
+    static void collectFilterUpdates(const UpsertRequest &request, const rapidjson::Value &existingData,
+                                     std::vector<FilterIndex::IntFieldUpdate> *updates);
+
+    /**
+     * @brief 从标量存储中抽样集合写入IVF索引的向量
+     * @param collection 集合
+     * @param dim 向量维度，维度不一致的记录被跳过
+     * @param sampleSize 最大样本数
+     * @param samples 输出参数，样本向量（按维度依次拼接）
+     *
+     * 顺序遍历集合的记录，每条符合条件的记录被选中的概率相同，内存只占用 sampleSize 个向量
+     */
+    void sampleIvfVectors(const Collection *collection, int dim, size_t sampleSize,
+                          std::vector<float> *samples);
+
+    /**
+     * @brief 在索引上执行搜索
+     * @param request 解码后的搜索请求
+     * @param deadline 搜索的截止时间，默认不限制
+     * @param partial 可选的输出参数，截止时间前未完成搜索时置为true
+     * @param plan 可选的输出参数，实际使用的执行计划
+     * @return 返回搜索结果
+     *
+     * HNSW索引按过滤位图的基数和索引规模选择精确扫描、后过滤或过滤图搜索（见 planHnswSearch）
+     */
+    std::pair<std::vector<long>, std::vector<float>> executeSearch(
+        const SearchRequest &request,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+        bool *partial = nullptr, SearchPlan *plan = nullptr);
 
-private:
     ScalarStorage scalarStorage; ///< 标量存储对象，用于存储向量相关的元数据
     Persistence persistence; ///< 持久化对象，用于持久化向量数据
+    Collection defaultCollection; ///< 默认集合，使用全局索引工厂
+    std::map<std::string, std::unique_ptr<Collection>> collections; ///< 命名集合，创建后不会删除
+    mutable std::shared_mutex collectionsMutex; ///< 保护集合表，查找集合时持有读锁
+    std::unique_ptr<SearchBatcher> searchBatcher; ///< FLAT搜索合批器，未开启时为空
+    std::unique_ptr<SearchCache> searchCache; ///< 搜索结果缓存，未开启时为空
 };
\ No newline at end of file